@@ -1,48 +1,97 @@
 #pragma once
 
 #include <vector>
-#include <memory>
+#include <string>
+#include <cstdint>
 
 #include "types.h"
+#include "traj_bvh.h"
+#include "traj_segments.h"
+#include "traj_lod.h"
 
 namespace ellipsoid_trajectory {
 
+class mapped_file;
+
+// per particle and per time step information that is only needed while loading
+// positions and orientations are written directly into the sample arrays of the trajectories
 struct input_data
 {
     // axes of the ellipsoids
     // index corresponds with particle
     std::vector<vec3> axes;
 
-    // trajectory data as data per particle and per time step (inner vector)
-    std::vector<std::vector<vec3>> positions;    // x,y,z-coordinate
-    std::vector<std::vector<vec4>> orientations; // quaternion with order: i,j,k, real part
-    
     // physical time information of each time step
     // index corresponds with time step
     std::vector<float> times;
 };
 
-// data per time step
+// range of samples of one trajectory inside the arrays of dynamic_particle_data
 struct trajectory_data
 {
     Bounding_Box b_box;                   // bounding box of trajectory
 
-    std::vector<vec3> positions;          // position at each time step
-    std::vector<vec3> velocities;         // velocity at each time step
-    std::vector<vec3> angular_velocities; // velocity at each time step
-    std::vector<vec4> orientations;       // orientation at each time step (order: i, j, k, real part)
-    std::vector<vec3> main_axis_normals;  // normal vector for main axis (axes[0])
+    size_t offset;                        // index of first sample in all sample arrays
+    size_t start_time;                    // time step of first sample
+    size_t length;                        // number of samples (consecutive time steps)
+};
 
-    // vertex index if all data is send to GPU at once
-    std::vector<unsigned int> indices_strip;  // lines strip: 1-2-3-4
-    std::vector<unsigned int> indices;        // line: 1-2, 2-3, 3-4
+// velocities, angular velocities and normals of the samples of one trajectory, index corresponds
+// with sample relative to the first sample of the trajectory, the last sample has no next time
+// step and therefore NaN values
+struct derived_attributes
+{
+    const vec3* velocities;               // velocity at each sample
+    const vec3* angular_velocities;       // angular velocity at each sample
+    const vec3* main_axis_normals;        // normal vector for main axis (axes[0])
+};
+
+// derived attributes of a chunk of consecutive trajectories
+struct derived_chunk
+{
+    std::vector<size_t> offsets;          // index of first sample of each trajectory of the chunk
+    std::vector<vec3> velocities;
+    std::vector<vec3> angular_velocities;
+    std::vector<vec3> main_axis_normals;
+    uint64_t last_use;                    // for least recently used eviction
+
+    derived_chunk() : last_use(0) {}
+};
+
+// derived attributes are only needed for a few visualizations, therefore they are computed
+// on first use per chunk of trajectories and the least recently used chunks are evicted
+// as soon as the cached chunks need more memory than the budget
+struct derived_attribute_cache
+{
+    std::vector<derived_chunk> chunks;    // chunk c holds trajectories [c * chunk_size, (c + 1) * chunk_size)
+    size_t budget;                        // maximum size of cached chunks in bytes
+    size_t size;                          // current size of cached chunks in bytes
+    uint64_t clock;                       // incremented on each access
+
+    // statistics
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+
+    static const size_t chunk_size = 1024;
+
+    derived_attribute_cache() : budget(256 * 1024 * 1024), size(0), clock(0), hits(0), misses(0), evictions(0) {}
 };
 
 struct dynamic_particle_data
 {
     // index corresponds with particle
     std::vector<size_t> axis_ids;         // stores id of axis of particle in axes vector
-    std::vector<std::shared_ptr<trajectory_data>> trajs;  // trajectory data for each particle
+    std::vector<trajectory_data> trajs;   // sample range and bounding box for each particle
+
+    // index corresponds with sample, the samples of trajectory p are stored at
+    // [trajs[p].offset, trajs[p].offset + trajs[p].length) one time step after another
+    // starting with time step trajs[p].start_time
+    std::vector<vec3> positions;          // position at each sample
+    std::vector<vec4> orientations;       // orientation at each sample (order: i, j, k, real part)
+
+    // velocities, angular velocities and normals (see data::get_derived_attributes)
+    derived_attribute_cache derived;
 
     // index corresponds with time step
     std::vector<float> times;            // physical time of each time step
@@ -63,17 +112,35 @@ std::istream& binary_read(std::istream& stream, T& value){
     return stream.read(reinterpret_cast<char*>(&value), sizeof(T));
 }
 
+// reads number of particles and physical time from the header of a Fortran binary file
+bool read_f90_header(const std::string& file_name, size_t& number_particles, double& time);
+
 class data 
 {
 public:
     data();
 
     // loads data from given list of files from start to end index with given resolution
-    bool load(std::vector<std::pair<double, std::string>>& files, int start, int end, int time_resolution = 1, bool cut = false, bool same_start = true, bool create_equidistant = false, float tolerance = 0.90);
+    // files are read in parallel by the given number of threads (0 means one thread per core)
+    // if use_cache is set the post processed data is stored in and restored from a cache file
+    // in the data directory
+    bool load(std::vector<std::pair<double, std::string>>& files, int start, int end, int time_resolution = 1, bool cut = false, bool same_start = true, bool create_equidistant = false, float tolerance = 0.90, unsigned int threads = 0, bool use_cache = false);
     // randomly generates trajectories with varying direction, rotation and velocity
     bool generate_random(size_t _number_particles = 10000, size_t _time_steps = 1000, float start_velocity = 0.0f, int seed = 0, bool cut_trajs = false, bool same_start = false);
     // generates start screen sample trajectories
     bool generate_sample();
+    // reads given files with the stream based and the memory mapped reader, compares
+    // their results and prints the time needed by each reader
+    bool benchmark_readers(std::vector<std::pair<double, std::string>>& files, int start, int end, int time_resolution = 1);
+
+    // derived attributes of trajectory p, computed on first use for the whole chunk containing
+    // p (see data_derived.cxx), the pointers stay valid until the next call
+    derived_attributes get_derived_attributes(size_t p);
+    // computes the normals of all samples at once without caching them
+    // index corresponds with sample
+    void gather_main_axis_normals(std::vector<vec3>& normals);
+    // changes the maximum size of cached derived attributes and evicts chunks if necessary
+    void set_derived_cache_budget(size_t bytes);
 
     Bounding_Box b_box;
     size_t max_time_steps;
@@ -84,21 +151,54 @@ public:
     // stores trajectory of each particle
     dynamic_particle_data dynamics;
 
+    // hierarchy over bounding boxes of trajectories for region queries
+    trajectory_bvh traj_bvh;
+    // bounding boxes of time windows of each trajectory
+    trajectory_segments traj_segments;
+    // level of detail of each sample
+    trajectory_lod traj_lod;
+
     // stores different ellipsoid axes
     std::vector<vec3> axes;
 
 private:
     input_data tmp_data;
 
+    // number of threads used for loading and post processing (0 means one thread per core)
+    unsigned int num_threads;
+
     bool read_files(std::string directory_name);
+    // indices of all files from start to end that are read with given resolution
+    std::vector<size_t> select_files(int start, int end, int time_resolution);
+    // resizes tmp_data and the sample arrays and creates one trajectory with given number of
+    // time steps per particle
+    void allocate_data(size_t number_particles, size_t time_steps);
     // read Fortran binary file of given time step
     bool read_f90_file(std::string file_name, size_t t, size_t number_particles);
+    // read Fortran binary file of given time step through a memory mapping of the file
+    bool read_f90_file_mapped(std::string file_name, size_t t, size_t number_particles);
+    // maps Fortran binary file of given time step, validates its size and header and stores its time
+    bool open_f90_file(const std::string& file_name, size_t t, size_t number_particles, mapped_file& file);
+    // decodes record of particle i of a mapped Fortran binary file into time step t of its trajectory
+    bool decode_f90_particle(const unsigned char* file_data, size_t t, size_t i);
     
     // transfers tmp_data to data storage used for visualization
     void post_process(bool cut, bool same_start, bool create_equidistant, float tolerance);
     
+    // cache of post processed data (see data_cache.cxx)
+    std::string cache_file_name(const std::string& data_file_name);
+    bool compute_cache_key(std::vector<std::pair<double, std::string>>& files, std::vector<size_t>& selected, bool cut, bool same_start, bool create_equidistant, float tolerance, uint64_t& key);
+    bool read_cache(const std::string& file_name, uint64_t key);
+    bool write_cache(const std::string& file_name, uint64_t key);
+
     // updates bounding box measures
     void compute_data_bounding_box();
+
+    // derived attributes (see data_derived.cxx)
+    // evicts least recently used chunks except the given one until the cache fits into its budget
+    void evict_derived_chunks(size_t keep_chunk);
+    // drops all derived attributes, needed whenever trajectories change
+    void reset_derived_attributes();
 };
 
 }
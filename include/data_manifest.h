@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace ellipsoid_trajectory {
+
+// header information of a single time step file
+struct manifest_entry
+{
+    std::string file_name;      // name of file inside the data directory
+    double time;                // physical time of time step
+    uint64_t number_particles;
+    uint64_t size;              // file size in bytes
+    int64_t modified;           // time of last modification
+};
+
+// scans given directory for binary files and returns their header information sorted by time
+// the header information is stored in a manifest file inside the directory and only new or
+// changed files are opened on the next scan, headers are read by the given number of threads
+bool scan_directory(const std::string& directory_name, std::vector<manifest_entry>& entries, unsigned int threads = 0);
+
+}
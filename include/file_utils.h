@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace ellipsoid_trajectory {
+
+// size in bytes and time of last modification (platform dependent resolution) of a file
+struct file_info
+{
+    uint64_t size;
+    int64_t modified;
+};
+
+// queries size and modification time of given file, returns false if file does not exist
+bool get_file_info(const std::string& file_name, file_info& info);
+
+// read-only memory mapping of a whole file
+class mapped_file
+{
+public:
+    mapped_file();
+    ~mapped_file();
+
+    // maps given file into memory, returns false if file could not be opened or mapped
+    bool open(const std::string& file_name);
+    // unmaps file and closes all handles
+    void close();
+
+    bool is_open() const { return is_mapped; }
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    // mapping is neither copyable nor assignable
+    mapped_file(const mapped_file&);
+    mapped_file& operator=(const mapped_file&);
+
+    const unsigned char* ptr;
+    size_t length;
+    bool is_mapped;
+
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int file_descriptor;
+#endif
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+// persistent storage of all elements that are computed whenever the displayed trajectories change,
+// buffers keep their capacity between updates, therefore no memory is allocated once they are large enough
+class index_buffers
+{
+public:
+    index_buffers();
+
+    // prepares buffers for an update, number of ids is the number of different ellipsoid axes
+    void begin_update(size_t number_ids);
+    // empties all buffers without releasing their memory
+    void clear();
+    // counts the buffers that had to grow since begin_update
+    void end_update();
+    // releases memory of all buffers (when a new data set is loaded)
+    void release();
+
+    // memory held by all buffers in bytes
+    size_t capacity_bytes() const;
+
+    // element indices of each render mode
+    std::vector<unsigned int> indices;              // indices for line: 1-2, 2-3, 3-4
+    std::vector<unsigned int> indices_strip;        // indices for strip: 1-2-3-4
+    std::vector<unsigned int> ribbon_indices;       // for precomputed vertices of ribbon
+    std::vector<unsigned int> ribbon_3D_indices;    // for precomputed vertices of 3D ribbon
+    // one draw command (first sample, number of samples) per visible trajectory, replaces the
+    // indices of lines and 3D ribbons (GPU) when they are drawn with glMultiDrawArraysIndirect
+    std::vector<Draw_Command> commands;
+
+    // instances of each ellipsoid axis id
+    std::vector<std::vector<vec3>> ellipsoid_positions;
+    std::vector<std::vector<vec4>> ellipsoid_orientations;
+    std::vector<std::vector<vec3>> tubes_positions;
+    std::vector<std::vector<vec4>> tubes_orientations;
+    std::vector<std::vector<vec4>> tubes_colors;
+
+    // glyphs
+    std::vector<vec3> glyph_positions;
+    std::vector<vec3> velocities;
+    std::vector<vec3> normals;
+    std::vector<vec3> angular_velocities;
+
+    // statistics
+    size_t last_grown;                              // buffers that had to grow during last update
+    size_t total_grown;
+    size_t updates;
+
+private:
+    // visits capacity of every buffer, stores it if store is true and returns number of changed capacities
+    size_t compare_capacities(bool store);
+
+    std::vector<size_t> capacities;                 // capacity of each buffer at begin of update
+};
+
+}
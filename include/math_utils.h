@@ -9,6 +9,26 @@ namespace ellipsoid_trajectory {
     vec4 quat_normed(vec4 q);
     vec4 slerp(vec4 qa, vec4 qb, double t);
 
+    // instruction sets of the batched quaternion functions
+    enum simd_level { SIMD_SCALAR, SIMD_SSE, SIMD_AVX2 };
+
+    // best instruction set supported by cpu and operating system
+    simd_level detect_simd_level();
+    const char* simd_level_name(simd_level level);
+
+    // batched versions of the functions above for contiguous arrays (out may alias an input),
+    // the instruction set is selected at runtime with a scalar fallback (see math_simd.cxx)
+    void quat_rotate_batch(vec3 position, const vec4* quats, vec3* out, size_t count);
+    void quat_mul_batch(const vec4* q0, const vec4* q1, vec4* out, size_t count);
+    void quat_normed_batch(const vec4* q, vec4* out, size_t count);
+    // computed in float with polynomial approximations for t in [0, 1], the absolute error per
+    // component is below 1e-6 / sin(half angle between qa and qb)
+    void slerp_batch(const vec4* qa, const vec4* qb, const float* t, vec4* out, size_t count);
+
+    // compares time and results of the batched functions for every supported instruction set
+    // against the scalar ones, returns false if any result exceeds its error bound
+    bool benchmark_quat_batch(size_t count = 1 << 20);
+
     // euler angle in radian to quaternion
     vec4 to_quat(double pitch, double roll, double yaw);
 
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+namespace ellipsoid_trajectory {
+
+// number of threads used if no explicit number of threads is given
+inline unsigned int default_thread_count()
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+// calls func(i) for every i in [begin, end) using the given number of new threads
+// (0 means one thread per core), indices are handed out dynamically one after another
+template<typename Func>
+void parallel_for(size_t begin, size_t end, unsigned int threads, Func func)
+{
+    if (end <= begin)
+        return;
+
+    if (threads == 0)
+        threads = default_thread_count();
+    if (threads > end - begin)
+        threads = (unsigned int)(end - begin);
+
+    if (threads <= 1) {
+        for (size_t i = begin; i < end; i++)
+            func(i);
+        return;
+    }
+
+    std::atomic<size_t> next(begin);
+    auto worker = [&]() {
+        for (size_t i = next++; i < end; i = next++)
+            func(i);
+    };
+
+    // calling thread works as well
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned int w = 1; w < threads; w++)
+        pool.push_back(std::thread(worker));
+    worker();
+
+    for (size_t w = 0; w < pool.size(); w++)
+        pool[w].join();
+}
+
+// threads that are started once and wait for work, run behaves like parallel_for but neither
+// starts threads nor allocates memory, therefore it is used by updates that happen every frame
+class thread_pool
+{
+public:
+    // starts threads - 1 workers (0 means one thread per core), the calling thread works as well
+    explicit thread_pool(unsigned int threads = 0);
+    ~thread_pool();
+
+    // number of threads that can work on one call of run (workers and calling thread)
+    unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+    // calls func(i) for every i in [begin, end) using at most the given number of threads of the
+    // pool, returns after all calls finished (only one thread may call run at a time)
+    template<typename Func>
+    void run(size_t begin, size_t end, unsigned int threads, Func func)
+    {
+        execute(begin, end, threads, &call<Func>, &func);
+    }
+
+private:
+    template<typename Func>
+    static void call(void* func, size_t i)
+    {
+        (*static_cast<Func*>(func))(i);
+    }
+
+    void execute(size_t begin, size_t end, unsigned int threads, void (*task)(void*, size_t), void* context);
+    void work(unsigned int worker);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+
+    // current job, workers with index < job_workers take part in it
+    void (*job_task)(void*, size_t);
+    void* job_context;
+    std::atomic<size_t> job_next;
+    size_t job_end;
+    unsigned int job_workers;
+    unsigned int busy_workers;
+    size_t generation;
+    bool stop;
+};
+
+}
@@ -18,6 +18,12 @@
 #include "traj_velocity_renderer.h"
 #include "data.h"
 #include "lighting.h"
+#include "index_buffers.h"
+#include "traj_bitset.h"
+#include "poi_search.h"
+#include "traj_culling.h"
+#include "traj_colormap.h"
+#include "parallel.h"
 
 
 #define GL_GPU_MEM_INFO_TOTAL_AVAILABLE_MEM_NVX 0x9048
@@ -37,6 +43,16 @@ struct ROIData {
     int pos_z_percent;
 };
 
+// samples of a trajectory that passed all filters relative to its first sample,
+// start_offset == end_offset if it is not displayed
+struct VisibleTraj {
+    size_t id;
+    int start_offset;
+    int end_offset;
+    bool filtered;          // rejected by filters (skip_traj)
+    unsigned char lod_level;    // level of detail of its samples, 0 for all samples
+};
+
 struct LengthFilterData {
     bool filter_length_active;
     bool x_very_small_traj;
@@ -56,6 +72,9 @@ struct LengthFilterData {
     int thresh_medium;
 };
 
+// bit of length class code of trajectories without samples inside of the displayed time interval
+const unsigned short length_class_empty = 1 << 12;
+
 class plugin : 
     public cgv::base::group,         // obligatory base class to integrate into global tree structure and to store a name
     public cgv::render::drawable,    // enables 3d view capabilities for this class
@@ -124,6 +143,9 @@ private:
     int start_load_time_step;       // range [1-N]
     int end_load_time_step;         // range [1-N]
     int time_step_resolution;
+    int load_threads;
+    bool use_cache;
+    int derived_cache_size;         // in MB
     std::string directory_name;
 
     // store all scanned files oredered by their id
@@ -133,6 +155,12 @@ private:
     void scan_data();
     // load files stored in files vector or call random generator
     void load_data(bool generated = false);
+    // compares stream based and memory mapped file reader on currently selected files
+    void benchmark_readers();
+    // compares batched quaternion functions of every supported instruction set with the scalar ones
+    void benchmark_quaternions();
+    // applies memory budget of cached velocities, angular velocities and normals
+    void changed_derived_cache_size();
     // sets view, light direction, time colors ... depending on current ellips_data
     void set_up_data();
 
@@ -227,7 +255,7 @@ private:
     void set_traj_indices_out_of_date();
 
     // current indices for element buffer of trajectory renderer for elements that
-    // will be displayed
+    // will be displayed, all point into the persistent vectors of buffers
     std::vector<unsigned int>* traj_indices;            // indices for line: 1-2, 2-3, 3-4
     std::vector<unsigned int>* traj_indices_strip;      // indices for strip: 1-2-3-4
     std::vector<unsigned int>* traj_ribbon_indices;     // for precomputed vertices of ribbon
@@ -241,18 +269,126 @@ private:
     std::vector<vec3>* velocities;
     std::vector<vec3>* normals_vis;
     std::vector<vec3>* angular_velocities;
+    index_buffers buffers;
 
     // computes indices for new EBO for rendering trajectories
     void compute_traj_indices();
-    // creates new index vectors and reserves memory
+    // computes indices for the time window given by start_time and end_time
+    void compute_window_traj_indices();
+    // empties index vectors and sets the pointers of the current modes
     void setup_traj_indices();
-    // deletes all index vectors to reduce memory
+    // empties all index vectors, their memory is kept for the next update
     void clear_traj_indices();
 
-    // applies filter to current trajectory and returns true if filter doesn't match
-    // thus the trajectory has to be skipped
+    // returns true if current trajectory is rejected by an active filter and thus has to be skipped,
+    // uses the results combined by update_filter_bits, called by several threads at once
     bool skip_traj(size_t p);
 
+    // trajectories passing all active filters
+    trajectory_bitset visible_bits;
+
+    // updates results of filters whose settings changed and combines the results of all active filters
+    void update_filter_bits();
+    // marks all cached filter results as out of date (after loading)
+    void invalidate_filter_bits();
+
+    // number of threads used to compute indices
+    int index_threads;
+    // workers of the index computation, they are started once so that no update starts threads
+    thread_pool index_pool;
+    // filter result of each candidate trajectory
+    std::vector<VisibleTraj> visible_trajs;
+    // number of output elements of each block of candidates and their prefix sums
+    std::vector<size_t> block_counts;
+    // candidates are either all trajectories starting at candidate_start_id or roi_candidates
+    size_t candidate_start_id;
+    bool use_roi_candidates;
+
+    // selects candidate trajectories of an update and returns their number
+    size_t prepare_candidates();
+    // id of candidate trajectory c of current update
+    size_t candidate_id(size_t c) const { return use_roi_candidates ? roi_candidates[c] : candidate_start_id + c; }
+    // index vector of current render mode (nullptr if trajectories are hidden)
+    std::vector<unsigned int>* mode_indices();
+
+    // lines and 3D ribbons (GPU) can be drawn with one command (first sample, number of samples) per
+    // visible trajectory instead of indices, a filter change then only rewrites 16 bytes per trajectory
+    bool multi_draw;
+    bool commands_computed;                 // last update wrote buffers.commands instead of indices
+    // checks if the current render mode is drawn with commands
+    bool draw_commands_supported() const;
+
+
+    // ------------------------------ culling on GPU ------------------------------------
+    // the length classes, the bounding box test of the roi, the single trajectory and the time window
+    // are evaluated by a compute shader that writes the draw commands, together with culling of
+    // chunks of trajectories outside of the view frustum, thus changing them does not involve skip_traj
+    traj_culling culling;
+    bool gpu_culling;
+    bool frustum_culling;
+    bool culled_on_gpu;                     // trajectories of current frame are drawn with the commands of culling
+    bool culling_classes_valid;             // length classes of culling match length_classes
+    bool verify_culling;                    // next frame compares the commands with the cpu reference
+    Cull_Settings culling_settings;         // settings of last pass
+    int nr_drawn_chunks;                    // chunks of visible trajectories inside of the view frustum
+    int nr_culled_chunks;                   // chunks of visible trajectories outside of the view frustum
+
+    // checks if the current settings can be evaluated by the culling shader
+    bool culling_on_gpu_supported() const;
+    // runs the culling shader if the filters or the view changed
+    void cull_on_gpu(cgv::render::context& ctx);
+    // compares the commands of the next frame with those of the cpu reference (see console)
+    void verify_gpu_culling();
+
+    // --------------------------- level of detail --------------------------------------
+    // lines and ribbons only draw the samples of a trajectory whose error (see data::traj_lod) is
+    // larger than lod_pixel_error pixels at the distance of its bounding box to the eye, the levels
+    // are chosen on the cpu and therefore replace the commands of multi draw and culling on GPU
+    bool lod_active;
+    float lod_pixel_error;
+    bool lod_view_valid;
+    bool lod_perspective;
+    vec3 lod_eye;                           // eye of the view the levels of the current indices are chosen for
+    float lod_focus_distance;
+    float lod_pixel_size;                   // size of a pixel at distance 1 (perspective) or at any distance (orthographic)
+    size_t nr_lod_samples;                  // samples of the visible trajectories
+    size_t nr_lod_drawn_samples;            // samples drawn with level of detail
+
+    // checks if the current render mode is drawn with level of detail
+    bool lod_supported() const;
+    // stores the current view and returns true if it changed enough to choose other levels
+    bool update_lod_view(cgv::render::context& ctx);
+    // level of detail of a trajectory for the stored view
+    unsigned char traj_lod_level(const trajectory_data& traj) const;
+
+    // -------------------- incremental updates during animation ------------------------
+    // while animating, each candidate gets a fixed slot of indices large enough for all of its samples
+    // after start time, thus an animation step only rewrites the end of the slots of trajectories
+    // whose window changed and transfers the changed ranges with glBufferSubData
+    bool slotted_indices;                   // indices of current mode are stored in slots
+    bool animation_step;                    // next update is caused by an animation step
+    bool indices_patched;                   // last update only changed ranges of index_patches
+    int slotted_start_time;
+    RenderMode slotted_mode;
+    std::vector<size_t> slot_offsets;       // first index of slot of each candidate
+    std::vector<std::pair<size_t, size_t>> index_patches;   // ranges [first, end) changed by last update
+    std::vector<size_t> patch_gaps;
+
+    // checks if indices of current settings can be stored in slots
+    bool slotted_indices_supported() const;
+    // computes all slots of the given number of candidates
+    void compute_slotted_traj_indices(size_t nr_candidates);
+    // updates slots for the current end time
+    void update_slotted_traj_indices();
+    // number of displayed samples of a candidate at current end time
+    size_t slot_samples(const VisibleTraj& visible) const;
+    // index at position pos of the given strip of the slot of trajectory p with samples displayed samples
+    unsigned int slot_index(size_t p, unsigned int first_sample, int start_offset, size_t samples, size_t strip, size_t pos) const;
+    // writes positions [from, to) of each strip of the slot of candidate c
+    void write_slot(std::vector<unsigned int>& indices, size_t c, size_t from, size_t to);
+    // merges changed ranges so that the number of buffer transfers stays small
+    void merge_index_patches();
+
 
     // ---------------------- trajectory selection -------------------------------------
     int single_traj_id;
@@ -264,6 +400,12 @@ private:
     int start_time;
     int end_time;
     std::vector<vec4> time_colors;
+    std::vector<unsigned short> time_indices;   // time index of each time step as vertex attribute (16 bit)
+    traj_colormap time_colormap;                // time_colors on the GPU, looked up by the time index of each sample
+
+    // checks if 16 bit time indices distinguish all time steps, otherwise samples store
+    // their color with the time index in alpha and the time window is applied on the cpu
+    bool time_indices_supported() const;
 
     bool animate;
     bool paused;
@@ -277,13 +419,51 @@ private:
     int animation_speed;
     std::chrono::steady_clock::time_point time_last_frame;
 
+    // the shaders discard samples outside of the time window, therefore indices can be computed
+    // for the whole time range once and moving the window only changes two uniforms
+    bool gpu_time_window;
+    bool full_time_indices;     // current indices cover the whole time range
+    // counts the candidates of the last update whose samples overlap the time window, indices of
+    // the whole time range would otherwise count trajectories outside of the window as visible
+    void count_window_trajs();
+
+    // checks if the time window can be applied by the shaders alone (nothing computed on the
+    // cpu depends on it)
+    bool time_window_on_gpu() const;
+    // called when start or end time changed
+    void changed_time_window();
+    // passes the time window to the renderers of the trajectories
+    void set_time_window_uniforms();
+
 
     // ----------------------- length filter --------------------------------------------
     LengthFilterData length_filter_data;
     bool filter_length_active;
 
-    // checks if given trajectory fits current length filter
-    bool filter_length(std::shared_ptr<trajectory_data> traj);
+    // code of the length classes of trajectory p within the displayed time interval: four bits per axis
+    // (very small, small, medium, large starting at bit 4 * axis) set for each class containing its extent
+    // and length_class_empty if no sample lies inside of the interval
+    unsigned short length_class_code(size_t p);
+
+    // length class codes of all trajectories for the time interval and thresholds they were computed for
+    std::vector<unsigned short> length_classes;
+    int length_classes_start;
+    int length_classes_end;
+    LengthFilterData length_classes_data;
+    bool length_classes_valid;
+
+    // trajectories passing the length filter for the rejected classes they were computed for
+    trajectory_bitset length_bits;
+    unsigned short length_bits_rejected;
+    bool length_bits_valid;
+
+    // updates length_classes if the time interval or the thresholds changed
+    void update_length_classes();
+    // updates length_classes and length_bits if necessary
+    void update_length_bits();
+    // converts time interval [start, end] (range [1-N]) to samples [first, last) of given trajectory
+    // relative to its first sample, first == last if the trajectory does not cover the interval
+    void time_window_samples(const trajectory_data& traj, int start, int end, size_t& first, size_t& last);
 
 
     // ----------------------- region of interest filter --------------------------------
@@ -292,11 +472,28 @@ private:
     bool roi_exact;
     ROIData roi_data;
     Bounding_Box roi;
+    // ids of trajectories whose bounding box intersects roi (see data::traj_bvh)
+    std::vector<size_t> roi_candidates;
+
+    // computes roi from slider values and bounding box of data
+    void update_roi();
 
     // checks if given trajectory crosses region of interest using bounding box of traj
-    bool in_region_of_interest(std::shared_ptr<trajectory_data> traj);
-    // checks if given trajectory crosses region of interest using its positions
-    bool in_region_of_interest_exact(std::shared_ptr<trajectory_data> traj);
+    bool in_region_of_interest(const trajectory_data& traj);
+    // checks if trajectory p crosses region of interest using its positions (see data::traj_segments)
+    bool in_region_of_interest_exact(size_t p);
+
+    // trajectories crossing the region of interest for the settings they were computed for
+    trajectory_bitset roi_bits;
+    Bounding_Box roi_bits_box;
+    bool roi_bits_exact;
+    int roi_bits_start;
+    int roi_bits_end;
+    bool roi_bits_valid;
+    std::vector<unsigned char> roi_results;
+
+    // updates roi_candidates and roi_bits if necessary
+    void update_roi_bits();
 
 
     // -------------------------- automatic search for interesting points ---------------
@@ -311,11 +508,24 @@ private:
     LengthFilterData poi_length_filter_data;
     std::vector<ROIData> poi_points;
 
-    // applies the current filter options while moving the ROI box through the bounding box
+    // state of filters when the running search was started
+    int pending_poi_start_time;
+    int pending_poi_end_time;
+    LengthFilterData pending_poi_length_filter_data;
+    ROIData pending_poi_roi;
+    poi_search poi_finder;
+
+    // starts moving the ROI box through the bounding box in the background applying the current
+    // filter options (see poi_search), results are taken over by finish_points_of_interest
     void search_points_of_interest();
+    // takes over the results of a finished search, called by timer_event
+    void finish_points_of_interest();
     // sets all ui variables to the corresponding result
     void show_points_of_interest();
 
+    // checks if all length classes are displayed and therefore the length filter has no effect
+    bool all_length_classes_displayed() const;
+
 
     // --------------------------- performance stats ------------------------------------
     bool perf_stats;
@@ -347,6 +557,8 @@ private:
 
     // restarts performance measure (necessary for averaging of the values)
     void reset_perf_stats();
+    // computes indices of current selection with 1 to N threads and prints time and speedup
+    void benchmark_indices();
     // swap GPU buffer to read result of last frame
     void swapQueryBuffers();
 };
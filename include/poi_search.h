@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <utility>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+// placement of the region of interest found by the search
+struct poi_result
+{
+    int count;                            // number of trajectories with a sample inside of the roi
+    int pos_percent[3];                   // position of roi in percent of the bounding box of the data
+};
+
+// settings of one search, roi placements start at 0 and are step percent apart in each direction
+struct poi_settings
+{
+    Bounding_Box b_box;                   // bounding box of the data
+    int step;
+    int length_percent[3];                // size of roi in percent of the bounding box
+    size_t max_pois;
+    unsigned int threads;
+};
+
+// searches placements of the region of interest containing most trajectories on a background thread,
+// every trajectory increments the count of each placement it crosses once, therefore all placements
+// are scored in a single pass over the samples instead of filtering all trajectories for each placement
+class poi_search
+{
+public:
+    poi_search();
+    // stops a running search
+    ~poi_search();
+
+    // starts searching in the background, sample ranges [first, last) of positions are the displayed
+    // samples of each considered trajectory, positions have to stay valid until the search finished
+    void start(const std::vector<vec3>& positions, std::vector<std::pair<size_t, size_t>>& sample_ranges, const poi_settings& settings);
+    // stops a running search and waits for its thread
+    void cancel();
+
+    bool running() const { return worker.joinable() && !finished; }
+    // moves results of a finished search into result (ordered by count) and returns true once per search
+    bool fetch(std::vector<poi_result>& result);
+
+    // statistics of last finished search
+    size_t placements;                    // number of scored placements
+    double search_time;                   // in milliseconds
+
+private:
+    void run();
+    // scores all placements for the sample ranges [begin, end), counts of each placement are added to counts
+    void score_ranges(size_t begin, size_t end, std::vector<int>& counts, std::vector<size_t>& stamps);
+
+    const std::vector<vec3>* positions;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    poi_settings settings;
+
+    // bounds of roi of each placement index along each axis, both are increasing with the index
+    std::vector<float> roi_min[3];
+    std::vector<float> roi_max[3];
+    int number_steps;
+
+    std::vector<poi_result> results;
+    std::thread worker;
+    std::atomic<bool> stop;
+    std::atomic<bool> finished;
+};
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ellipsoid_trajectory {
+
+// resident memory of this process in bytes (0 if not available on this platform)
+size_t current_memory_usage();
+// maximum resident memory of this process since its start in bytes
+size_t peak_memory_usage();
+
+}
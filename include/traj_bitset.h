@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ellipsoid_trajectory {
+
+// one bit per trajectory, used to cache the result of a filter and to combine the results of
+// several filters word by word
+class trajectory_bitset
+{
+public:
+    trajectory_bitset();
+
+    // resizes to the given number of trajectories and sets all bits to value
+    void assign(size_t size, bool value);
+    // keeps only bits that are set in other as well (other has to be of the same size)
+    void intersect(const trajectory_bitset& other);
+    // number of set bits
+    size_t count() const;
+
+    bool test(size_t p) const { return (words[p / 64] >> (p % 64)) & 1; }
+    void set(size_t p) { words[p / 64] |= uint64_t(1) << (p % 64); }
+    size_t size() const { return bits; }
+
+    // bit p % 64 of word p / 64 belongs to trajectory p, unused bits of the last word are zero
+    std::vector<uint64_t> words;
+
+private:
+    size_t bits;
+};
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+struct trajectory_data;
+
+// node of the bounding volume hierarchy, nodes are stored in depth first order
+// thus the left child of an inner node directly follows its parent
+struct bvh_node
+{
+    vec3 min;
+    vec3 max;
+    uint32_t first;                       // leaf: index of first entry in ids, inner node: index of right child
+    uint32_t count;                       // leaf: number of trajectories, inner node: 0
+};
+
+// bounding volume hierarchy over the bounding boxes of all trajectories
+// used to find all trajectories whose bounding box intersects a region without testing each of them
+class trajectory_bvh
+{
+public:
+    // builds hierarchy over the bounding boxes of the given trajectories
+    void build(const std::vector<trajectory_data>& trajs);
+    // removes all nodes
+    void clear();
+
+    // stores ids of all trajectories whose bounding box intersects the given box
+    // in ascending order in result, boxes touching each other intersect
+    void query(const Bounding_Box& box, std::vector<size_t>& result) const;
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return ids.size(); }
+
+private:
+    // creates node for ids in range [begin, end) and returns its index
+    uint32_t build_node(const std::vector<trajectory_data>& trajs, size_t begin, size_t end);
+
+    std::vector<bvh_node> nodes;
+    std::vector<uint32_t> ids;            // trajectory ids ordered by leaves
+    std::vector<Bounding_Box> bounding_boxes; // bounding box of trajectory ids[i], avoids access to trajectories
+};
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cgv/render/context.h>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+    // color of each time step in a texture buffer, the trajectory shaders look up the color of a sample
+    // by its time index instead of storing a color per vertex, a new colormap is therefore a transfer
+    // of one color per time step
+    class traj_colormap
+    {
+    public:
+        traj_colormap();
+
+        // inits colormap by creating buffer and texture
+        void init(cgv::render::context& ctx);
+
+        // resets necessary properties for a new data set
+        void reset();
+
+        // transfers color of each time index
+        void set_colors(std::vector<vec4>& colors);
+
+        unsigned int texture() const { return TBO_texture; }
+
+        // determine if colors have to be set for this data set
+        bool initial;
+
+    private:
+        // ids of buffer and of texture that views it
+        unsigned int TBO;
+        unsigned int TBO_texture;
+    };
+}
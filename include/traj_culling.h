@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cgv/render/shader_program.h>
+#include <cgv/render/context.h>
+#include <cgv/math/fmat.h>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+    // trajectory as seen by the culling shader (std430 layout, 48 bytes)
+    struct Cull_Trajectory
+    {
+        vec4 box_min;                   // bounding box of all samples, w is unused
+        vec4 box_max;
+        unsigned int first;             // first sample in vertex buffers
+        unsigned int length;
+        unsigned int start_time;
+        unsigned int padding;
+    };
+
+    // consecutive samples of a trajectory that are culled together (std430 layout, 48 bytes)
+    struct Cull_Chunk
+    {
+        vec4 box_min;                   // bounding box of samples [begin, end] (including first sample of next chunk)
+        vec4 box_max;
+        unsigned int traj;
+        unsigned int begin;             // samples [begin, end) relative to first sample of trajectory
+        unsigned int end;
+        unsigned int padding;
+    };
+
+    // filters and view of one culling pass
+    struct Cull_Settings
+    {
+        // time window given in range of [1, timesteps]
+        int start_time;
+        int end_time;
+        // length classes that are not displayed (see plugin::length_class_code), 0 if not filtered
+        unsigned int rejected_classes;
+        // only trajectories whose bounding box intersects the roi are displayed
+        bool roi_active;
+        Bounding_Box roi;
+        // only this trajectory is displayed, -1 for all
+        int single_traj;
+        // chunks whose bounding box lies outside of one of the clip planes are not drawn
+        bool frustum_culling;
+        vec4 planes[6];
+    };
+
+    // evaluates the filters of all trajectories and view frustum culling of their chunks in a compute
+    // shader, the result is one indirect draw command per chunk which can be drawn by the line and
+    // 3D ribbon (GPU) renderers without involving the cpu
+    class traj_culling
+    {
+    public:
+        // number of samples of one chunk
+        static const size_t chunk_size = 64;
+
+        traj_culling();
+
+        // inits culling by creating shader program and buffers
+        void init(cgv::render::context& ctx);
+
+        // resets necessary properties for a new data set
+        void reset();
+
+        // transfers the trajectories of a data set and their chunks, the length class of each is set to 0,
+        // positions are the sample array of all trajectories
+        void set_trajectories(std::vector<Cull_Trajectory>& trajectories, const std::vector<vec3>& positions);
+        // transfers length class of each trajectory
+        void update_length_classes(std::vector<unsigned short>& length_classes);
+
+        // writes command of each chunk to the command buffer, culled chunks get a command without instances
+        void cull(cgv::render::context& ctx, const Cull_Settings& settings);
+        // reads number of trajectories passing the filters and of their drawn and culled chunks of last pass back from GPU
+        void read_counts(unsigned int& visible, unsigned int& drawn_chunks, unsigned int& culled_chunks);
+        // compares the commands of last pass with those of cull_trajectories and returns number of differing commands
+        size_t verify(const Cull_Settings& settings);
+
+        unsigned int command_buffer() const { return DIBO; }
+        size_t nr_commands() const { return chunks.size(); }
+
+        // determine if trajectories have to be set for this data set
+        bool initial;
+        // compute shaders and indirect draws are available (OpenGL 4.3), set by init
+        bool supported;
+
+    private:
+        // compiled shader program
+        cgv::render::shader_program prog;
+
+        // copies of the input, used by verify
+        std::vector<Cull_Trajectory> trajectories;
+        std::vector<Cull_Chunk> chunks;
+        std::vector<unsigned int> classes;
+
+        // ids of all buffers
+        unsigned int SSBO_trajectories;
+        unsigned int SSBO_chunks;
+        unsigned int SSBO_classes;
+        unsigned int SSBO_counts;
+        unsigned int DIBO;
+    };
+
+    // splits each trajectory into chunks of chunk_size samples and computes their bounding boxes,
+    // positions are the sample array of all trajectories
+    void build_cull_chunks(const std::vector<Cull_Trajectory>& trajectories, const std::vector<vec3>& positions,
+                           std::vector<Cull_Chunk>& chunks);
+
+    // reference of the culling shader on the cpu, writes one command per chunk and returns number of
+    // trajectories passing the filters
+    unsigned int cull_trajectories(const std::vector<Cull_Trajectory>& trajectories, const std::vector<Cull_Chunk>& chunks,
+                                   const std::vector<unsigned int>& length_classes, const Cull_Settings& settings,
+                                   std::vector<Draw_Command>& commands);
+
+    // extracts clip planes (left, right, bottom, top, near, far) of a modelview projection matrix,
+    // points inside of the frustum lie on the positive side of each plane
+    void frustum_planes(const cgv::math::fmat<double, 4, 4>& mvp, vec4 planes[6]);
+}
@@ -21,9 +21,20 @@ namespace ellipsoid_trajectory {
 
         // creates a VAO and all necessary buffers (VBO and EBO) needed for this renderer on GPU
         void set_buffers(cgv::render::context& ctx, std::vector<vec3>& positions, std::vector<vec4>& colors, std::vector<unsigned int>& indices);
+        // creates the buffers for trajectories, the color of each sample is looked up by its time index (see use_colormap)
+        void set_buffers(cgv::render::context& ctx, std::vector<vec3>& positions, std::vector<unsigned short>& time_indices, std::vector<unsigned int>& indices);
 
         // update element buffer while letting all vertex data the same on GPU
         void update_element_buffer(std::vector<unsigned int>& indices);
+        // transfers only indices [first, first + count) to an element buffer of unchanged size
+        void update_element_buffer_range(std::vector<unsigned int>& indices, size_t first, size_t count);
+        // transfers one command per trajectory, following draws use glMultiDrawArraysIndirect
+        // until the element buffer is updated again (requires multi_draw_supported)
+        void update_command_buffer(std::vector<Draw_Command>& commands);
+        // draws the given number of commands of a buffer filled on the GPU (see traj_culling)
+        void use_command_buffer(unsigned int buffer, size_t count);
+        // colors of the time indices used by draw (see traj_colormap)
+        void use_colormap(unsigned int texture);
         void update_position_buffer(std::vector<vec3>& positions);
 
         // enables shader and VAO and draws elements determined by EBO
@@ -31,6 +42,11 @@ namespace ellipsoid_trajectory {
 
         // determine if it is the first rendering pass for this render
         bool initial;
+        // glMultiDrawArraysIndirect is available (OpenGL 4.3), set by init
+        bool multi_draw_supported;
+        // samples whose time index lies outside of [time_window_start, time_window_end] are discarded by the shaders
+        float time_window_start;
+        float time_window_end;
 
     private:
         // compiled shader program
@@ -39,8 +55,15 @@ namespace ellipsoid_trajectory {
         // ids of all buffers
         unsigned int VAO;
         unsigned int EBO;
+        unsigned int DIBO;
+        unsigned int command_buffer;        // DIBO or buffer given to use_command_buffer
         unsigned int VBO_positions;
         unsigned int VBO_colors;
+        unsigned int VBO_time_indices;
+        unsigned int colormap_texture;
         unsigned int nr_elements;
+        unsigned int nr_commands;
+        bool draw_commands;
+        bool colormap_active;               // buffers were set with time indices instead of colors
     };
 }
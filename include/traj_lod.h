@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+struct trajectory_data;
+
+// Douglas-Peucker hierarchy of the samples of each trajectory: every sample is tagged with the
+// level of detail it is needed for, thus a simplification for a given geometric error is found
+// by comparing the level of each sample instead of running the simplification again
+//
+// level l > 0 allows an error of diagonal * 2^(l - 1 - exponent_offset) where diagonal is the
+// length of the diagonal of the bounding box of the trajectory, level 0 is full resolution
+class trajectory_lod
+{
+public:
+    // level of first and last sample of each trajectory
+    static const unsigned char keep_always = 255;
+    // smallest error that is distinguished is diagonal * 2^-exponent_offset
+    static const int exponent_offset = 24;
+
+    // computes levels of all samples, positions are the sample array of all trajectories
+    void build(const std::vector<trajectory_data>& trajs, const std::vector<vec3>& positions, unsigned int threads = 0);
+    // removes all levels
+    void clear();
+
+    bool empty() const { return levels.empty(); }
+
+    // level of detail of a trajectory that allows the given geometric error
+    static unsigned char level(const Bounding_Box& b_box, float error);
+    // levels of the samples of a trajectory starting at the given sample offset, a sample is part of
+    // the simplification of level l if its level is at least l
+    const unsigned char* sample_levels(size_t offset) const { return &levels[offset]; }
+
+private:
+    std::vector<unsigned char> levels;      // level of each sample of all trajectories
+};
+
+}
@@ -21,20 +21,33 @@ namespace ellipsoid_trajectory {
         void reset();
 
         // creates a VAO and all necessary buffers (VBO and EBO) needed for this renderer on GPU
+        // alpha of the color of each vertex is its time index
         void set_buffers(cgv::render::context& ctx, std::vector<vec3>& vertices, std::vector<vec4>& colors, std::vector<unsigned int>& indices);
+        // the color of each vertex is looked up by its time index (see use_colormap)
+        void set_buffers(cgv::render::context& ctx, std::vector<vec3>& vertices, std::vector<unsigned short>& time_indices, std::vector<unsigned int>& indices);
 
         // update element buffer while letting all vertex data the same on GPU
         void update_element_buffer(std::vector<unsigned int>& indices);
+        // transfers only indices [first, first + count) to an element buffer of unchanged size
+        void update_element_buffer_range(std::vector<unsigned int>& indices, size_t first, size_t count);
+        // colors of the time indices used by draw (see traj_colormap)
+        void use_colormap(unsigned int texture);
 
         // enables shader and VAO and draws elements determined by EBO
         void draw(cgv::render::context& ctx);
 
-        void create_vertices(std::vector<vec3>& vertices_out, std::vector<vec4>& colors_out, std::vector<vec3>& positions_in, vec3 axes_in, std::vector<vec4>& orientations_in, std::vector<vec4>&colors_in);
+        // appends the two vertices of each sample of a trajectory (see first_vertex)
+        void create_vertices(std::vector<vec3>& vertices_out, const vec3* positions_in, size_t length, vec3 axes_in, const vec4* orientations_in);
 
         // determine if it is the first rendering pass for this render
         bool initial;
+        // samples whose time index lies outside of [time_window_start, time_window_end] are discarded by the shaders
+        float time_window_start;
+        float time_window_end;
 
-        std::vector<std::vector<unsigned int>> indices;
+        // index of the first vertex of each trajectory, the two vertices of time step t
+        // follow at first_vertex + 2 * t and first_vertex + 2 * t + 1
+        std::vector<unsigned int> first_vertex;
 
     private:
         // compiled shader program
@@ -49,6 +62,9 @@ namespace ellipsoid_trajectory {
         unsigned int EBO;
         unsigned int VBO_positions;
         unsigned int VBO_colors;
+        unsigned int VBO_time_indices;
+        unsigned int colormap_texture;
         unsigned int nr_elements;
+        bool colormap_active;               // buffers were set with time indices instead of colors
     };
 }
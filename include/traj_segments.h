@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+
+namespace ellipsoid_trajectory {
+
+struct trajectory_data;
+
+// bounding box of consecutive samples of a trajectory
+struct segment_box
+{
+    vec3 min;
+    vec3 max;
+};
+
+// segment tree over bounding boxes of chunks of consecutive samples of each trajectory
+// used to answer queries for a time window of a trajectory without visiting all of its samples
+class trajectory_segments
+{
+public:
+    // number of samples covered by one leaf
+    static const size_t chunk_size = 16;
+
+    // builds trees of all trajectories, positions are the sample array of all trajectories
+    void build(const std::vector<trajectory_data>& trajs, const std::vector<vec3>& positions, unsigned int threads = 0);
+    // removes all trees
+    void clear();
+
+    bool empty() const { return tree_offsets.empty(); }
+
+    // bounding box of samples [first, last) of trajectory p given relative to its first sample
+    // positions point to the first sample of the trajectory, box is empty (min > max) if first >= last
+    Bounding_Box extent(size_t p, size_t length, const vec3* positions, size_t first, size_t last) const;
+    // checks if any sample of [first, last) of trajectory p lies inside the given box
+    bool intersects(size_t p, size_t length, const vec3* positions, size_t first, size_t last, const Bounding_Box& box) const;
+
+private:
+    void extent_node(const segment_box* tree, size_t node, size_t begin, size_t end, const vec3* positions,
+                     size_t first, size_t last, segment_box& result) const;
+    bool intersects_node(const segment_box* tree, size_t node, size_t begin, size_t end, const vec3* positions,
+                         size_t first, size_t last, const Bounding_Box& box) const;
+
+    std::vector<segment_box> nodes;       // trees of all trajectories one after another
+    std::vector<size_t> tree_offsets;     // index of root of tree of each trajectory in nodes (heap order starting at 1)
+};
+
+}
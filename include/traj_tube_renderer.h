@@ -34,6 +34,9 @@ namespace ellipsoid_trajectory {
 
         // determine if it is the first rendering pass for this render
         bool initial;
+        // instances whose time index lies outside of [time_window_start, time_window_end] are discarded by the shader
+        float time_window_start;
+        float time_window_end;
 
     private:
         // compiled shader program
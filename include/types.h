@@ -22,6 +22,15 @@ namespace ellipsoid_trajectory {
         vec3 center;
     };
 
+    // layout of one command of glMultiDrawArraysIndirect (16 bytes)
+    struct Draw_Command
+    {
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first;
+        unsigned int base_instance;
+    };
+
     struct Material {
         clr_type ambient;
         clr_type diffuse;
@@ -5,78 +5,258 @@
 #include <time.h>
 #include <limits>
 #include <random>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
 
 #include "data.h"
 #include "math_utils.h"
+#include "file_utils.h"
+#include "parallel.h"
+#include "system_info.h"
 
 namespace ellipsoid_trajectory {
 
+// fixed layout of the unformatted Fortran files (see read_f90_file)
+static const size_t f90_header_size = 28;     // number of particles and physical time
+static const size_t f90_particle_size = 164;  // position, velocity, quaternion, a, b, c, nl
+
+// offset and expected value of each record length marker inside a particle record
+static const uint32_t f90_particle_markers[14][2] = {
+    {  0, 24}, { 28, 24},   // position (double[3])
+    { 32, 24}, { 60, 24},   // velocity (double[3])
+    { 64, 32}, {100, 32},   // quaternion (double[4])
+    {104,  8}, {116,  8},   // a (double)
+    {120,  8}, {132,  8},   // b (double)
+    {136,  8}, {148,  8},   // c (double)
+    {152,  4}, {160,  4}    // nl (int32)
+};
+
+// measures time between consecutive stages of loading and post processing
+struct stage_timer
+{
+    std::chrono::steady_clock::time_point start;
+
+    stage_timer() : start(std::chrono::steady_clock::now()) {}
+
+    // returns milliseconds since construction or last restart
+    double restart()
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+        return ms;
+    }
+};
+
+// hash of the bit patterns of an axis for the axis registry of post_process,
+// -0 and 0 compare equal and are therefore hashed to the same bits
+struct axis_hash
+{
+    size_t operator()(const vec3& axis) const
+    {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (int i = 0; i < 3; i++) {
+            float value = axis[i] + 0.0f;
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(uint32_t));
+            hash ^= bits;
+            hash *= 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+static void reset_box(Bounding_Box& box)
+{
+    box.min = vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    box.max = vec3(std::numeric_limits<float>::min(), std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
+}
+
+static void extend_box(Bounding_Box& box, const vec3& position)
+{
+    for (int i = 0; i < 3; i++) {
+        if (position[i] < box.min[i])
+            box.min[i] = position[i];
+        if (position[i] > box.max[i])
+            box.max[i] = position[i];
+    }
+}
+
+static void merge_box(Bounding_Box& box, const Bounding_Box& other)
+{
+    for (int i = 0; i < 3; i++) {
+        if (other.min[i] < box.min[i])
+            box.min[i] = other.min[i];
+        if (other.max[i] > box.max[i])
+            box.max[i] = other.max[i];
+    }
+}
+
+static void center_box(Bounding_Box& box)
+{
+    vec3 diff = box.max - box.min;
+    box.center = vec3(box.min + (diff / 2));
+}
+
+template<typename T>
+static T mapped_read(const unsigned char* ptr)
+{
+    // memcpy avoids unaligned access and is compiled to a single load
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+bool read_f90_header(const std::string& file_name, size_t& number_particles, double& time)
+{
+    // only the header is needed, therefore read it without mapping the whole file
+    unsigned char header[f90_header_size];
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(header), f90_header_size))
+        return false;
+
+    if (mapped_read<uint32_t>(header) != 4 || mapped_read<uint32_t>(header + 8) != 4
+            || mapped_read<uint32_t>(header + 12) != 8 || mapped_read<uint32_t>(header + 24) != 8)
+        return false;
+
+    number_particles = (size_t)mapped_read<uint32_t>(header + 4);
+    time = mapped_read<double>(header + 16);
+    return true;
+}
+
+// reads number of particles from header of given file
+static bool read_number_particles(const std::string& file_name, size_t& number_particles)
+{
+    double time;
+    if (!read_f90_header(file_name, number_particles, time)) {
+        std::cerr << "ERROR: could not read header of " << file_name << std::endl;
+        return false;
+    }
+    return true;
+}
+
 data::data()
 {
     max_time_steps = 0;
+    num_threads = 0;
 
-    b_box.min = vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-    b_box.max = vec3(std::numeric_limits<float>::min(), std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
+    reset_box(b_box);
 }
 
-bool data::load(std::vector<std::pair<double, std::string>>& files, int start, int end, int time_resolution , bool cut, bool same_start, bool create_equidistant, float tolerance)
+bool data::load(std::vector<std::pair<double, std::string>>& files, int start, int end, int time_resolution , bool cut, bool same_start, bool create_equidistant, float tolerance, unsigned int threads, bool use_cache)
 {
     std::cout << "start reading files ... " << std::endl;
 
+    // just read every x-th time step
+    std::vector<size_t> selected = select_files(start, end, time_resolution);
+
+    // structures rebuilt from the cache use the same number of threads as the post processing
+    if (threads == 0)
+        threads = default_thread_count();
+    num_threads = threads;
+
+    // reuse post processed data if neither the files nor the options changed
+    std::string cache_name;
+    uint64_t cache_key = 0;
+    if (use_cache) {
+        cache_name = cache_file_name(files[0].second);
+        use_cache = compute_cache_key(files, selected, cut, same_start, create_equidistant, tolerance, cache_key);
+
+        if (use_cache && read_cache(cache_name, cache_key)) {
+            std::cout << "  .. restored data from cache " << cache_name << std::endl;
+            std::cout << "  number of stationaries particles: " << stationaries.axis_ids.size() << std::endl;
+            std::cout << "  number of dynamic particles (trajectories): " << dynamics.axis_ids.size() << std::endl;
+            return true;
+        }
+    }
+
     // parse number of particles of one file
-    uint32_t record_length;
-    uint32_t s_number_particles;
-    std::ifstream file (files[0].second, std::ios::in | std::ios::binary);
-    file.seekg(0, std::ios::beg);
-    binary_read(file, record_length);
-    binary_read(file, s_number_particles);
-    file.close();
+    size_t number_particles;
+    if (!read_number_particles(files[0].second, number_particles))
+        return false;
 
     // set overall number of time steps and particles
-    max_time_steps = ceil((end - start + 1) / (time_resolution * 1.0f));
-    size_t number_particles = (size_t) s_number_particles;
+    max_time_steps = selected.size();
 
     // reserve size of all vectors
     std::cout << "  .. reserve memory" << std::endl;
-    tmp_data.axes.resize(number_particles);
-    tmp_data.positions.resize(number_particles);
-    tmp_data.orientations.resize(number_particles);
-    tmp_data.times.resize(max_time_steps);
-
-    // fill inner vectors
-    for (size_t p = 0; p < number_particles; p++) {
-        std::vector<vec3> pos;
-        pos.resize(max_time_steps);
-        tmp_data.positions[p] = pos;
-
-        std::vector<vec4> orientation;
-        orientation.resize(max_time_steps);
-        tmp_data.orientations[p] = orientation;
+    allocate_data(number_particles, max_time_steps);
+
+    std::cout << "  .. parse " << selected.size() << " files using " << threads << " threads" << std::endl;
+    stage_timer timer;
+
+    // the files are stored time step by time step but the trajectories particle by particle
+    // therefore the files are decoded in tiles of some time steps and some particles, each
+    // tile writes a few consecutive time steps of its particles instead of a single time
+    // step of all particles, tiles do not overlap and can be decoded by different threads
+    const size_t tile_time_steps = 32;
+    const size_t tile_particles = 256;
+    const size_t nr_particle_tiles = (number_particles + tile_particles - 1) / tile_particles;
+
+    mapped_file block_files[tile_time_steps];
+    std::vector<char> file_success(selected.size(), 0);
+    std::vector<char> tile_success(nr_particle_tiles * tile_time_steps);
+
+    for (size_t block = 0; block < selected.size(); block += tile_time_steps) {
+        size_t block_size = std::min(tile_time_steps, selected.size() - block);
+
+        // map all files of this block of time steps
+        parallel_for(0, block_size, threads, [&](size_t index) {
+            file_success[block + index] = open_f90_file(files[selected[block + index]].second, block + index, number_particles, block_files[index]);
+        });
+
+        // decode all particle tiles of this block
+        std::fill(tile_success.begin(), tile_success.end(), 1);
+        parallel_for(0, nr_particle_tiles, threads, [&](size_t tile) {
+            size_t tile_end = std::min((tile + 1) * tile_particles, number_particles);
+
+            for (size_t i = tile * tile_particles; i < tile_end; i++) {
+                for (size_t index = 0; index < block_size; index++) {
+                    if (file_success[block + index] && !decode_f90_particle(block_files[index].data(), block + index, i))
+                        tile_success[tile * tile_time_steps + index] = 0;
+                }
+            }
+        });
+
+        for (size_t index = 0; index < block_size; index++) {
+            for (size_t tile = 0; tile < nr_particle_tiles; tile++) {
+                if (!tile_success[tile * tile_time_steps + index]) {
+                    std::cerr << "ERROR: invalid particle records in file " << files[selected[block + index]].second << std::endl;
+                    file_success[block + index] = 0;
+                    break;
+                }
+            }
+            block_files[index].close();
+        }
     }
 
-    std::cout << "  .. parse files" << std::endl;
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
 
+    // report every file that could not be read
     bool success = true;
-    size_t index = 0;
-    // parse data of each file
-    for (int i = start; i <= end; i++) {
-        // just read every x-th time step
-        if (i % time_resolution == 0) {
-            std::string file_name = files[i].second;
-            std::cout << "     " << file_name << std::endl;
-
-            // read data for all particles of current time step from file
-            success = read_f90_file(file_name, index, number_particles);
-            index++;
+    for (size_t index = 0; index < selected.size(); index++) {
+        if (!file_success[index]) {
+            std::cerr << "ERROR: reading file " << files[selected[index]].second << std::endl;
+            success = false;
         }
     }
 
     if (success) {
         // fill stationary and trajectories vectors
         post_process(cut, same_start, create_equidistant, tolerance);
+
+        if (use_cache) {
+            std::cout << "  .. write cache " << cache_name << std::endl;
+            write_cache(cache_name, cache_key);
+        }
         return true;
     } else {
         std::cerr << "ERROR: reading data from directory" << std::endl;
+        tmp_data = input_data();
+        dynamics = dynamic_particle_data();
         return false;
     }
 }
@@ -84,96 +264,102 @@ bool data::load(std::vector<std::pair<double, std::string>>& files, int start, i
 void data::post_process(bool cut, bool same_start, bool create_equidistant, float tolerance)
 {
     std::cout << "post processing of data ... " << std::endl;
+    stage_timer total_timer;
+    stage_timer timer;
 
     // 1. store axes of ellipsoids in a grouped way
-    dynamics.axis_ids.reserve(tmp_data.positions.size());
+    std::cout << "  .. group axes of ellipsoids" << std::endl;
+    // the registry maps each distinct axis to its id in the axes vector
+    std::unordered_map<vec3, size_t, axis_hash> axis_registry;
+    for (size_t id = 0; id < axes.size(); id++)
+        axis_registry.insert(std::make_pair(axes[id], id));
+
+    dynamics.axis_ids.reserve(dynamics.trajs.size());
     for (size_t p = 0; p < tmp_data.axes.size(); p++) {
-        bool axis_exists = false;
+        std::unordered_map<vec3, size_t, axis_hash>::const_iterator it = axis_registry.find(tmp_data.axes[p]);
         size_t id;
 
-        // check if axis exists
-        for (id = 0; id < axes.size(); id++) {
-            if (axes[id] == tmp_data.axes[p]) {
-                axis_exists = true;
-                break;
-            }
-        }
-
         // add current axis if not already in axes vector
-        if (!axis_exists) {
+        if (it == axis_registry.end()) {
+            id = axes.size();
             axes.push_back(tmp_data.axes[p]);
+            axis_registry.insert(std::make_pair(tmp_data.axes[p], id));
+        } else {
+            id = it->second;
         }
 
         // store id of current axis in axes vector
         dynamics.axis_ids.push_back(id);
     }
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
 
 
     // 2. remove "trajectories" of stationary particles
     std::cout << "  .. remove stationary particles from trajectories" << std::endl;
-    int write_ptr = 0;
 
-    for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-        bool stationary = true;
+    // detection is independent for each particle
+    std::vector<char> stationary(dynamics.trajs.size(), 1);
+    parallel_for(0, dynamics.trajs.size(), num_threads, [&](size_t p) {
+        const vec3* positions = &dynamics.positions[dynamics.trajs[p].offset];
 
         // go through position at each time step to detect stationary particles
-        for (size_t t = 1; t < tmp_data.positions[p].size(); t++) {
+        for (size_t t = 1; t < dynamics.trajs[p].length; t++) {
             // if position changed at any time the particle is not stationary
-            if (tmp_data.positions[p][t-1] != tmp_data.positions[p][t]) {
-                stationary = false;
+            if (positions[t-1] != positions[t]) {
+                stationary[p] = 0;
                 break;
             }
         }
+    });
 
-        if (stationary) {
+    size_t write_ptr = 0;
+    size_t write_offset = 0;
+
+    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
+        size_t offset = dynamics.trajs[p].offset;
+        size_t length = dynamics.trajs[p].length;
+
+        if (stationary[p]) {
             // add particle to stationary vector
             stationaries.axis_ids.push_back(dynamics.axis_ids[p]);
-            stationaries.positions.push_back(tmp_data.positions[p][0]);
-            stationaries.orientations.push_back(tmp_data.orientations[p][0]);
+            stationaries.positions.push_back(dynamics.positions[offset]);
+            stationaries.orientations.push_back(dynamics.orientations[offset]);
         } else {
             // update vectors of dynamic particles
             // this will overwrite the data of stationary particles and therefore delete them
-            // from the dynamics vector
+            // from the dynamics vector, the samples are moved to the front of the sample arrays
+            if (write_offset != offset) {
+                std::copy(dynamics.positions.begin() + offset,
+                          dynamics.positions.begin() + offset + length,
+                          dynamics.positions.begin() + write_offset);
+                std::copy(dynamics.orientations.begin() + offset,
+                          dynamics.orientations.begin() + offset + length,
+                          dynamics.orientations.begin() + write_offset);
+            }
+
             dynamics.axis_ids[write_ptr] = dynamics.axis_ids[p];
-            // for the trajs entry it is usefull to have ptr otherwise all data will be copied
-            tmp_data.positions[write_ptr] = tmp_data.positions[p];
-            tmp_data.orientations[write_ptr] = tmp_data.orientations[p];
+            dynamics.trajs[write_ptr].offset = write_offset;
+            dynamics.trajs[write_ptr].start_time = dynamics.trajs[p].start_time;
+            dynamics.trajs[write_ptr].length = length;
 
             write_ptr++;
+            write_offset += length;
         }
     }
 
     // resize all vectors of dynamic particles
     // everything after write_ptr index has to be deleted
     dynamics.axis_ids.resize(write_ptr);
-    // the shared_ptr of the trajs-vector copes with the deletion of all the vectors inside
-    tmp_data.positions.resize(write_ptr);
-    tmp_data.orientations.resize(write_ptr);
+    dynamics.trajs.resize(write_ptr);
+    dynamics.positions.resize(write_offset);
+    dynamics.orientations.resize(write_offset);
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
 
 
     // 3. set global bounding box
     std::cout << "  .. compute bounding box of data set" << std::endl;
-    for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-        for (size_t t = 0; t < tmp_data.times.size(); t++) {
-            // global bounding box
-            if (tmp_data.positions[p][t][0] < b_box.min[0])
-                b_box.min[0] = tmp_data.positions[p][t][0];
-            if (tmp_data.positions[p][t][1] < b_box.min[1])
-                b_box.min[1] = tmp_data.positions[p][t][1];
-            if (tmp_data.positions[p][t][2] < b_box.min[2])
-                b_box.min[2] = tmp_data.positions[p][t][2];
-            if (tmp_data.positions[p][t][0] > b_box.max[0])
-                b_box.max[0] = tmp_data.positions[p][t][0];
-            if (tmp_data.positions[p][t][1] > b_box.max[1])
-                b_box.max[1] = tmp_data.positions[p][t][1];
-            if (tmp_data.positions[p][t][2] > b_box.max[2])
-                b_box.max[2] = tmp_data.positions[p][t][2];
-        }
-    }
-
-    // compute center of bounding box
-    vec3 diff = b_box.max - b_box.min;
-    b_box.center = vec3(b_box.min + (diff / 2));
+    compute_data_bounding_box();
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
 
 
     // 4. handling of trajectories that moved out of bound (just x and z axis)
@@ -187,19 +373,25 @@ void data::post_process(bool cut, bool same_start, bool create_equidistant, floa
     // threshold for detection cuts
     vec3 b_box_dimensions = (b_box.max - b_box.min);
 
-    // go through all stored trajectories (here one trajectory for each particle)
-    for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-        // either cut trajectory and create new one or update position data to continue
-        // outside of the boudning box
-        if (cut) {
-            // store indices where cuts of trajectories appear
-            std::vector<size_t> cuts;
+    // either cut trajectory and create new one or update position data to continue
+    // outside of the boudning box
+    if (cut) {
+        // store indices where cuts of trajectories appear
+        std::vector<size_t> cuts;
+
+        // go through all original trajectories (here one trajectory for each particle)
+        size_t nr_trajs = dynamics.trajs.size();
+        for (size_t p = 0; p < nr_trajs; p++) {
+            size_t offset = dynamics.trajs[p].offset;
+            size_t start_time = dynamics.trajs[p].start_time;
+            size_t length = dynamics.trajs[p].length;
+            const vec3* positions = &dynamics.positions[offset];
 
             // go through each time step of trajectory
-            for (size_t t = 1; t < tmp_data.positions[p].size(); t++) {
+            cuts.clear();
+            for (size_t t = 1; t < length; t++) {
                 // if position changed by bounding box measures the particle moved out of bound
-                vec3 diff = tmp_data.positions[p][t]
-                             - tmp_data.positions[p][t-1];
+                vec3 diff = positions[t] - positions[t-1];
                 if (abs(diff[0]) > (tolerance * b_box_dimensions[0])
                         || abs(diff[2]) > (tolerance * b_box_dimensions[2])) {
                     cuts.push_back(t);
@@ -207,65 +399,56 @@ void data::post_process(bool cut, bool same_start, bool create_equidistant, floa
             }
 
             // create new trajectories for each cut
+            // a new trajectory only refers to its part of the samples of the original one,
+            // it starts at the time step of the cut and no samples are copied
             for (size_t c = 0; c < cuts.size(); c++) {
                 // size of new trajectory
                 size_t size = 0;
                 if (c == (cuts.size() - 1)) {
-                    size = tmp_data.positions[p].size() - cuts[c];
+                    size = length - cuts[c];
                 } else {
                     size = cuts[c+1] - cuts[c];
                 }
 
-                // create new trajectory data
-                // the trajectory has the same size as the original once
-                // all invalid positions are filled with NAN
-                std::vector<vec3> new_positions;
-                std::vector<vec4> new_orientations;
-                new_positions.resize(max_time_steps, NAN);
-                new_orientations.resize(max_time_steps, NAN);
-
-                std::copy(tmp_data.positions[p].begin() + cuts[c],
-                          tmp_data.positions[p].begin() + cuts[c] + size,
-                          new_positions.begin() + cuts[c]);
-                std::copy(tmp_data.orientations[p].begin() + cuts[c],
-                          tmp_data.orientations[p].begin() + cuts[c] + size,
-                          new_orientations.begin() + cuts[c]);
-
-                assert(new_positions.size() == max_time_steps
-                    && new_orientations.size() == max_time_steps
-                    && "Newly added trajectories have to be of same size than original once");
-
-                tmp_data.positions.push_back(new_positions);
-                tmp_data.orientations.push_back(new_orientations);
+                trajectory_data piece;
+                piece.offset = offset + cuts[c];
+                piece.start_time = start_time + cuts[c];
+                piece.length = size;
 
                 dynamics.axis_ids.push_back(dynamics.axis_ids[p]);
+                dynamics.trajs.push_back(piece);
             }
 
-            // fill current trajectory vector with invalid values
+            // current trajectory ends before the first cut
             if (cuts.size() > 0) {
-                std::fill(tmp_data.positions[p].begin() + cuts[0], tmp_data.positions[p].end(), vec3(NAN, NAN, NAN));
-                std::fill(tmp_data.orientations[p].begin() + cuts[0], tmp_data.orientations[p].end(), vec4(NAN, NAN, NAN, NAN));
+                dynamics.trajs[p].length = cuts[0];
             }
-        } else {
+        }
+    } else {
+        // go through all stored trajectories (here one trajectory for each particle),
+        // each one only changes its own samples
+        parallel_for(0, dynamics.trajs.size(), num_threads, [&](size_t p) {
+            vec3* positions = &dynamics.positions[dynamics.trajs[p].offset];
+
             // go through each time step of trajectory
-            for (size_t t = 1; t < tmp_data.positions[p].size(); t++) {
+            for (size_t t = 1; t < dynamics.trajs[p].length; t++) {
                 // if position changed by bounding box measures the particle moved out of bound
-                vec3 diff = tmp_data.positions[p][t]
-                            - tmp_data.positions[p][t-1];
+                vec3 diff = positions[t] - positions[t-1];
 
                 if (abs(diff[0]) > (tolerance * b_box_dimensions[0])) {
                     int multiple_box = (diff[0]) / (tolerance * b_box_dimensions[0]);
-                    tmp_data.positions[p][t] -= vec3(b_box_dimensions[0] * multiple_box, 0.0f, 0.0f);
+                    positions[t] -= vec3(b_box_dimensions[0] * multiple_box, 0.0f, 0.0f);
 
                 }
 
                 if (abs(diff[2]) > (tolerance * b_box_dimensions[2])){
                     int multiple_box = (diff[2]) / (tolerance * b_box_dimensions[2]);
-                    tmp_data.positions[p][t] -= vec3(0.0f, 0.0f, b_box_dimensions[2] * multiple_box);
+                    positions[t] -= vec3(0.0f, 0.0f, b_box_dimensions[2] * multiple_box);
                 }
             }
-        }
+        });
     }
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
 
 
     // 5. create data points that are equidistant in time
@@ -274,201 +457,158 @@ void data::post_process(bool cut, bool same_start, bool create_equidistant, floa
     float time_span = tmp_data.times[max_time_steps - 1] - tmp_data.times[0];
     float time_tick = time_span / ((float)max_time_steps - 1.0f);
 
-    // reserve space for final data structure
-    // and create initial entry
-    dynamics.times.resize(max_time_steps);
-    dynamics.times[0] = tmp_data.times[0];
-    dynamics.times[max_time_steps - 1] = tmp_data.times[max_time_steps - 1];
-    
-    dynamics.trajs.resize(tmp_data.positions.size());
-    for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-        std::shared_ptr<trajectory_data> traj(new trajectory_data());
-        traj->positions.resize(max_time_steps);
-        traj->positions[0] = tmp_data.positions[p][0];
-        traj->positions[max_time_steps - 1] = tmp_data.positions[p][max_time_steps - 1];
-        traj->orientations.resize(max_time_steps);
-        traj->orientations[0] = tmp_data.orientations[p][0];
-        traj->orientations[max_time_steps - 1] = tmp_data.orientations[p][max_time_steps - 1];
-        dynamics.trajs[p] = traj;
-    }
-
-    float time = tmp_data.times[0];
-    size_t prev = 0;
-    size_t next = 0;
-    for (size_t t = 1; t < max_time_steps - 1; t++) {
-        time += time_tick;
-
-        if (create_equidistant) {
-            // create equidistant points in time
+    dynamics.times = tmp_data.times;
+
+    if (create_equidistant) {
+        // time steps surrounding each equidistant point in time and the relative position
+        // between them, this is the same for all trajectories
+        std::vector<size_t> prevs(max_time_steps, 0);
+        std::vector<float> ratios(max_time_steps, 0.0f);
+
+        float time = tmp_data.times[0];
+        size_t prev = 0;
+        for (size_t t = 1; t < max_time_steps - 1; t++) {
+            time += time_tick;
             dynamics.times[t] = time;
 
             while (tmp_data.times[prev + 1] < time) {
                 prev++;
             }
-            next = prev + 1;
+            size_t next = prev + 1;
 
             float diff = tmp_data.times[next] - tmp_data.times[prev];
             // |-------------|------|
             // prev          t      next
             // =============== ratio
-            float ratio = (time - tmp_data.times[prev]) / diff;
+            prevs[t] = prev;
+            ratios[t] = (time - tmp_data.times[prev]) / diff;
+        }
+
+        // interpolate each trajectory in place, the original data points are needed until
+        // the end and therefore copied into a buffer for one trajectory only, blocks of
+        // trajectories are handled by different threads each with its own buffer
+        const size_t block_size = 64;
+        size_t nr_blocks = (dynamics.trajs.size() + block_size - 1) / block_size;
+
+        parallel_for(0, nr_blocks, num_threads, [&](size_t block) {
+            std::vector<vec3> original_positions;
+            std::vector<vec4> original_orientations;
+            // orientations are interpolated at once for the whole trajectory
+            std::vector<vec4> slerp_from;
+            std::vector<vec4> slerp_to;
+            std::vector<float> slerp_ratios;
+            size_t block_end = std::min((block + 1) * block_size, dynamics.trajs.size());
+
+            for (size_t p = block * block_size; p < block_end; p++) {
+                trajectory_data& traj = dynamics.trajs[p];
+                vec3* positions = &dynamics.positions[traj.offset];
+                vec4* orientations = &dynamics.orientations[traj.offset];
+                original_positions.assign(positions, positions + traj.length);
+                original_orientations.assign(orientations, orientations + traj.length);
+
+                // first and last time step of the trajectory
+                size_t first = traj.start_time;
+                size_t last = traj.start_time + traj.length - 1;
+
+                // at the ends of a cut trajectory the surrounding time steps of an equidistant
+                // point in time might not belong to the trajectory, these samples are removed
+                auto interpolatable = [&](size_t t) -> bool {
+                    return t == 0 || t == max_time_steps - 1 || (prevs[t] >= first && prevs[t] + 1 <= last);
+                };
+                size_t begin = first;
+                size_t end = last + 1;
+                while (begin < end && !interpolatable(begin))
+                    begin++;
+                while (end > begin && !interpolatable(end - 1))
+                    end--;
+
+                size_t interpolate_begin = std::max(begin, (size_t)1);
+                size_t interpolate_end = std::min(end, max_time_steps - 1);
+                slerp_from.clear();
+                slerp_to.clear();
+                slerp_ratios.clear();
+
+                for (size_t t = interpolate_begin; t < interpolate_end; t++) {
+                    size_t prev = prevs[t] - first;
+                    float ratio = ratios[t];
+
+                    positions[t - first] = (1.0f - ratio) * original_positions[prev]
+                                         + ratio * original_positions[prev + 1];
+                    slerp_from.push_back(original_orientations[prev]);
+                    slerp_to.push_back(original_orientations[prev + 1]);
+                    slerp_ratios.push_back(ratio);
+                }
+
+                if (interpolate_begin < interpolate_end)
+                    slerp_batch(slerp_from.data(), slerp_to.data(), slerp_ratios.data(),
+                                orientations + (interpolate_begin - first), slerp_ratios.size());
 
-            for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-                dynamics.trajs[p]->positions[t] = (1.0f - ratio) * tmp_data.positions[p][prev]
-                                                + ratio * tmp_data.positions[p][next];
-                dynamics.trajs[p]->orientations[t] = slerp(tmp_data.orientations[p][prev], tmp_data.orientations[p][next], ratio);
+                traj.offset += begin - first;
+                traj.start_time = begin;
+                traj.length = end - begin;
             }
-        } else {
-            // just copy the data
-            dynamics.times[t] = tmp_data.times[t];
+        });
 
-            for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-                dynamics.trajs[p]->positions[t] = tmp_data.positions[p][t];
-                dynamics.trajs[p]->orientations[t] = tmp_data.orientations[p][t];
+        // remove trajectories without any remaining sample
+        size_t write_ptr = 0;
+        for (size_t p = 0; p < dynamics.trajs.size(); p++) {
+            if (dynamics.trajs[p].length > 0) {
+                dynamics.axis_ids[write_ptr] = dynamics.axis_ids[p];
+                dynamics.trajs[write_ptr] = dynamics.trajs[p];
+                write_ptr++;
             }
         }
+        dynamics.axis_ids.resize(write_ptr);
+        dynamics.trajs.resize(write_ptr);
+
+        std::cout << "     " << timer.restart() << " ms" << std::endl;
     }
 
     // delete tmp data structure
-    tmp_data.axes.resize(0);
-    tmp_data.times.resize(0);
-    for (size_t p = 0; p < tmp_data.positions.size(); p++) {
-        tmp_data.positions[p].resize(0);
-        tmp_data.orientations[p].resize(0);
-    }
-    tmp_data.positions.resize(0);
-    tmp_data.orientations.resize(0);
+    tmp_data = input_data();
 
 
 
     // modify position to let every trajectory start at origin
     if (same_start) {
-        // reset boudning box
-        b_box.min = vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-        b_box.max = vec3(std::numeric_limits<float>::min(), std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
-
-        for (size_t p = 0; p < dynamics.trajs.size(); p++) {
-            vec3 offset = dynamics.trajs[p]->positions[0];
-            for (size_t t = 0; t < dynamics.trajs[p]->positions.size(); t++) {
-                dynamics.trajs[p]->positions[t] -= offset;
+        std::cout << "  .. move start of trajectories to origin" << std::endl;
+        parallel_for(0, dynamics.trajs.size(), num_threads, [&](size_t p) {
+            vec3* positions = &dynamics.positions[dynamics.trajs[p].offset];
+            vec3 offset = positions[0];
+            for (size_t t = 0; t < dynamics.trajs[p].length; t++) {
+                positions[t] -= offset;
             }
-        }
+        });
 
         // update global bounding box
+        reset_box(b_box);
         compute_data_bounding_box();
+        std::cout << "     " << timer.restart() << " ms" << std::endl;
     }
 
 
-    // 6. generate idices for transfering all vertex data to the gpu at once and changing
-    // indices for indexed rendering
-    std::cout << "  .. generate indices for vertex data" << std::endl;
-    unsigned int i = 0; 
-    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
-        dynamics.trajs[p]->indices_strip.reserve(dynamics.trajs[p]->positions.size());
-        dynamics.trajs[p]->indices.reserve(dynamics.trajs[p]->positions.size());
-        for (size_t t = 0; t < dynamics.trajs[p]->positions.size(); t++) {
-            dynamics.trajs[p]->indices_strip.push_back(i);
-
-            if (t < dynamics.trajs[p]->positions.size() - 1) {
-                dynamics.trajs[p]->indices.push_back(i);
-                dynamics.trajs[p]->indices.push_back(i + 1);
-            } else {
-                dynamics.trajs[p]->indices.push_back(i);
-                dynamics.trajs[p]->indices.push_back(i);
-            }
-            
-            i++;
-        }
-
-        assert(dynamics.trajs[p]->positions.size() == dynamics.trajs[p]->orientations.size()
-           && dynamics.trajs[p]->positions.size() == dynamics.trajs[p]->indices_strip.size()
-           && "Each data vector for a trajectory has to be of same size");
-    }
-
-
-    // 7. compute bounding box of each trajectory
-    std::cout << "  .. compute bounding box of each trajectories" << std::endl;
-    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
-        dynamics.trajs[p]->b_box.min = vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-        dynamics.trajs[p]->b_box.max = vec3(std::numeric_limits<float>::min(), std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
-
-        for (size_t t = 0; t < dynamics.trajs[p]->positions.size(); t++) {
-            // check for trajectory bounding box
-            if (dynamics.trajs[p]->positions[t][0] < dynamics.trajs[p]->b_box.min[0])
-                dynamics.trajs[p]->b_box.min[0] = dynamics.trajs[p]->positions[t][0];
-            if (dynamics.trajs[p]->positions[t][1] < dynamics.trajs[p]->b_box.min[1])
-                dynamics.trajs[p]->b_box.min[1] = dynamics.trajs[p]->positions[t][1];
-            if (dynamics.trajs[p]->positions[t][2] < dynamics.trajs[p]->b_box.min[2])
-                dynamics.trajs[p]->b_box.min[2] = dynamics.trajs[p]->positions[t][2];
-            if (dynamics.trajs[p]->positions[t][0] > dynamics.trajs[p]->b_box.max[0])
-                dynamics.trajs[p]->b_box.max[0] = dynamics.trajs[p]->positions[t][0];
-            if (dynamics.trajs[p]->positions[t][1] > dynamics.trajs[p]->b_box.max[1])
-                dynamics.trajs[p]->b_box.max[1] = dynamics.trajs[p]->positions[t][1];
-            if (dynamics.trajs[p]->positions[t][2] > dynamics.trajs[p]->b_box.max[2])
-                dynamics.trajs[p]->b_box.max[2] = dynamics.trajs[p]->positions[t][2];
-        }
-
-        vec3 traj_diff = dynamics.trajs[p]->b_box.max - dynamics.trajs[p]->b_box.min;
-        dynamics.trajs[p]->b_box.center = vec3(dynamics.trajs[p]->b_box.min + (traj_diff / 2));
-    }
-
-
-    // 8. computing linear and angular velocities
-    std::cout << "  .. compute linear and angular velocities" << std::endl;
-    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
-        dynamics.trajs[p]->angular_velocities.resize(dynamics.trajs[p]->orientations.size());
-        dynamics.trajs[p]->velocities.resize(dynamics.trajs[p]->orientations.size());
-
-        for (size_t t = 0; t < dynamics.trajs[p]->orientations.size() - 1; t++) {
-            // compute angular velocity between current and next time step
-            // quaternion that q * q0 = q1 --> q = q1 * conj(q0) (for unit length quaternions)
-            vec4 conj_q0 = vec4(-1 * dynamics.trajs[p]->orientations[t][0],
-                                -1 * dynamics.trajs[p]->orientations[t][1],
-                                -1 * dynamics.trajs[p]->orientations[t][2],
-                                dynamics.trajs[p]->orientations[t][3]);
-            vec4 quat = quat_mul(dynamics.trajs[p]->orientations[t + 1], conj_q0);
-            
-            // convert quaternion to axis and angle in radians
-            double len = sqrt(quat[0] * quat[0] + quat[1] * quat[1] + quat[2] * quat[2]);
-            double angle = 2.0f * atan2(len, quat[3]);
-            vec3 axis;
-            if (len > 0)
-                axis = vec3(quat[0], quat[1], quat[2]) / len;
-            else
-                axis = vec3(1,0,0);
-
-            // rotation velocity
-            vec3 w = axis * angle / 1.0f;
-
-            dynamics.trajs[p]->angular_velocities[t] = w;
-            dynamics.trajs[p]->velocities[t] = dynamics.trajs[p]->positions[t + 1] - 
-                                               dynamics.trajs[p]->positions[t];
-        }
-
-        dynamics.trajs[p]->angular_velocities[dynamics.trajs[p]->orientations.size() - 1] = vec3(NAN, NAN, NAN);
-        dynamics.trajs[p]->velocities[dynamics.trajs[p]->orientations.size() - 1] = vec3(NAN, NAN, NAN);
-    }
-
-
-    // 9. computing normal: crossproduct of axis and velocity
-    std::cout << "  .. compute normals for each time step" << std::endl;
-    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
-        dynamics.trajs[p]->main_axis_normals.resize(dynamics.trajs[p]->orientations.size());
-
-        for (size_t t = 0; t < dynamics.trajs[p]->orientations.size() - 1; t++) {
-            // compute orientated main axis (assumes longest axis at position 0)
-            // TODO: compute for all axis
-            vec3 a = quat_rotate(vec3(axes[dynamics.axis_ids[p]][0], 0.0f, 0.0f), dynamics.trajs[p]->orientations[t]);
-            vec3 v = dynamics.trajs[p]->velocities[t];
-            vec3 n = normalize(cross(v, a));
-
-            dynamics.trajs[p]->main_axis_normals[t] = n;
-        }
-
-        dynamics.trajs[p]->main_axis_normals[dynamics.trajs[p]->orientations.size() - 1] = vec3(NAN, NAN, NAN);
-        // std::cout << dynamics.trajs[p]->main_axis_normals.size() << std::endl;
-    }
-
+    // 6. compute bounding box of each trajectory
+    // velocities, angular velocities and normals are derived on first use (see data_derived.cxx)
+    std::cout << "  .. compute bounding box of each trajectory" << std::endl;
+    parallel_for(0, dynamics.trajs.size(), num_threads, [&](size_t p) {
+        trajectory_data& traj = dynamics.trajs[p];
+        const vec3* positions = &dynamics.positions[traj.offset];
+
+        reset_box(traj.b_box);
+        for (size_t t = 0; t < traj.length; t++)
+            extend_box(traj.b_box, positions[t]);
+        center_box(traj.b_box);
+    });
+    reset_derived_attributes();
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
+
+    // 7. build bounding volume hierarchy over bounding boxes of trajectories, segment trees
+    // over bounding boxes of time windows and level of detail of each trajectory
+    std::cout << "  .. build bounding volume hierarchy, segment trees and level of detail of trajectories" << std::endl;
+    traj_bvh.build(dynamics.trajs);
+    traj_segments.build(dynamics.trajs, dynamics.positions, num_threads);
+    traj_lod.build(dynamics.trajs, dynamics.positions, num_threads);
+    std::cout << "     " << timer.restart() << " ms" << std::endl;
 
     // check vector sizes
     assert(dynamics.axis_ids.size() == dynamics.trajs.size()
@@ -477,31 +617,58 @@ void data::post_process(bool cut, bool same_start, bool create_equidistant, floa
     std::cout << "Data Stats: " << std::endl;
     std::cout << "  number of stationaries particles: " << stationaries.axis_ids.size() << std::endl;
     std::cout << "  number of dynamic particles (trajectories): " << dynamics.axis_ids.size() << " of " << dynamics.trajs.size() - stationaries.axis_ids.size() << " original particles" << std::endl;
+    std::cout << "  post processing time: " << total_timer.restart() << " ms" << std::endl;
+    std::cout << "  peak memory usage: " << peak_memory_usage() / (1024 * 1024) << " MB" << std::endl;
 }
 
 void data::compute_data_bounding_box()
 {
-    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
-        for (size_t t = 0; t < dynamics.trajs[p]->positions.size(); t++) {
-            // global bounding box
-            if (dynamics.trajs[p]->positions[t][0] < b_box.min[0])
-                b_box.min[0] = dynamics.trajs[p]->positions[t][0];
-            if (dynamics.trajs[p]->positions[t][1] < b_box.min[1])
-                b_box.min[1] = dynamics.trajs[p]->positions[t][1];
-            if (dynamics.trajs[p]->positions[t][2] < b_box.min[2])
-                b_box.min[2] = dynamics.trajs[p]->positions[t][2];
-            if (dynamics.trajs[p]->positions[t][0] > b_box.max[0])
-                b_box.max[0] = dynamics.trajs[p]->positions[t][0];
-            if (dynamics.trajs[p]->positions[t][1] > b_box.max[1])
-                b_box.max[1] = dynamics.trajs[p]->positions[t][1];
-            if (dynamics.trajs[p]->positions[t][2] > b_box.max[2])
-                b_box.max[2] = dynamics.trajs[p]->positions[t][2];
-        }
+    // every thread reduces its own consecutive range of samples to a bounding box,
+    // these partial boxes are merged afterwards
+    unsigned int threads = num_threads > 0 ? num_threads : default_thread_count();
+    size_t range_size = (dynamics.positions.size() + threads - 1) / threads;
+    std::vector<Bounding_Box> partial_boxes(threads);
+
+    parallel_for(0, threads, threads, [&](size_t r) {
+        Bounding_Box& box = partial_boxes[r];
+        reset_box(box);
+
+        size_t range_end = std::min((r + 1) * range_size, dynamics.positions.size());
+        for (size_t i = r * range_size; i < range_end; i++)
+            extend_box(box, dynamics.positions[i]);
+    });
+
+    // global bounding box
+    for (size_t r = 0; r < partial_boxes.size(); r++)
+        merge_box(b_box, partial_boxes[r]);
+
+    center_box(b_box);
+}
+
+std::vector<size_t> data::select_files(int start, int end, int time_resolution)
+{
+    std::vector<size_t> selected;
+    for (int i = start; i <= end; i++) {
+        if (i % time_resolution == 0)
+            selected.push_back((size_t)i);
     }
+    return selected;
+}
 
-    // compute center of bounding box
-    vec3 diff = b_box.max - b_box.min;
-    b_box.center = vec3(b_box.min + (diff / 2));
+void data::allocate_data(size_t number_particles, size_t time_steps)
+{
+    tmp_data.axes.resize(number_particles);
+    tmp_data.times.resize(time_steps);
+
+    // one trajectory per particle that is filled directly by the readers
+    dynamics.trajs.resize(number_particles);
+    for (size_t p = 0; p < number_particles; p++) {
+        dynamics.trajs[p].offset = p * time_steps;
+        dynamics.trajs[p].start_time = 0;
+        dynamics.trajs[p].length = time_steps;
+    }
+    dynamics.positions.resize(number_particles * time_steps);
+    dynamics.orientations.resize(number_particles * time_steps);
 }
 
 bool data::read_f90_file(std::string file_name, size_t t, size_t number_particles)
@@ -674,13 +841,13 @@ bool data::read_f90_file(std::string file_name, size_t t, size_t number_particle
             tmp_data.axes[i] = vec3((float)s_a, (float)s_b, (float)s_c);
         }
 
-        tmp_data.positions[i][t] = vec3((float)s_x1,
-                                        (float)s_x2,
-                                        (float)s_x3);
-        tmp_data.orientations[i][t] = vec4((float)s_q0,
-                                           (float)s_q1,
-                                           (float)s_q2,
-                                           (float)s_q3);
+        dynamics.positions[dynamics.trajs[i].offset + t] = vec3((float)s_x1,
+                                                                (float)s_x2,
+                                                                (float)s_x3);
+        dynamics.orientations[dynamics.trajs[i].offset + t] = vec4((float)s_q0,
+                                                                   (float)s_q1,
+                                                                   (float)s_q2,
+                                                                   (float)s_q3);
     
         // store physical time only for first particle (same for all other)
         if (i == 0)
@@ -699,6 +866,147 @@ bool data::read_f90_file(std::string file_name, size_t t, size_t number_particle
     return true;
 }
 
+bool data::open_f90_file(const std::string& file_name, size_t t, size_t number_particles, mapped_file& file)
+{
+    if (!file.open(file_name)) {
+        return false;
+    }
+
+    // the size of the file is fully determined by the number of particles
+    if (file.size() != f90_header_size + number_particles * f90_particle_size) {
+        std::cerr << "ERROR: unexpected size of file " << file_name << std::endl;
+        return false;
+    }
+
+    const unsigned char* ptr = file.data();
+
+    // check header records and read number of particles and time
+    if (mapped_read<uint32_t>(ptr) != 4 || mapped_read<uint32_t>(ptr + 8) != 4
+            || mapped_read<uint32_t>(ptr + 12) != 8 || mapped_read<uint32_t>(ptr + 24) != 8) {
+        std::cerr << "ERROR: invalid header records in file " << file_name << std::endl;
+        return false;
+    }
+
+    if (mapped_read<uint32_t>(ptr + 4) != number_particles) {
+        std::cerr << "ERROR: unexpected number of particles in file " << file_name << std::endl;
+        return false;
+    }
+
+    // store physical time (same for all particles)
+    tmp_data.times[t] = (float)mapped_read<double>(ptr + 16);
+
+    return true;
+}
+
+bool data::decode_f90_particle(const unsigned char* file_data, size_t t, size_t i)
+{
+    const unsigned char* ptr = file_data + f90_header_size + i * f90_particle_size;
+
+    // validate all record lengths of this particle at once
+    for (size_t m = 0; m < 14; m++) {
+        if (mapped_read<uint32_t>(ptr + f90_particle_markers[m][0]) != f90_particle_markers[m][1]) {
+            return false;
+        }
+    }
+
+    double s_x[3];
+    double s_q[4];
+    std::memcpy(s_x, ptr + 4, sizeof(s_x));
+    std::memcpy(s_q, ptr + 68, sizeof(s_q));
+
+    // store this data only once
+    if (t == 0) {
+        tmp_data.axes[i] = vec3((float)mapped_read<double>(ptr + 108),
+                                (float)mapped_read<double>(ptr + 124),
+                                (float)mapped_read<double>(ptr + 140));
+    }
+
+    dynamics.positions[dynamics.trajs[i].offset + t] = vec3((float)s_x[0], (float)s_x[1], (float)s_x[2]);
+    dynamics.orientations[dynamics.trajs[i].offset + t] = vec4((float)s_q[0], (float)s_q[1], (float)s_q[2], (float)s_q[3]);
+
+    return true;
+}
+
+bool data::read_f90_file_mapped(std::string file_name, size_t t, size_t number_particles)
+{
+    // same layout as in read_f90_file, but the whole file is mapped into memory and
+    // every particle record is a fixed size block that can be decoded at once
+    mapped_file file;
+
+    if (!open_f90_file(file_name, t, number_particles, file)) {
+        return false;
+    }
+
+    // read data of each particle
+    for (size_t i = 0; i < number_particles; i++) {
+        if (!decode_f90_particle(file.data(), t, i)) {
+            std::cerr << "ERROR: invalid record of particle " << i << " in file " << file_name << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool data::benchmark_readers(std::vector<std::pair<double, std::string>>& files, int start, int end, int time_resolution)
+{
+    std::cout << "benchmark file readers ... " << std::endl;
+
+    size_t number_particles;
+    if (!read_number_particles(files[start].second, number_particles))
+        return false;
+
+    std::vector<size_t> selected = select_files(start, end, time_resolution);
+
+    // 1. stream based reader
+    allocate_data(number_particles, selected.size());
+
+    bool success = true;
+    auto stream_start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < selected.size(); index++) {
+        success = read_f90_file(files[selected[index]].second, index, number_particles) && success;
+    }
+    auto stream_end = std::chrono::steady_clock::now();
+
+    input_data stream_data;
+    dynamic_particle_data stream_dynamics;
+    std::swap(stream_data, tmp_data);
+    std::swap(stream_dynamics, dynamics);
+
+    // 2. memory mapped reader
+    allocate_data(number_particles, selected.size());
+
+    auto mapped_start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < selected.size(); index++) {
+        success = read_f90_file_mapped(files[selected[index]].second, index, number_particles) && success;
+    }
+    auto mapped_end = std::chrono::steady_clock::now();
+
+    // 3. both readers have to produce exactly the same data
+    bool equal = stream_data.axes == tmp_data.axes
+              && stream_data.times == tmp_data.times
+              && stream_dynamics.positions == dynamics.positions
+              && stream_dynamics.orientations == dynamics.orientations;
+
+    std::chrono::duration<double, std::ratio<1,1000>> stream_time = stream_end - stream_start;
+    std::chrono::duration<double, std::ratio<1,1000>> mapped_time = mapped_end - mapped_start;
+
+    std::cout << "  files: " << selected.size() << ", particles: " << number_particles << std::endl;
+    std::cout << "  stream reader: " << stream_time.count() << " ms" << std::endl;
+    std::cout << "  mapped reader: " << mapped_time.count() << " ms" << std::endl;
+    std::cout << "  speedup: " << stream_time.count() / mapped_time.count() << std::endl;
+    std::cout << "  results " << (equal ? "are equal" : "DIFFER") << std::endl;
+
+    // release memory
+    tmp_data = input_data();
+    dynamics = dynamic_particle_data();
+
+    if (!success)
+        std::cerr << "ERROR: reading data for benchmark" << std::endl;
+
+    return success && equal;
+}
+
 bool data::generate_random(size_t _number_particles, size_t _time_steps, float start_velocity, int seed, bool cut_trajs, bool same_start)
 {
     // parameter
@@ -734,20 +1042,7 @@ bool data::generate_random(size_t _number_particles, size_t _time_steps, float s
     
     std::cout << "  with seed: " << _seed << std::endl;
     std::cout << "  .. reserve memory" << std::endl;
-    tmp_data.axes.resize(_number_particles);
-    tmp_data.positions.resize(_number_particles);
-    tmp_data.orientations.resize(_number_particles);
-    tmp_data.times.resize(max_time_steps);
-
-    for (size_t p = 0; p < _number_particles; p++) {
-        std::vector<vec3> pos;
-        pos.resize(max_time_steps);
-        tmp_data.positions[p] = pos;
-
-        std::vector<vec4> orientation;
-        orientation.resize(max_time_steps);
-        tmp_data.orientations[p] = orientation;
-    }
+    allocate_data(_number_particles, max_time_steps);
 
     std::cout << "  .. generate axes, positions and orientations" << std::endl;
 
@@ -786,7 +1081,7 @@ bool data::generate_random(size_t _number_particles, size_t _time_steps, float s
                                                    gaussian_z(mt_rand));
             vec3 position = prev_position + direction;
 
-            tmp_data.positions[p][t] = position;
+            dynamics.positions[dynamics.trajs[p].offset + t] = position;
             prev_position = position;
             prev_direction = direction;
 
@@ -803,7 +1098,7 @@ bool data::generate_random(size_t _number_particles, size_t _time_steps, float s
             
             vec4 orientation = normalize(to_quat(euler_angle[0], euler_angle[1], euler_angle[2]));
 
-            tmp_data.orientations[p][t] = orientation;
+            dynamics.orientations[dynamics.trajs[p].offset + t] = orientation;
             prev_euler_angle = euler_angle;
         }
     }
@@ -829,20 +1124,7 @@ bool data::generate_sample()
     size_t _number_particles = 7;
     max_time_steps = 1000;
     
-    tmp_data.axes.resize(_number_particles);
-    tmp_data.positions.resize(_number_particles);
-    tmp_data.orientations.resize(_number_particles);
-    tmp_data.times.resize(max_time_steps);
-
-    for (size_t p = 0; p < _number_particles; p++) {
-        std::vector<vec3> pos;
-        pos.resize(max_time_steps);
-        tmp_data.positions[p] = pos;
-
-        std::vector<vec4> orientation;
-        orientation.resize(max_time_steps);
-        tmp_data.orientations[p] = orientation;
-    }
+    allocate_data(_number_particles, max_time_steps);
 
     // 1. straight trajectory
     tmp_data.axes[0] = axes;
@@ -852,35 +1134,35 @@ bool data::generate_sample()
     vec3 prev_position = vec3(1.0f, 1.0f, 1.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.01f, 0.0f, 0.0f);
-        tmp_data.positions[0][t] = position;
+        dynamics.positions[dynamics.trajs[0].offset + t] = position;
         prev_position = position;
         
-        tmp_data.orientations[0][t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        dynamics.orientations[dynamics.trajs[0].offset + t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
         tmp_data.times[t] = (float)t;
     }
     prev_position = vec3(1.0f, 1.0f, 1.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.0f, 0.01f, 0.0f);
-        tmp_data.positions[1][t] = position;
+        dynamics.positions[dynamics.trajs[1].offset + t] = position;
         prev_position = position;
         
-        tmp_data.orientations[1][t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        dynamics.orientations[dynamics.trajs[1].offset + t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     }
     prev_position = vec3(1.0f, 1.0f, 1.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.0f, 0.00f, 0.01f);
-        tmp_data.positions[2][t] = position;
+        dynamics.positions[dynamics.trajs[2].offset + t] = position;
         prev_position = position;
         
-        tmp_data.orientations[2][t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        dynamics.orientations[dynamics.trajs[2].offset + t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     }
     prev_position = vec3(1.0f, 1.0f, 1.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.01f, 0.01f, 0.01f);
-        tmp_data.positions[3][t] = position;
+        dynamics.positions[dynamics.trajs[3].offset + t] = position;
         prev_position = position;
         
-        tmp_data.orientations[3][t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        dynamics.orientations[dynamics.trajs[3].offset + t] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     }
 
     // 1. rotating trajectory
@@ -891,42 +1173,42 @@ bool data::generate_sample()
     vec3 prev_euler_angle = vec3(0.0f, 0.0f, 0.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.01f, 0.01f, 0.0f);
-        tmp_data.positions[4][t] = position;
+        dynamics.positions[dynamics.trajs[4].offset + t] = position;
         prev_position = position;
 
         vec3 euler_angle = prev_euler_angle + vec3(M_PI / 200.0f, 0.0f, 0.0f);
         
-        tmp_data.orientations[4][t] = normalize(to_quat(euler_angle[0],
-                                                               euler_angle[1],
-                                                               euler_angle[2]));
+        dynamics.orientations[dynamics.trajs[4].offset + t] = normalize(to_quat(euler_angle[0],
+                                                                                euler_angle[1],
+                                                                                euler_angle[2]));
         prev_euler_angle = euler_angle;
     }
     prev_position = vec3(1.0f, 1.0f, 1.0f);
     prev_euler_angle = vec3(0.0f, 0.0f, 0.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.0f, 0.01f, 0.01f);
-        tmp_data.positions[5][t] = position;
+        dynamics.positions[dynamics.trajs[5].offset + t] = position;
         prev_position = position;
         
         vec3 euler_angle = prev_euler_angle + vec3(0.0f, M_PI / 200.0f, 0.0f);
         
-        tmp_data.orientations[5][t] = normalize(to_quat(euler_angle[0],
-                                                               euler_angle[1],
-                                                               euler_angle[2]));
+        dynamics.orientations[dynamics.trajs[5].offset + t] = normalize(to_quat(euler_angle[0],
+                                                                                euler_angle[1],
+                                                                                euler_angle[2]));
         prev_euler_angle = euler_angle;
     }
     prev_position = vec3(1.0f, 1.0f, 1.0f);
     prev_euler_angle = vec3(0.0f, 0.0f, 0.0f);
     for (size_t t = 0; t < max_time_steps; t++) {
         vec3 position = prev_position + vec3(0.01f, 0.0f, 0.01f);
-        tmp_data.positions[6][t] = position;
+        dynamics.positions[dynamics.trajs[6].offset + t] = position;
         prev_position = position;
         
         vec3 euler_angle = prev_euler_angle + vec3(0.0f, 0.0f, M_PI / 200.0f);
         
-        tmp_data.orientations[6][t] = normalize(to_quat(euler_angle[0],
-                                                               euler_angle[1],
-                                                               euler_angle[2]));
+        dynamics.orientations[dynamics.trajs[6].offset + t] = normalize(to_quat(euler_angle[0],
+                                                                                euler_angle[1],
+                                                                                euler_angle[2]));
         prev_euler_angle = euler_angle;
     }
 
@@ -0,0 +1,325 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#include "data.h"
+#include "file_utils.h"
+
+namespace ellipsoid_trajectory {
+
+// has to be increased whenever the layout of the cache or the result of post_process changes
+static const uint32_t cache_version = 4;
+static const char cache_magic[8] = { 'E', 'T', 'V', 'C', 'A', 'C', 'H', 'E' };
+
+/*
+    cache file layout (native byte order):
+
+    cache_header
+    vec3     axes[number_axes]
+    float    times[max_time_steps]
+    uint64   stationary axis_ids[number_stationaries]
+    vec3     stationary positions[number_stationaries]
+    vec4     stationary orientations[number_stationaries]
+    uint64   dynamic axis_ids[number_trajs]
+    cache_traj trajs[number_trajs]
+    vec3     positions[number_samples]           // sample arrays of dynamic_particle_data
+    vec4     orientations[number_samples]
+
+    derived attributes are not stored since they are computed on first use
+*/
+struct cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t value_size;        // size of float to detect incompatible builds
+    uint64_t key;               // hash of input files and preprocessing options
+    uint64_t max_time_steps;
+    uint64_t number_axes;
+    uint64_t number_stationaries;
+    uint64_t number_trajs;
+    uint64_t number_samples;    // size of the sample arrays
+    float b_box[9];
+    uint32_t padding;
+};
+
+struct cache_traj
+{
+    float b_box[9];
+    uint32_t padding;
+    uint64_t offset;
+    uint64_t start_time;
+    uint64_t length;
+};
+
+// FNV-1a hash over raw bytes
+static void hash_bytes(uint64_t& hash, const void* bytes, size_t size)
+{
+    const unsigned char* ptr = (const unsigned char*)bytes;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= ptr[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+template<typename T>
+static void hash_value(uint64_t& hash, const T& value)
+{
+    hash_bytes(hash, &value, sizeof(T));
+}
+
+static void write_box(float* values, const Bounding_Box& box)
+{
+    for (int i = 0; i < 3; i++) {
+        values[i] = box.min[i];
+        values[3 + i] = box.max[i];
+        values[6 + i] = box.center[i];
+    }
+}
+
+static void read_box(const float* values, Bounding_Box& box)
+{
+    for (int i = 0; i < 3; i++) {
+        box.min[i] = values[i];
+        box.max[i] = values[3 + i];
+        box.center[i] = values[6 + i];
+    }
+}
+
+template<typename T>
+static const unsigned char* read_array(const unsigned char* ptr, T* values, size_t count)
+{
+    if (count > 0)
+        std::memcpy(values, ptr, count * sizeof(T));
+    return ptr + count * sizeof(T);
+}
+
+static const unsigned char* read_ids(const unsigned char* ptr, std::vector<size_t>& ids, size_t count)
+{
+    ids.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t id;
+        std::memcpy(&id, ptr + i * sizeof(uint64_t), sizeof(uint64_t));
+        ids[i] = (size_t)id;
+    }
+    return ptr + count * sizeof(uint64_t);
+}
+
+template<typename T>
+static void write_array(std::ofstream& file, const T* values, size_t count)
+{
+    if (count > 0)
+        file.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+static void write_ids(std::ofstream& file, const std::vector<size_t>& ids)
+{
+    std::vector<uint64_t> values(ids.begin(), ids.end());
+    write_array(file, values.data(), values.size());
+}
+
+std::string data::cache_file_name(const std::string& data_file_name)
+{
+    size_t index = data_file_name.find_last_of("/\\");
+    std::string directory = (index == std::string::npos) ? "." : data_file_name.substr(0, index);
+    return directory + "/trajectory-vis.cache";
+}
+
+bool data::compute_cache_key(std::vector<std::pair<double, std::string>>& files, std::vector<size_t>& selected, bool cut, bool same_start, bool create_equidistant, float tolerance, uint64_t& key)
+{
+    // FNV-1a offset basis
+    key = 14695981039346656037ull;
+    hash_value(key, cache_version);
+
+    // a changed, added or removed input file invalidates the cache
+    hash_value(key, (uint64_t)selected.size());
+    for (size_t i = 0; i < selected.size(); i++) {
+        const std::string& file_name = files[selected[i]].second;
+
+        file_info info;
+        if (!get_file_info(file_name, info))
+            return false;
+
+        hash_bytes(key, file_name.data(), file_name.size());
+        hash_value(key, info.size);
+        hash_value(key, info.modified);
+    }
+
+    // and so does every option that changes the result of post_process
+    hash_value(key, (uint8_t)cut);
+    hash_value(key, (uint8_t)same_start);
+    hash_value(key, (uint8_t)create_equidistant);
+    hash_value(key, tolerance);
+
+    return true;
+}
+
+bool data::read_cache(const std::string& file_name, uint64_t key)
+{
+    mapped_file file;
+    if (!file.open(file_name) || file.size() < sizeof(cache_header))
+        return false;
+
+    cache_header header;
+    std::memcpy(&header, file.data(), sizeof(cache_header));
+
+    if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+            || header.version != cache_version
+            || header.value_size != sizeof(float)) {
+        std::cout << "  .. cache has incompatible format" << std::endl;
+        return false;
+    }
+
+    if (header.key != key) {
+        std::cout << "  .. cache is out of date" << std::endl;
+        return false;
+    }
+
+    // check size before touching any data to never end up with a partially filled data set
+    uint64_t expected_size = sizeof(cache_header)
+                           + header.number_axes * sizeof(vec3)
+                           + header.max_time_steps * sizeof(float)
+                           + header.number_stationaries * (sizeof(uint64_t) + sizeof(vec3) + sizeof(vec4))
+                           + header.number_trajs * (sizeof(uint64_t) + sizeof(cache_traj))
+                           + header.number_samples * (sizeof(vec3) + sizeof(vec4));
+    if (file.size() != expected_size) {
+        std::cerr << "ERROR: cache file " << file_name << " is corrupted" << std::endl;
+        return false;
+    }
+
+    const unsigned char* ptr = file.data() + sizeof(cache_header);
+
+    max_time_steps = (size_t)header.max_time_steps;
+    read_box(header.b_box, b_box);
+
+    axes.resize((size_t)header.number_axes);
+    ptr = read_array(ptr, axes.data(), axes.size());
+
+    dynamics.times.resize(max_time_steps);
+    ptr = read_array(ptr, dynamics.times.data(), max_time_steps);
+
+    size_t number_stationaries = (size_t)header.number_stationaries;
+    ptr = read_ids(ptr, stationaries.axis_ids, number_stationaries);
+    stationaries.positions.resize(number_stationaries);
+    ptr = read_array(ptr, stationaries.positions.data(), number_stationaries);
+    stationaries.orientations.resize(number_stationaries);
+    ptr = read_array(ptr, stationaries.orientations.data(), number_stationaries);
+
+    size_t number_trajs = (size_t)header.number_trajs;
+    ptr = read_ids(ptr, dynamics.axis_ids, number_trajs);
+
+    std::vector<cache_traj> traj_table(number_trajs);
+    ptr = read_array(ptr, traj_table.data(), number_trajs);
+
+    size_t number_samples = (size_t)header.number_samples;
+    bool valid = true;
+
+    // every particle has to refer to an existing axis
+    for (size_t i = 0; i < number_stationaries; i++) {
+        if (stationaries.axis_ids[i] >= header.number_axes)
+            valid = false;
+    }
+    for (size_t p = 0; p < number_trajs; p++) {
+        if (dynamics.axis_ids[p] >= header.number_axes)
+            valid = false;
+    }
+
+    dynamics.trajs.resize(number_trajs);
+    for (size_t p = 0; p < number_trajs; p++) {
+        read_box(traj_table[p].b_box, dynamics.trajs[p].b_box);
+        dynamics.trajs[p].offset = (size_t)traj_table[p].offset;
+        dynamics.trajs[p].start_time = (size_t)traj_table[p].start_time;
+        dynamics.trajs[p].length = (size_t)traj_table[p].length;
+
+        // every trajectory has to refer to existing samples and time steps
+        if (traj_table[p].length == 0
+                || traj_table[p].offset + traj_table[p].length > header.number_samples
+                || traj_table[p].start_time + traj_table[p].length > header.max_time_steps)
+            valid = false;
+    }
+
+    if (!valid) {
+        std::cerr << "ERROR: cache file " << file_name << " is corrupted" << std::endl;
+        axes.clear();
+        stationaries = stationary_particle_data();
+        dynamics = dynamic_particle_data();
+        return false;
+    }
+
+    dynamics.positions.resize(number_samples);
+    ptr = read_array(ptr, dynamics.positions.data(), number_samples);
+    dynamics.orientations.resize(number_samples);
+    ptr = read_array(ptr, dynamics.orientations.data(), number_samples);
+
+    reset_derived_attributes();
+    traj_bvh.build(dynamics.trajs);
+    traj_segments.build(dynamics.trajs, dynamics.positions, num_threads);
+    traj_lod.build(dynamics.trajs, dynamics.positions, num_threads);
+
+    return true;
+}
+
+bool data::write_cache(const std::string& file_name, uint64_t key)
+{
+    cache_header header;
+    std::memset(&header, 0, sizeof(cache_header));
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = cache_version;
+    header.value_size = sizeof(float);
+    header.key = key;
+    header.max_time_steps = max_time_steps;
+    header.number_axes = axes.size();
+    header.number_stationaries = stationaries.axis_ids.size();
+    header.number_trajs = dynamics.trajs.size();
+    header.number_samples = dynamics.positions.size();
+    write_box(header.b_box, b_box);
+
+    std::vector<cache_traj> traj_table(dynamics.trajs.size());
+    for (size_t p = 0; p < dynamics.trajs.size(); p++) {
+        std::memset(&traj_table[p], 0, sizeof(cache_traj));
+        write_box(traj_table[p].b_box, dynamics.trajs[p].b_box);
+        traj_table[p].offset = dynamics.trajs[p].offset;
+        traj_table[p].start_time = dynamics.trajs[p].start_time;
+        traj_table[p].length = dynamics.trajs[p].length;
+    }
+
+    // write to temporary file first so that an interrupted write never leaves a broken cache
+    std::string tmp_file_name = file_name + ".tmp";
+    std::ofstream file(tmp_file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "WARNING: could not create cache file " << file_name << std::endl;
+        return false;
+    }
+
+    write_array(file, &header, 1);
+    write_array(file, axes.data(), axes.size());
+    write_array(file, dynamics.times.data(), max_time_steps);
+    write_ids(file, stationaries.axis_ids);
+    write_array(file, stationaries.positions.data(), stationaries.positions.size());
+    write_array(file, stationaries.orientations.data(), stationaries.orientations.size());
+    write_ids(file, dynamics.axis_ids);
+    write_array(file, traj_table.data(), traj_table.size());
+
+    write_array(file, dynamics.positions.data(), dynamics.positions.size());
+    write_array(file, dynamics.orientations.data(), dynamics.orientations.size());
+
+    file.close();
+    if (!file) {
+        std::cerr << "WARNING: could not write cache file " << file_name << std::endl;
+        std::remove(tmp_file_name.c_str());
+        return false;
+    }
+
+    // rename does not replace existing files on every platform
+    std::remove(file_name.c_str());
+    if (std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) {
+        std::cerr << "WARNING: could not write cache file " << file_name << std::endl;
+        std::remove(tmp_file_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+}
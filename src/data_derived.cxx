@@ -0,0 +1,202 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "data.h"
+#include "math_utils.h"
+#include "parallel.h"
+
+namespace ellipsoid_trajectory {
+
+const size_t derived_attribute_cache::chunk_size;
+
+// number of trajectories one thread computes at once with its own buffers
+static const size_t derived_block_size = 64;
+
+static size_t chunk_bytes(const derived_chunk& chunk)
+{
+    return chunk.offsets.size() * sizeof(size_t)
+         + (chunk.velocities.size() + chunk.angular_velocities.size() + chunk.main_axis_normals.size()) * sizeof(vec3);
+}
+
+// buffers of one thread for the batched quaternion functions
+struct derived_scratch
+{
+    std::vector<vec4> conj_orientations;
+    std::vector<vec4> rotations;
+    std::vector<vec3> oriented_axes;
+};
+
+// computes the derived attributes of trajectory p into the given arrays of its length
+static void compute_derived_attributes(const dynamic_particle_data& dynamics, const std::vector<vec3>& axes, size_t p,
+                                       vec3* velocities, vec3* angular_velocities, vec3* main_axis_normals, derived_scratch& scratch)
+{
+    const trajectory_data& traj = dynamics.trajs[p];
+    const vec3* positions = &dynamics.positions[traj.offset];
+    const vec4* orientations = &dynamics.orientations[traj.offset];
+    size_t steps = traj.length - 1;
+
+    // rotation between current and next time step
+    // quaternion that q * q0 = q1 --> q = q1 * conj(q0) (for unit length quaternions)
+    scratch.conj_orientations.resize(steps);
+    for (size_t t = 0; t < steps; t++) {
+        scratch.conj_orientations[t] = vec4(-1 * orientations[t][0],
+                                            -1 * orientations[t][1],
+                                            -1 * orientations[t][2],
+                                            orientations[t][3]);
+    }
+    scratch.rotations.resize(steps);
+    quat_mul_batch(orientations + 1, scratch.conj_orientations.data(), scratch.rotations.data(), steps);
+
+    // orientated main axis (assumes longest axis at position 0)
+    // TODO: compute for all axis
+    scratch.oriented_axes.resize(steps);
+    quat_rotate_batch(vec3(axes[dynamics.axis_ids[p]][0], 0.0f, 0.0f), orientations, scratch.oriented_axes.data(), steps);
+
+    for (size_t t = 0; t < steps; t++) {
+        // convert quaternion to axis and angle in radians
+        const vec4& quat = scratch.rotations[t];
+        double len = sqrt(quat[0] * quat[0] + quat[1] * quat[1] + quat[2] * quat[2]);
+        double angle = 2.0f * atan2(len, quat[3]);
+        vec3 axis;
+        if (len > 0)
+            axis = vec3(quat[0], quat[1], quat[2]) / len;
+        else
+            axis = vec3(1,0,0);
+
+        // rotation velocity
+        vec3 w = axis * angle / 1.0f;
+        vec3 v = positions[t + 1] - positions[t];
+
+        angular_velocities[t] = w;
+        velocities[t] = v;
+
+        // normal: crossproduct of orientated main axis and velocity
+        main_axis_normals[t] = normalize(cross(v, scratch.oriented_axes[t]));
+    }
+
+    // there is no next time step for the last sample
+    angular_velocities[steps] = vec3(NAN, NAN, NAN);
+    velocities[steps] = vec3(NAN, NAN, NAN);
+    main_axis_normals[steps] = vec3(NAN, NAN, NAN);
+}
+
+derived_attributes data::get_derived_attributes(size_t p)
+{
+    derived_attribute_cache& cache = dynamics.derived;
+    size_t c = p / derived_attribute_cache::chunk_size;
+
+    size_t number_chunks = (dynamics.trajs.size() + derived_attribute_cache::chunk_size - 1) / derived_attribute_cache::chunk_size;
+    if (cache.chunks.size() != number_chunks)
+        reset_derived_attributes();
+
+    derived_chunk& chunk = cache.chunks[c];
+    chunk.last_use = ++cache.clock;
+
+    if (chunk.offsets.empty()) {
+        cache.misses++;
+
+        size_t first = c * derived_attribute_cache::chunk_size;
+        size_t last = std::min(first + derived_attribute_cache::chunk_size, dynamics.trajs.size());
+
+        // samples of the trajectories of the chunk are stored one after another
+        size_t number_samples = 0;
+        chunk.offsets.resize(last - first);
+        for (size_t q = first; q < last; q++) {
+            chunk.offsets[q - first] = number_samples;
+            number_samples += dynamics.trajs[q].length;
+        }
+        chunk.velocities.resize(number_samples);
+        chunk.angular_velocities.resize(number_samples);
+        chunk.main_axis_normals.resize(number_samples);
+
+        // blocks of trajectories are handled by different threads each with its own buffers
+        size_t nr_blocks = (last - first + derived_block_size - 1) / derived_block_size;
+        parallel_for(0, nr_blocks, num_threads, [&](size_t block) {
+            derived_scratch scratch;
+            size_t block_begin = first + block * derived_block_size;
+            size_t block_end = std::min(block_begin + derived_block_size, last);
+
+            for (size_t q = block_begin; q < block_end; q++) {
+                size_t offset = chunk.offsets[q - first];
+                compute_derived_attributes(dynamics, axes, q, &chunk.velocities[offset], &chunk.angular_velocities[offset],
+                                           &chunk.main_axis_normals[offset], scratch);
+            }
+        });
+
+        cache.size += chunk_bytes(chunk);
+        evict_derived_chunks(c);
+    } else {
+        cache.hits++;
+    }
+
+    size_t offset = chunk.offsets[p - c * derived_attribute_cache::chunk_size];
+    derived_attributes attributes;
+    attributes.velocities = &chunk.velocities[offset];
+    attributes.angular_velocities = &chunk.angular_velocities[offset];
+    attributes.main_axis_normals = &chunk.main_axis_normals[offset];
+    return attributes;
+}
+
+void data::gather_main_axis_normals(std::vector<vec3>& normals)
+{
+    // samples that belong to no trajectory are never displayed
+    normals.assign(dynamics.positions.size(), vec3(NAN, NAN, NAN));
+
+    size_t nr_blocks = (dynamics.trajs.size() + derived_block_size - 1) / derived_block_size;
+    parallel_for(0, nr_blocks, num_threads, [&](size_t block) {
+        derived_scratch scratch;
+        std::vector<vec3> velocities;
+        std::vector<vec3> angular_velocities;
+        size_t block_end = std::min((block + 1) * derived_block_size, dynamics.trajs.size());
+
+        for (size_t p = block * derived_block_size; p < block_end; p++) {
+            velocities.resize(dynamics.trajs[p].length);
+            angular_velocities.resize(dynamics.trajs[p].length);
+            compute_derived_attributes(dynamics, axes, p, velocities.data(), angular_velocities.data(),
+                                       &normals[dynamics.trajs[p].offset], scratch);
+        }
+    });
+}
+
+void data::set_derived_cache_budget(size_t bytes)
+{
+    dynamics.derived.budget = bytes;
+    evict_derived_chunks(std::numeric_limits<size_t>::max());
+}
+
+void data::evict_derived_chunks(size_t keep_chunk)
+{
+    derived_attribute_cache& cache = dynamics.derived;
+
+    while (cache.size > cache.budget) {
+        // find least recently used chunk
+        size_t lru = std::numeric_limits<size_t>::max();
+        for (size_t c = 0; c < cache.chunks.size(); c++) {
+            if (c == keep_chunk || cache.chunks[c].offsets.empty())
+                continue;
+            if (lru == std::numeric_limits<size_t>::max() || cache.chunks[c].last_use < cache.chunks[lru].last_use)
+                lru = c;
+        }
+
+        // the requested chunk is kept even if it does not fit into the budget on its own
+        if (lru == std::numeric_limits<size_t>::max())
+            break;
+
+        cache.size -= chunk_bytes(cache.chunks[lru]);
+        cache.chunks[lru] = derived_chunk();
+        cache.evictions++;
+    }
+}
+
+void data::reset_derived_attributes()
+{
+    derived_attribute_cache& cache = dynamics.derived;
+    size_t number_chunks = (dynamics.trajs.size() + derived_attribute_cache::chunk_size - 1) / derived_attribute_cache::chunk_size;
+
+    cache.chunks.clear();
+    cache.chunks.resize(number_chunks);
+    cache.size = 0;
+}
+
+}
@@ -0,0 +1,166 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+
+#include <cgv/utils/file.h>
+
+#include "data_manifest.h"
+#include "data.h"
+#include "file_utils.h"
+#include "parallel.h"
+
+namespace ellipsoid_trajectory {
+
+static const char* manifest_name = "trajectory-vis.manifest";
+static const char* manifest_signature = "trajectory-vis manifest 1";
+
+/*
+    manifest layout (text, one file per line, tab separated):
+
+    trajectory-vis manifest 1
+    <file name>  <time>  <number of particles>  <size>  <modification time>
+    ...
+*/
+static bool read_manifest(const std::string& file_name, std::map<std::string, manifest_entry>& entries)
+{
+    std::ifstream file(file_name);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    if (!std::getline(file, line) || line != manifest_signature) {
+        std::cout << "  .. manifest has unknown format and will be recreated" << std::endl;
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        manifest_entry entry;
+        if (std::getline(stream, entry.file_name, '\t')
+                && stream >> entry.time >> entry.number_particles >> entry.size >> entry.modified) {
+            entries[entry.file_name] = entry;
+        }
+    }
+
+    return true;
+}
+
+static bool write_manifest(const std::string& file_name, const std::vector<manifest_entry>& entries)
+{
+    // write to temporary file first so that concurrent scans never see a partial manifest
+    std::string tmp_file_name = file_name + ".tmp";
+    std::ofstream file(tmp_file_name, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.precision(17);
+    file << manifest_signature << "\n";
+    for (size_t i = 0; i < entries.size(); i++) {
+        file << entries[i].file_name << '\t' << entries[i].time << '\t' << entries[i].number_particles
+             << '\t' << entries[i].size << '\t' << entries[i].modified << "\n";
+    }
+
+    file.close();
+    if (!file) {
+        std::remove(tmp_file_name.c_str());
+        return false;
+    }
+
+    std::remove(file_name.c_str());
+    if (std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) {
+        std::remove(tmp_file_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool scan_directory(const std::string& directory_name, std::vector<manifest_entry>& entries, unsigned int threads)
+{
+    entries.clear();
+
+    // 1. list all binary files in given folder
+    std::vector<std::string> names;
+    void* file_handle = cgv::utils::file::find_first(directory_name + "/*.bin");
+    while (file_handle != NULL) {
+        names.push_back(cgv::utils::file::find_name(file_handle));
+        file_handle = cgv::utils::file::find_next(file_handle);
+    }
+
+    if (names.empty())
+        return false;
+
+    // 2. header information of previous scan
+    std::string manifest_file_name = directory_name + "/" + manifest_name;
+    std::map<std::string, manifest_entry> known_entries;
+    read_manifest(manifest_file_name, known_entries);
+
+    // 3. only open new or changed files, all others are taken from the manifest
+    // every file is handled independently which hides the latency of network file systems
+    entries.resize(names.size());
+    std::vector<char> valid(names.size(), 0);
+    std::vector<char> reused(names.size(), 0);
+
+    parallel_for(0, names.size(), threads, [&](size_t i) {
+        std::string file_name = directory_name + "/" + names[i];
+
+        file_info info;
+        if (!get_file_info(file_name, info))
+            return;
+
+        std::map<std::string, manifest_entry>::const_iterator known = known_entries.find(names[i]);
+        if (known != known_entries.end()
+                && known->second.size == info.size && known->second.modified == info.modified) {
+            entries[i] = known->second;
+            valid[i] = 1;
+            reused[i] = 1;
+            return;
+        }
+
+        size_t number_particles;
+        double time;
+        if (!read_f90_header(file_name, number_particles, time))
+            return;
+
+        entries[i].file_name = names[i];
+        entries[i].time = time;
+        entries[i].number_particles = number_particles;
+        entries[i].size = info.size;
+        entries[i].modified = info.modified;
+        valid[i] = 1;
+    });
+
+    // 4. remove files that are no valid time step files
+    size_t write_ptr = 0;
+    size_t nr_reused = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!valid[i]) {
+            std::cerr << "WARNING: skipped invalid file " << names[i] << std::endl;
+            continue;
+        }
+        nr_reused += reused[i];
+        entries[write_ptr++] = entries[i];
+    }
+    entries.resize(write_ptr);
+
+    // sort files based on time
+    std::sort(entries.begin(), entries.end(), [](const manifest_entry& a, const manifest_entry& b) {
+        return a.time < b.time || (a.time == b.time && a.file_name < b.file_name);
+    });
+
+    std::cout << "  .. read " << entries.size() - nr_reused << " file headers, "
+              << nr_reused << " taken from manifest" << std::endl;
+
+    // 5. update manifest if any file was added, changed or removed
+    if (nr_reused != entries.size() || known_entries.size() != entries.size()) {
+        if (!write_manifest(manifest_file_name, entries))
+            std::cerr << "WARNING: could not write manifest " << manifest_file_name << std::endl;
+    }
+
+    return !entries.empty();
+}
+
+}
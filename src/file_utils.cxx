@@ -0,0 +1,149 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "file_utils.h"
+
+namespace ellipsoid_trajectory {
+
+bool get_file_info(const std::string& file_name, file_info& info)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(file_name.c_str(), GetFileExInfoStandard, &attributes))
+        return false;
+
+    info.size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+    // 100 ns intervals since 1601
+    info.modified = (int64_t)(((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32)
+                              | attributes.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat file_stat;
+    if (stat(file_name.c_str(), &file_stat) != 0)
+        return false;
+
+    info.size = (uint64_t)file_stat.st_size;
+    // nanoseconds since epoch
+#ifdef __APPLE__
+    info.modified = (int64_t)file_stat.st_mtime * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+    info.modified = (int64_t)file_stat.st_mtime * 1000000000 + file_stat.st_mtim.tv_nsec;
+#endif
+#endif
+
+    return true;
+}
+
+mapped_file::mapped_file()
+{
+    ptr = nullptr;
+    length = 0;
+    is_mapped = false;
+
+#ifdef _WIN32
+    file_handle = INVALID_HANDLE_VALUE;
+    mapping_handle = nullptr;
+#else
+    file_descriptor = -1;
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+bool mapped_file::open(const std::string& file_name)
+{
+    close();
+
+#ifdef _WIN32
+    file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+        close();
+        return false;
+    }
+    length = (size_t)file_size.QuadPart;
+
+    // empty files can not be mapped but are valid nonetheless
+    if (length > 0) {
+        mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_handle == nullptr) {
+            close();
+            return false;
+        }
+
+        ptr = (const unsigned char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+        if (ptr == nullptr) {
+            close();
+            return false;
+        }
+    }
+#else
+    file_descriptor = ::open(file_name.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(file_descriptor, &file_stat) != 0) {
+        close();
+        return false;
+    }
+    length = (size_t)file_stat.st_size;
+
+    // empty files can not be mapped but are valid nonetheless
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            close();
+            return false;
+        }
+        ptr = (const unsigned char*)mapping;
+
+        // files are parsed front to back exactly once
+        madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+#endif
+
+    is_mapped = true;
+    return true;
+}
+
+void mapped_file::close()
+{
+#ifdef _WIN32
+    if (ptr != nullptr)
+        UnmapViewOfFile(ptr);
+    if (mapping_handle != nullptr)
+        CloseHandle(mapping_handle);
+    if (file_handle != INVALID_HANDLE_VALUE)
+        CloseHandle(file_handle);
+    mapping_handle = nullptr;
+    file_handle = INVALID_HANDLE_VALUE;
+#else
+    if (ptr != nullptr)
+        munmap((void*)ptr, length);
+    if (file_descriptor >= 0)
+        ::close(file_descriptor);
+    file_descriptor = -1;
+#endif
+
+    ptr = nullptr;
+    length = 0;
+    is_mapped = false;
+}
+
+}
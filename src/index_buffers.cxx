@@ -0,0 +1,146 @@
+#include "index_buffers.h"
+
+namespace ellipsoid_trajectory {
+
+// number of buffers of each axis id and of buffers independent of ids
+static const size_t buffers_per_id = 5;
+static const size_t fixed_buffers = 9;
+
+template<typename T>
+static size_t buffer_bytes(const std::vector<T>& buffer)
+{
+    return buffer.capacity() * sizeof(T);
+}
+
+template<typename T>
+static size_t buffers_bytes(const std::vector<std::vector<T>>& buffers)
+{
+    size_t bytes = 0;
+    for (size_t e = 0; e < buffers.size(); e++)
+        bytes += buffer_bytes(buffers[e]);
+    return bytes;
+}
+
+template<typename T>
+static void release_buffer(std::vector<T>& buffer)
+{
+    std::vector<T>().swap(buffer);
+}
+
+// compares capacity of buffer with the one stored in slot and stores the current one if requested
+template<typename T>
+static void compare_capacity(const std::vector<T>& buffer, size_t& slot, bool store, size_t& changed)
+{
+    if (buffer.capacity() != slot)
+        changed++;
+    if (store)
+        slot = buffer.capacity();
+}
+
+index_buffers::index_buffers()
+    : last_grown(0), total_grown(0), updates(0)
+{
+}
+
+void index_buffers::begin_update(size_t number_ids)
+{
+    // number of ids only changes with the data set
+    if (ellipsoid_positions.size() != number_ids) {
+        ellipsoid_positions.resize(number_ids);
+        ellipsoid_orientations.resize(number_ids);
+        tubes_positions.resize(number_ids);
+        tubes_orientations.resize(number_ids);
+        tubes_colors.resize(number_ids);
+    }
+    capacities.resize(fixed_buffers + buffers_per_id * number_ids);
+
+    clear();
+    compare_capacities(true);
+}
+
+void index_buffers::clear()
+{
+    indices.clear();
+    indices_strip.clear();
+    ribbon_indices.clear();
+    ribbon_3D_indices.clear();
+    commands.clear();
+
+    for (size_t e = 0; e < ellipsoid_positions.size(); e++) {
+        ellipsoid_positions[e].clear();
+        ellipsoid_orientations[e].clear();
+        tubes_positions[e].clear();
+        tubes_orientations[e].clear();
+        tubes_colors[e].clear();
+    }
+
+    glyph_positions.clear();
+    velocities.clear();
+    normals.clear();
+    angular_velocities.clear();
+}
+
+void index_buffers::end_update()
+{
+    last_grown = compare_capacities(false);
+    total_grown += last_grown;
+    updates++;
+}
+
+void index_buffers::release()
+{
+    release_buffer(indices);
+    release_buffer(indices_strip);
+    release_buffer(ribbon_indices);
+    release_buffer(ribbon_3D_indices);
+    release_buffer(commands);
+
+    release_buffer(ellipsoid_positions);
+    release_buffer(ellipsoid_orientations);
+    release_buffer(tubes_positions);
+    release_buffer(tubes_orientations);
+    release_buffer(tubes_colors);
+
+    release_buffer(glyph_positions);
+    release_buffer(velocities);
+    release_buffer(normals);
+    release_buffer(angular_velocities);
+
+    release_buffer(capacities);
+}
+
+size_t index_buffers::capacity_bytes() const
+{
+    return buffer_bytes(indices) + buffer_bytes(indices_strip) + buffer_bytes(ribbon_indices) + buffer_bytes(ribbon_3D_indices) + buffer_bytes(commands)
+         + buffers_bytes(ellipsoid_positions) + buffers_bytes(ellipsoid_orientations)
+         + buffers_bytes(tubes_positions) + buffers_bytes(tubes_orientations) + buffers_bytes(tubes_colors)
+         + buffer_bytes(glyph_positions) + buffer_bytes(velocities) + buffer_bytes(normals) + buffer_bytes(angular_velocities);
+}
+
+size_t index_buffers::compare_capacities(bool store)
+{
+    size_t changed = 0;
+    size_t slot = 0;
+
+    compare_capacity(indices, capacities[slot++], store, changed);
+    compare_capacity(indices_strip, capacities[slot++], store, changed);
+    compare_capacity(ribbon_indices, capacities[slot++], store, changed);
+    compare_capacity(ribbon_3D_indices, capacities[slot++], store, changed);
+    compare_capacity(commands, capacities[slot++], store, changed);
+    compare_capacity(glyph_positions, capacities[slot++], store, changed);
+    compare_capacity(velocities, capacities[slot++], store, changed);
+    compare_capacity(normals, capacities[slot++], store, changed);
+    compare_capacity(angular_velocities, capacities[slot++], store, changed);
+
+    for (size_t e = 0; e < ellipsoid_positions.size(); e++) {
+        compare_capacity(ellipsoid_positions[e], capacities[slot++], store, changed);
+        compare_capacity(ellipsoid_orientations[e], capacities[slot++], store, changed);
+        compare_capacity(tubes_positions[e], capacities[slot++], store, changed);
+        compare_capacity(tubes_orientations[e], capacities[slot++], store, changed);
+        compare_capacity(tubes_colors[e], capacities[slot++], store, changed);
+    }
+
+    return changed;
+}
+
+}
@@ -0,0 +1,703 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ETV_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#include "math_utils.h"
+
+// functions using AVX2 instructions have to be marked for gcc and clang to compile them without
+// enabling AVX2 for the whole library, msvc always allows intrinsics of all instruction sets
+#if defined(ETV_SIMD_X86) && !defined(_MSC_VER)
+#define ETV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ETV_TARGET_AVX2
+#endif
+
+namespace ellipsoid_trajectory {
+
+// the kernels load and store vectors directly from the arrays
+static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 has to be tightly packed");
+static_assert(sizeof(vec4) == 4 * sizeof(float), "vec4 has to be tightly packed");
+
+// polynomial approximations used by the batched slerp, all are evaluated in float
+//   acos: Abramowitz and Stegun 4.4.46 for x in [0, 1], absolute error below 2e-8
+//   sin: Taylor series up to x^11 for x in [0, pi/2], absolute error below 6e-8
+static const float acos_coeffs[8] = {
+    1.5707963050f, -0.2145988016f, 0.0889789874f, -0.0501743046f,
+    0.0308918810f, -0.0170881256f, 0.0066700901f, -0.0012624911f
+};
+static const float sin_coeffs[5] = {
+    -1.0f / 6.0f, 1.0f / 120.0f, -1.0f / 5040.0f, 1.0f / 362880.0f, -1.0f / 39916800.0f
+};
+static const float pi_f = 3.14159265358979f;
+
+// bounds checked by benchmark_quat_batch, given as absolute error per component of unit quaternions,
+// the error of slerp is multiplied by sin(half_theta) first: close to 180 degrees the result is the
+// difference of two large terms and even a rounding error of the input is amplified by 1 / sin(half_theta)
+static const float max_error_exact = 1e-5f;
+static const float max_error_slerp = 1e-6f;
+
+// ----------------------------- scalar kernels -------------------------------------
+
+static float acos_approx(float x)
+{
+    float a = std::fabs(x);
+    float p = acos_coeffs[7];
+    for (int i = 6; i >= 0; i--)
+        p = p * a + acos_coeffs[i];
+    float r = std::sqrt(1.0f - a) * p;
+    return x < 0.0f ? pi_f - r : r;
+}
+
+// valid for x in [0, pi]
+static float sin_approx(float x)
+{
+    if (x > 0.5f * pi_f)
+        x = pi_f - x;
+    float x2 = x * x;
+    float p = sin_coeffs[4];
+    for (int i = 3; i >= 0; i--)
+        p = p * x2 + sin_coeffs[i];
+    return x + x * x2 * p;
+}
+
+static void quat_rotate_scalar(vec3 position, const vec4* quats, vec3* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = quat_rotate(position, quats[i]);
+}
+
+static void quat_mul_scalar(const vec4* q0, const vec4* q1, vec4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = quat_mul(q0[i], q1[i]);
+}
+
+static void quat_normed_scalar(const vec4* q, vec4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = quat_normed(q[i]);
+}
+
+// same cases as slerp but in float and with the approximations above
+static void slerp_scalar(const vec4* qa, const vec4* qb, const float* t, vec4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        vec4 a = qa[i];
+        vec4 b = qb[i];
+        float cos_half_theta = a[3] * b[3] + a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+
+        if (std::fabs(cos_half_theta) >= 1.0f) {
+            out[i] = a;
+            continue;
+        }
+
+        // factorized to stay accurate if cos_half_theta is close to 1 or -1
+        float sin_half_theta = std::sqrt((1.0f - cos_half_theta) * (1.0f + cos_half_theta));
+        if (sin_half_theta < 0.001f) {
+            out[i] = a * 0.5f + b * 0.5f;
+            continue;
+        }
+
+        float half_theta = acos_approx(cos_half_theta);
+        float inv_sin = 1.0f / sin_half_theta;
+        float ratio_a = sin_approx((1.0f - t[i]) * half_theta) * inv_sin;
+        float ratio_b = sin_approx(t[i] * half_theta) * inv_sin;
+        out[i] = a * ratio_a + b * ratio_b;
+    }
+}
+
+#ifdef ETV_SIMD_X86
+
+// ------------------------------- SSE kernels --------------------------------------
+// four quaternions are transposed into one register per component, so every operation
+// works on four quaternions at once exactly like the scalar code on one
+
+static void quat_rotate_sse(vec3 position, const vec4* quats, vec3* out, size_t count)
+{
+    const __m128 px = _mm_set1_ps(position[0]);
+    const __m128 py = _mm_set1_ps(position[1]);
+    const __m128 pz = _mm_set1_ps(position[2]);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(&quats[i][0]);
+        __m128 y = _mm_loadu_ps(&quats[i + 1][0]);
+        __m128 z = _mm_loadu_ps(&quats[i + 2][0]);
+        __m128 w = _mm_loadu_ps(&quats[i + 3][0]);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        // a = cross(quat.xyz, position) + quat.w * position
+        __m128 ax = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(y, pz), _mm_mul_ps(z, py)), _mm_mul_ps(px, w));
+        __m128 ay = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(z, px), _mm_mul_ps(x, pz)), _mm_mul_ps(py, w));
+        __m128 az = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(x, py), _mm_mul_ps(y, px)), _mm_mul_ps(pz, w));
+        // b = cross(quat.xyz, a)
+        __m128 bx = _mm_sub_ps(_mm_mul_ps(y, az), _mm_mul_ps(z, ay));
+        __m128 by = _mm_sub_ps(_mm_mul_ps(z, ax), _mm_mul_ps(x, az));
+        __m128 bz = _mm_sub_ps(_mm_mul_ps(x, ay), _mm_mul_ps(y, ax));
+
+        __m128 rx = _mm_add_ps(px, _mm_mul_ps(bx, two));
+        __m128 ry = _mm_add_ps(py, _mm_mul_ps(by, two));
+        __m128 rz = _mm_add_ps(pz, _mm_mul_ps(bz, two));
+        __m128 rw = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+
+        // a full store would write past the end of the last vec3
+        float result[16];
+        _mm_storeu_ps(result, rx);
+        _mm_storeu_ps(result + 4, ry);
+        _mm_storeu_ps(result + 8, rz);
+        _mm_storeu_ps(result + 12, rw);
+        for (int k = 0; k < 4; k++)
+            out[i + k] = vec3(result[4 * k], result[4 * k + 1], result[4 * k + 2]);
+    }
+
+    quat_rotate_scalar(position, quats + i, out + i, count - i);
+}
+
+static void quat_mul_sse(const vec4* q0, const vec4* q1, vec4* out, size_t count)
+{
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ax = _mm_loadu_ps(&q0[i][0]);
+        __m128 ay = _mm_loadu_ps(&q0[i + 1][0]);
+        __m128 az = _mm_loadu_ps(&q0[i + 2][0]);
+        __m128 aw = _mm_loadu_ps(&q0[i + 3][0]);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        __m128 bx = _mm_loadu_ps(&q1[i][0]);
+        __m128 by = _mm_loadu_ps(&q1[i + 1][0]);
+        __m128 bz = _mm_loadu_ps(&q1[i + 2][0]);
+        __m128 bw = _mm_loadu_ps(&q1[i + 3][0]);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        __m128 rx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)), _mm_mul_ps(ay, bz)), _mm_mul_ps(az, by));
+        __m128 ry = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ay, bw)), _mm_mul_ps(az, bx)), _mm_mul_ps(ax, bz));
+        __m128 rz = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(az, bw)), _mm_mul_ps(ax, by)), _mm_mul_ps(ay, bx));
+        __m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+
+        _mm_storeu_ps(&out[i][0], rx);
+        _mm_storeu_ps(&out[i + 1][0], ry);
+        _mm_storeu_ps(&out[i + 2][0], rz);
+        _mm_storeu_ps(&out[i + 3][0], rw);
+    }
+
+    quat_mul_scalar(q0 + i, q1 + i, out + i, count - i);
+}
+
+static void quat_normed_sse(const vec4* q, vec4* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        // one quaternion fills a whole register, no transpose needed
+        __m128 v = _mm_loadu_ps(&q[i][0]);
+        __m128 sq = _mm_mul_ps(v, v);
+        sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+        sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_ps(&out[i][0], _mm_div_ps(v, _mm_sqrt_ps(sq)));
+    }
+}
+
+static __m128 acos_sse(__m128 x)
+{
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 a = _mm_andnot_ps(sign_mask, x);
+    __m128 p = _mm_set1_ps(acos_coeffs[7]);
+    for (int i = 6; i >= 0; i--)
+        p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(acos_coeffs[i]));
+    __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)), p);
+    __m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+    __m128 reflected = _mm_sub_ps(_mm_set1_ps(pi_f), r);
+    return _mm_or_ps(_mm_and_ps(negative, reflected), _mm_andnot_ps(negative, r));
+}
+
+static __m128 sin_sse(__m128 x)
+{
+    __m128 upper = _mm_cmpgt_ps(x, _mm_set1_ps(0.5f * pi_f));
+    __m128 reflected = _mm_sub_ps(_mm_set1_ps(pi_f), x);
+    x = _mm_or_ps(_mm_and_ps(upper, reflected), _mm_andnot_ps(upper, x));
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(sin_coeffs[4]);
+    for (int i = 3; i >= 0; i--)
+        p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(sin_coeffs[i]));
+    return _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, x2), p));
+}
+
+static void slerp_sse(const vec4* qa, const vec4* qb, const float* t, vec4* out, size_t count)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ax = _mm_loadu_ps(&qa[i][0]);
+        __m128 ay = _mm_loadu_ps(&qa[i + 1][0]);
+        __m128 az = _mm_loadu_ps(&qa[i + 2][0]);
+        __m128 aw = _mm_loadu_ps(&qa[i + 3][0]);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        __m128 bx = _mm_loadu_ps(&qb[i][0]);
+        __m128 by = _mm_loadu_ps(&qb[i + 1][0]);
+        __m128 bz = _mm_loadu_ps(&qb[i + 2][0]);
+        __m128 bw = _mm_loadu_ps(&qb[i + 3][0]);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+        __m128 tt = _mm_loadu_ps(t + i);
+
+        // summed up in the same order as the scalar version to select the same cases
+        __m128 cos_half_theta = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)),
+                                                      _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        __m128 sin_half_theta = _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(one, cos_half_theta), _mm_add_ps(one, cos_half_theta)), _mm_setzero_ps()));
+
+        // the same three cases as the scalar version, selected per lane
+        __m128 same = _mm_cmpge_ps(_mm_andnot_ps(sign_mask, cos_half_theta), one);
+        __m128 degenerate = _mm_andnot_ps(same, _mm_cmplt_ps(sin_half_theta, _mm_set1_ps(0.001f)));
+
+        __m128 half_theta = acos_sse(_mm_min_ps(_mm_max_ps(cos_half_theta, _mm_set1_ps(-1.0f)), one));
+        __m128 inv_sin = _mm_div_ps(one, sin_half_theta);
+        __m128 ratio_a = _mm_mul_ps(sin_sse(_mm_mul_ps(_mm_sub_ps(one, tt), half_theta)), inv_sin);
+        __m128 ratio_b = _mm_mul_ps(sin_sse(_mm_mul_ps(tt, half_theta)), inv_sin);
+
+        // qa for equal quaternions, mean if theta is close to 0 or 180 degrees
+        ratio_a = _mm_or_ps(_mm_and_ps(degenerate, half), _mm_andnot_ps(degenerate, ratio_a));
+        ratio_b = _mm_or_ps(_mm_and_ps(degenerate, half), _mm_andnot_ps(degenerate, ratio_b));
+        ratio_a = _mm_or_ps(_mm_and_ps(same, one), _mm_andnot_ps(same, ratio_a));
+        ratio_b = _mm_andnot_ps(same, ratio_b);
+
+        __m128 rx = _mm_add_ps(_mm_mul_ps(ax, ratio_a), _mm_mul_ps(bx, ratio_b));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(ay, ratio_a), _mm_mul_ps(by, ratio_b));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(az, ratio_a), _mm_mul_ps(bz, ratio_b));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(aw, ratio_a), _mm_mul_ps(bw, ratio_b));
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+
+        _mm_storeu_ps(&out[i][0], rx);
+        _mm_storeu_ps(&out[i + 1][0], ry);
+        _mm_storeu_ps(&out[i + 2][0], rz);
+        _mm_storeu_ps(&out[i + 3][0], rw);
+    }
+
+    slerp_scalar(qa + i, qb + i, t + i, out + i, count - i);
+}
+
+// ------------------------------- AVX2 kernels -------------------------------------
+// eight quaternions per iteration, register k holds quaternion k in the lower and quaternion
+// k + 4 in the upper half, so transposing both halves gives components in original order
+
+#define ETV_LOAD8(ptr, x, y, z, w) \
+    x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&(ptr)[0][0])), _mm_loadu_ps(&(ptr)[4][0]), 1); \
+    y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&(ptr)[1][0])), _mm_loadu_ps(&(ptr)[5][0]), 1); \
+    z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&(ptr)[2][0])), _mm_loadu_ps(&(ptr)[6][0]), 1); \
+    w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&(ptr)[3][0])), _mm_loadu_ps(&(ptr)[7][0]), 1); \
+    transpose_avx(x, y, z, w)
+
+#define ETV_STORE8(ptr, x, y, z, w) \
+    transpose_avx(x, y, z, w); \
+    _mm_storeu_ps(&(ptr)[0][0], _mm256_castps256_ps128(x)); \
+    _mm_storeu_ps(&(ptr)[1][0], _mm256_castps256_ps128(y)); \
+    _mm_storeu_ps(&(ptr)[2][0], _mm256_castps256_ps128(z)); \
+    _mm_storeu_ps(&(ptr)[3][0], _mm256_castps256_ps128(w)); \
+    _mm_storeu_ps(&(ptr)[4][0], _mm256_extractf128_ps(x, 1)); \
+    _mm_storeu_ps(&(ptr)[5][0], _mm256_extractf128_ps(y, 1)); \
+    _mm_storeu_ps(&(ptr)[6][0], _mm256_extractf128_ps(z, 1)); \
+    _mm_storeu_ps(&(ptr)[7][0], _mm256_extractf128_ps(w, 1))
+
+// transposes the 4x4 matrices in both halves of the registers
+ETV_TARGET_AVX2 static inline void transpose_avx(__m256& r0, __m256& r1, __m256& r2, __m256& r3)
+{
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+    __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+    __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+    __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+    r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+ETV_TARGET_AVX2 static void quat_rotate_avx2(vec3 position, const vec4* quats, vec3* out, size_t count)
+{
+    const __m256 px = _mm256_set1_ps(position[0]);
+    const __m256 py = _mm256_set1_ps(position[1]);
+    const __m256 pz = _mm256_set1_ps(position[2]);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x, y, z, w;
+        ETV_LOAD8(quats + i, x, y, z, w);
+
+        // a = cross(quat.xyz, position) + quat.w * position
+        __m256 ax = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(y, pz), _mm256_mul_ps(z, py)), _mm256_mul_ps(px, w));
+        __m256 ay = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(z, px), _mm256_mul_ps(x, pz)), _mm256_mul_ps(py, w));
+        __m256 az = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(x, py), _mm256_mul_ps(y, px)), _mm256_mul_ps(pz, w));
+        // b = cross(quat.xyz, a)
+        __m256 bx = _mm256_sub_ps(_mm256_mul_ps(y, az), _mm256_mul_ps(z, ay));
+        __m256 by = _mm256_sub_ps(_mm256_mul_ps(z, ax), _mm256_mul_ps(x, az));
+        __m256 bz = _mm256_sub_ps(_mm256_mul_ps(x, ay), _mm256_mul_ps(y, ax));
+
+        __m256 rx = _mm256_add_ps(px, _mm256_mul_ps(bx, two));
+        __m256 ry = _mm256_add_ps(py, _mm256_mul_ps(by, two));
+        __m256 rz = _mm256_add_ps(pz, _mm256_mul_ps(bz, two));
+        __m256 rw = _mm256_setzero_ps();
+
+        // a full store would write past the end of the last vec3
+        vec4 result[8];
+        ETV_STORE8(result, rx, ry, rz, rw);
+        for (int k = 0; k < 8; k++)
+            out[i + k] = vec3(result[k][0], result[k][1], result[k][2]);
+    }
+
+    quat_rotate_scalar(position, quats + i, out + i, count - i);
+}
+
+ETV_TARGET_AVX2 static void quat_mul_avx2(const vec4* q0, const vec4* q1, vec4* out, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 ax, ay, az, aw, bx, by, bz, bw;
+        ETV_LOAD8(q0 + i, ax, ay, az, aw);
+        ETV_LOAD8(q1 + i, bx, by, bz, bw);
+
+        __m256 rx = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aw, bx), _mm256_mul_ps(ax, bw)), _mm256_mul_ps(ay, bz)), _mm256_mul_ps(az, by));
+        __m256 ry = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aw, by), _mm256_mul_ps(ay, bw)), _mm256_mul_ps(az, bx)), _mm256_mul_ps(ax, bz));
+        __m256 rz = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aw, bz), _mm256_mul_ps(az, bw)), _mm256_mul_ps(ax, by)), _mm256_mul_ps(ay, bx));
+        __m256 rw = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(aw, bw), _mm256_mul_ps(ax, bx)), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+
+        ETV_STORE8(out + i, rx, ry, rz, rw);
+    }
+
+    quat_mul_scalar(q0 + i, q1 + i, out + i, count - i);
+}
+
+ETV_TARGET_AVX2 static void quat_normed_avx2(const vec4* q, vec4* out, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x, y, z, w;
+        ETV_LOAD8(q + i, x, y, z, w);
+
+        __m256 norm = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+                                                   _mm256_add_ps(_mm256_mul_ps(z, z), _mm256_mul_ps(w, w))));
+        x = _mm256_div_ps(x, norm);
+        y = _mm256_div_ps(y, norm);
+        z = _mm256_div_ps(z, norm);
+        w = _mm256_div_ps(w, norm);
+
+        ETV_STORE8(out + i, x, y, z, w);
+    }
+
+    quat_normed_sse(q + i, out + i, count - i);
+}
+
+ETV_TARGET_AVX2 static inline __m256 acos_avx2(__m256 x)
+{
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 a = _mm256_andnot_ps(sign_mask, x);
+    __m256 p = _mm256_set1_ps(acos_coeffs[7]);
+    for (int i = 6; i >= 0; i--)
+        p = _mm256_add_ps(_mm256_mul_ps(p, a), _mm256_set1_ps(acos_coeffs[i]));
+    __m256 r = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), a)), p);
+    __m256 negative = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+    return _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(pi_f), r), negative);
+}
+
+ETV_TARGET_AVX2 static inline __m256 sin_avx2(__m256 x)
+{
+    __m256 upper = _mm256_cmp_ps(x, _mm256_set1_ps(0.5f * pi_f), _CMP_GT_OQ);
+    x = _mm256_blendv_ps(x, _mm256_sub_ps(_mm256_set1_ps(pi_f), x), upper);
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(sin_coeffs[4]);
+    for (int i = 3; i >= 0; i--)
+        p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(sin_coeffs[i]));
+    return _mm256_add_ps(x, _mm256_mul_ps(_mm256_mul_ps(x, x2), p));
+}
+
+ETV_TARGET_AVX2 static void slerp_avx2(const vec4* qa, const vec4* qb, const float* t, vec4* out, size_t count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 ax, ay, az, aw, bx, by, bz, bw;
+        ETV_LOAD8(qa + i, ax, ay, az, aw);
+        ETV_LOAD8(qb + i, bx, by, bz, bw);
+        __m256 tt = _mm256_loadu_ps(t + i);
+
+        // summed up in the same order as the scalar version to select the same cases
+        __m256 cos_half_theta = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aw, bw), _mm256_mul_ps(ax, bx)),
+                                                            _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+        __m256 sin_half_theta = _mm256_sqrt_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(one, cos_half_theta), _mm256_add_ps(one, cos_half_theta)), _mm256_setzero_ps()));
+
+        // the same three cases as the scalar version, selected per lane
+        __m256 same = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, cos_half_theta), one, _CMP_GE_OQ);
+        __m256 degenerate = _mm256_andnot_ps(same, _mm256_cmp_ps(sin_half_theta, _mm256_set1_ps(0.001f), _CMP_LT_OQ));
+
+        __m256 half_theta = acos_avx2(_mm256_min_ps(_mm256_max_ps(cos_half_theta, _mm256_set1_ps(-1.0f)), one));
+        __m256 inv_sin = _mm256_div_ps(one, sin_half_theta);
+        __m256 ratio_a = _mm256_mul_ps(sin_avx2(_mm256_mul_ps(_mm256_sub_ps(one, tt), half_theta)), inv_sin);
+        __m256 ratio_b = _mm256_mul_ps(sin_avx2(_mm256_mul_ps(tt, half_theta)), inv_sin);
+
+        // qa for equal quaternions, mean if theta is close to 0 or 180 degrees
+        ratio_a = _mm256_blendv_ps(ratio_a, half, degenerate);
+        ratio_b = _mm256_blendv_ps(ratio_b, half, degenerate);
+        ratio_a = _mm256_blendv_ps(ratio_a, one, same);
+        ratio_b = _mm256_andnot_ps(same, ratio_b);
+
+        __m256 rx = _mm256_add_ps(_mm256_mul_ps(ax, ratio_a), _mm256_mul_ps(bx, ratio_b));
+        __m256 ry = _mm256_add_ps(_mm256_mul_ps(ay, ratio_a), _mm256_mul_ps(by, ratio_b));
+        __m256 rz = _mm256_add_ps(_mm256_mul_ps(az, ratio_a), _mm256_mul_ps(bz, ratio_b));
+        __m256 rw = _mm256_add_ps(_mm256_mul_ps(aw, ratio_a), _mm256_mul_ps(bw, ratio_b));
+
+        ETV_STORE8(out + i, rx, ry, rz, rw);
+    }
+
+    slerp_sse(qa + i, qb + i, t + i, out + i, count - i);
+}
+
+#undef ETV_LOAD8
+#undef ETV_STORE8
+
+#endif
+
+// ------------------------------- dispatch -----------------------------------------
+
+struct quat_kernels
+{
+    void (*rotate)(vec3 position, const vec4* quats, vec3* out, size_t count);
+    void (*mul)(const vec4* q0, const vec4* q1, vec4* out, size_t count);
+    void (*normed)(const vec4* q, vec4* out, size_t count);
+    void (*slerp)(const vec4* qa, const vec4* qb, const float* t, vec4* out, size_t count);
+};
+
+static quat_kernels get_kernels(simd_level level)
+{
+    quat_kernels kernels = { quat_rotate_scalar, quat_mul_scalar, quat_normed_scalar, slerp_scalar };
+#ifdef ETV_SIMD_X86
+    if (level == SIMD_SSE) {
+        quat_kernels sse = { quat_rotate_sse, quat_mul_sse, quat_normed_sse, slerp_sse };
+        kernels = sse;
+    } else if (level == SIMD_AVX2) {
+        quat_kernels avx2 = { quat_rotate_avx2, quat_mul_avx2, quat_normed_avx2, slerp_avx2 };
+        kernels = avx2;
+    }
+#endif
+    return kernels;
+}
+
+simd_level detect_simd_level()
+{
+#if defined(ETV_SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    // AVX registers have to be enabled by the operating system as well
+    bool os_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+               && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (os_avx && max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    if (avx2)
+        return SIMD_AVX2;
+    if (sse2)
+        return SIMD_SSE;
+#elif defined(ETV_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE;
+#endif
+    return SIMD_SCALAR;
+}
+
+const char* simd_level_name(simd_level level)
+{
+    switch (level) {
+    case SIMD_AVX2:
+        return "AVX2";
+    case SIMD_SSE:
+        return "SSE";
+    default:
+        return "scalar";
+    }
+}
+
+// selected once on first use
+static const quat_kernels& active_kernels()
+{
+    static const quat_kernels kernels = get_kernels(detect_simd_level());
+    return kernels;
+}
+
+void quat_rotate_batch(vec3 position, const vec4* quats, vec3* out, size_t count)
+{
+    active_kernels().rotate(position, quats, out, count);
+}
+
+void quat_mul_batch(const vec4* q0, const vec4* q1, vec4* out, size_t count)
+{
+    active_kernels().mul(q0, q1, out, count);
+}
+
+void quat_normed_batch(const vec4* q, vec4* out, size_t count)
+{
+    active_kernels().normed(q, out, count);
+}
+
+void slerp_batch(const vec4* qa, const vec4* qb, const float* t, vec4* out, size_t count)
+{
+    active_kernels().slerp(qa, qb, t, out, count);
+}
+
+// ------------------------------- benchmark ----------------------------------------
+
+// sin(half_theta) of slerp in double
+static double sin_half_angle(vec4 qa, vec4 qb)
+{
+    double cos_half_theta = 0.0;
+    for (int k = 0; k < 4; k++)
+        cos_half_theta += (double)qa[k] * qb[k];
+    return sqrt(std::max(0.0, 1.0 - cos_half_theta * cos_half_theta));
+}
+
+template<typename T>
+static float difference(const T& a, const T& b)
+{
+    float diff = 0.0f;
+    for (unsigned k = 0; k < a.size(); k++)
+        diff = std::max(diff, std::fabs(a[k] - b[k]));
+    return diff;
+}
+
+template<typename T>
+static float max_difference(const std::vector<T>& a, const std::vector<T>& b)
+{
+    float max_diff = 0.0f;
+    for (size_t i = 0; i < a.size(); i++)
+        max_diff = std::max(max_diff, difference(a[i], b[i]));
+    return max_diff;
+}
+
+bool benchmark_quat_batch(size_t count)
+{
+    std::cout << "benchmark quaternion kernels ... " << std::endl;
+
+    // random unit quaternions, some pairs are equal, close or almost opposite to cover all cases
+    // of slerp, pairs right at the border between two cases are avoided since the results of the
+    // cases differ and float and double select different cases there
+    std::mt19937 rng(7);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    std::vector<vec4> qa(count), qb(count);
+    std::vector<float> t(count);
+    for (size_t i = 0; i < count; i++) {
+        qa[i] = quat_normed(vec4(normal(rng), normal(rng), normal(rng), normal(rng)));
+        qb[i] = quat_normed(vec4(normal(rng), normal(rng), normal(rng), normal(rng)));
+        if (i % 16 == 1)
+            qb[i] = qa[i];
+        if (i % 16 == 2)
+            qb[i] = quat_normed(qa[i] + vec4(normal(rng), normal(rng), normal(rng), normal(rng)) * 0.01f);
+        if (i % 16 == 3)
+            qb[i] = quat_normed(qa[i] + vec4(normal(rng), normal(rng), normal(rng), normal(rng)) * 0.05f) * -1.0f;
+        t[i] = uniform(rng);
+    }
+    vec3 axis(1.5f, 0.0f, 0.0f);
+
+    std::vector<vec4> scaled(count);
+    for (size_t i = 0; i < count; i++)
+        scaled[i] = qa[i] * 3.0f;
+
+    // existing scalar functions are the reference
+    std::vector<vec3> ref_rotate(count);
+    std::vector<vec4> ref_mul(count), ref_normed(count), ref_slerp(count);
+
+    auto ref_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+        ref_rotate[i] = quat_rotate(axis, qa[i]);
+    auto ref_rotate_end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+        ref_mul[i] = quat_mul(qa[i], qb[i]);
+    auto ref_mul_end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+        ref_normed[i] = quat_normed(scaled[i]);
+    auto ref_normed_end = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++)
+        ref_slerp[i] = slerp(qa[i], qb[i], t[i]);
+    auto ref_slerp_end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::ratio<1,1000>> ref_rotate_time = ref_rotate_end - ref_start;
+    std::chrono::duration<double, std::ratio<1,1000>> ref_mul_time = ref_mul_end - ref_rotate_end;
+    std::chrono::duration<double, std::ratio<1,1000>> ref_normed_time = ref_normed_end - ref_mul_end;
+    std::chrono::duration<double, std::ratio<1,1000>> ref_slerp_time = ref_slerp_end - ref_normed_end;
+
+    simd_level detected = detect_simd_level();
+    std::cout << "  quaternions: " << count << ", detected: " << simd_level_name(detected) << std::endl;
+    std::cout << "  reference:" << std::endl;
+    std::cout << "    rotate: " << ref_rotate_time.count() << " ms" << std::endl;
+    std::cout << "    mul:    " << ref_mul_time.count() << " ms" << std::endl;
+    std::cout << "    normed: " << ref_normed_time.count() << " ms" << std::endl;
+    std::cout << "    slerp:  " << ref_slerp_time.count() << " ms" << std::endl;
+
+    bool success = true;
+    for (int l = SIMD_SCALAR; l <= (int)detected; l++) {
+        simd_level level = (simd_level)l;
+        quat_kernels kernels = get_kernels(level);
+
+        std::vector<vec3> out_rotate(count);
+        std::vector<vec4> out_mul(count), out_normed(count), out_slerp(count);
+
+        auto start = std::chrono::steady_clock::now();
+        kernels.rotate(axis, qa.data(), out_rotate.data(), count);
+        auto rotate_end = std::chrono::steady_clock::now();
+        kernels.mul(qa.data(), qb.data(), out_mul.data(), count);
+        auto mul_end = std::chrono::steady_clock::now();
+        kernels.normed(scaled.data(), out_normed.data(), count);
+        auto normed_end = std::chrono::steady_clock::now();
+        kernels.slerp(qa.data(), qb.data(), t.data(), out_slerp.data(), count);
+        auto slerp_end = std::chrono::steady_clock::now();
+
+        // errors are relative to the length of the rotated axis
+        float error_rotate = max_difference(out_rotate, ref_rotate) / axis.length();
+        float error_mul = max_difference(out_mul, ref_mul);
+        float error_normed = max_difference(out_normed, ref_normed);
+        float error_slerp = 0.0f;
+        for (size_t i = 0; i < count; i++)
+            error_slerp = std::max(error_slerp, difference(out_slerp[i], ref_slerp[i]) * (float)sin_half_angle(qa[i], qb[i]));
+
+        bool accurate = error_rotate <= max_error_exact && error_mul <= max_error_exact
+                     && error_normed <= max_error_exact && error_slerp <= max_error_slerp;
+        success = success && accurate;
+
+        std::chrono::duration<double, std::ratio<1,1000>> rotate_time = rotate_end - start;
+        std::chrono::duration<double, std::ratio<1,1000>> mul_time = mul_end - rotate_end;
+        std::chrono::duration<double, std::ratio<1,1000>> normed_time = normed_end - mul_end;
+        std::chrono::duration<double, std::ratio<1,1000>> slerp_time = slerp_end - normed_end;
+
+        std::cout << "  " << simd_level_name(level) << ":" << std::endl;
+        std::cout << "    rotate: " << rotate_time.count() << " ms, max error " << error_rotate << std::endl;
+        std::cout << "    mul:    " << mul_time.count() << " ms, max error " << error_mul << std::endl;
+        std::cout << "    normed: " << normed_time.count() << " ms, max error " << error_normed << std::endl;
+        std::cout << "    slerp:  " << slerp_time.count() << " ms, max error " << error_slerp << std::endl;
+        std::cout << "    results " << (accurate ? "are within error bounds" : "EXCEED error bounds") << std::endl;
+    }
+
+    return success;
+}
+
+}
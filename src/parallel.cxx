@@ -0,0 +1,100 @@
+#include "parallel.h"
+
+namespace ellipsoid_trajectory {
+
+thread_pool::thread_pool(unsigned int threads)
+{
+    job_task = nullptr;
+    job_context = nullptr;
+    job_next = 0;
+    job_end = 0;
+    job_workers = 0;
+    busy_workers = 0;
+    generation = 0;
+    stop = false;
+
+    if (threads == 0)
+        threads = default_thread_count();
+    workers.reserve(threads - 1);
+    for (unsigned int w = 0; w + 1 < threads; w++)
+        workers.push_back(std::thread(&thread_pool::work, this, w));
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    start_condition.notify_all();
+
+    for (size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+}
+
+void thread_pool::execute(size_t begin, size_t end, unsigned int threads, void (*task)(void*, size_t), void* context)
+{
+    if (end <= begin)
+        return;
+
+    if (threads == 0 || threads > size())
+        threads = size();
+    if (threads > end - begin)
+        threads = (unsigned int)(end - begin);
+
+    if (threads <= 1) {
+        for (size_t i = begin; i < end; i++)
+            task(context, i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job_task = task;
+        job_context = context;
+        job_next = begin;
+        job_end = end;
+        job_workers = threads - 1;
+        busy_workers = threads - 1;
+        generation++;
+    }
+    start_condition.notify_all();
+
+    // calling thread works as well
+    for (size_t i = job_next++; i < end; i = job_next++)
+        task(context, i);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condition.wait(lock, [this]() { return busy_workers == 0; });
+}
+
+void thread_pool::work(unsigned int worker)
+{
+    size_t seen = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        start_condition.wait(lock, [&]() { return stop || generation != seen; });
+        if (stop)
+            return;
+
+        // a worker that does not take part in a job waits for the next one, workers taking part
+        // finish before the next job starts and therefore cannot miss one
+        seen = generation;
+        if (worker >= job_workers)
+            continue;
+
+        void (*task)(void*, size_t) = job_task;
+        void* context = job_context;
+        size_t end = job_end;
+        lock.unlock();
+
+        for (size_t i = job_next++; i < end; i = job_next++)
+            task(context, i);
+
+        lock.lock();
+        if (--busy_workers == 0)
+            done_condition.notify_one();
+    }
+}
+
+}
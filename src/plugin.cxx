@@ -1,6 +1,6 @@
-#include <queue>
 #include <fstream>
 #include <limits>
+#include <algorithm>
 
 #include <cgv/base/register.h>
 #include <cgv/utils/ostream_printf.h>
@@ -14,6 +14,9 @@
 #include "plugin.h"
 #include "math_utils.h"
 #include "metatube.h"
+#include "parallel.h"
+#include "data_manifest.h"
+#include "system_info.h"
 
 using namespace cgv::base;
 using namespace cgv::gui;
@@ -38,6 +41,45 @@ plugin::plugin(const char* name) : group(name)
     start_load_time_step = 1;
     end_load_time_step = 1;
     time_step_resolution = 1;
+    load_threads = default_thread_count();
+    use_cache = true;
+    derived_cache_size = 256;
+    index_threads = default_thread_count();
+    gpu_time_window = true;
+    full_time_indices = false;
+    multi_draw = true;
+    commands_computed = false;
+    gpu_culling = true;
+    frustum_culling = true;
+    culled_on_gpu = false;
+    culling_classes_valid = false;
+    verify_culling = false;
+    nr_drawn_chunks = 0;
+    nr_culled_chunks = 0;
+    lod_active = false;
+    lod_pixel_error = 1.0f;
+    lod_view_valid = false;
+    lod_perspective = true;
+    lod_eye = vec3(0.0f);
+    lod_focus_distance = 0.0f;
+    lod_pixel_size = 0.0f;
+    nr_lod_samples = 0;
+    nr_lod_drawn_samples = 0;
+    culling_settings.start_time = 0;
+    culling_settings.end_time = 0;
+    culling_settings.rejected_classes = 0;
+    culling_settings.roi_active = false;
+    culling_settings.roi.min = culling_settings.roi.max = vec3(0.0f);
+    culling_settings.single_traj = -1;
+    culling_settings.frustum_culling = false;
+    invalidate_filter_bits();
+    candidate_start_id = 0;
+    use_roi_candidates = false;
+    slotted_indices = false;
+    animation_step = false;
+    indices_patched = false;
+    slotted_start_time = 0;
+    slotted_mode = TRAJ_LINE;
     cut_trajs = true;
     split_tolerance = 0.9;
     create_equidistant = true;
@@ -172,6 +214,9 @@ plugin::plugin(const char* name) : group(name)
 
 plugin::~plugin()
 {
+    // search in the background reads the data
+    poi_finder.cancel();
+
     delete ellips_data;
     delete scene_light;
 
@@ -205,6 +250,23 @@ void plugin::create_gui()
             "min=1;max=20;tooltip='Only reads every ith file (time step). Wrong Trajectories can be caused by chossing a very low resolution since out of bound trajectories cannot be detected anymore.'")->value_change,
             rebind(this, &plugin::changed_setting)
         );
+        connect_copy(
+            add_control("Threads", load_threads, "value_slider", 
+            "min=1;max="+ std::to_string(4 * default_thread_count()) +";tooltip='Number of files that are read in parallel'")->value_change,
+            rebind(this, &plugin::changed_setting)
+        );
+        connect_copy(
+            add_control("use cache", use_cache, "check", 
+            "tooltip='Stores the preprocessed data set in the data directory and reuses it as long as neither files nor options change'")->value_change,
+            rebind(this, &plugin::changed_setting)
+        );
+        connect_copy(
+            add_control("derived cache (MB)", derived_cache_size, "value_slider", 
+            "min=16;max=4096;log=true;tooltip='Memory budget for velocities, angular velocities and normals which are computed on first use'")->value_change,
+            rebind(this, &plugin::changed_derived_cache_size)
+        );
+        connect_copy(add_button("Benchmark Readers", "tooltip='Reads the selected files with the stream based and the memory mapped reader and compares time and results (see console)'")->click,rebind(this, &plugin::benchmark_readers));
+        connect_copy(add_button("Benchmark Quaternions", "tooltip='Compares time and accuracy of the batched quaternion functions (scalar, SSE, AVX2) used in post processing (see console)'")->click,rebind(this, &plugin::benchmark_quaternions));
 
         align("\b");
         end_tree_node(load_options);
@@ -377,11 +439,16 @@ void plugin::create_gui()
         connect_copy(
             add_control("Start", start_time, "value_slider", 
             "step=1;min=1;max=" + std::to_string(time_steps) + ";ticks=true")->value_change,
-            rebind(this, &plugin::set_traj_indices_out_of_date)
+            rebind(this, &plugin::changed_time_window)
         );
         connect_copy(
             add_control("End", end_time, "value_slider", 
             "step=1;min=1;max=" + std::to_string(time_steps) + ";ticks=true")->value_change,
+            rebind(this, &plugin::changed_time_window)
+        );
+        connect_copy(
+            add_control("clip on GPU", gpu_time_window, "check",
+            "tooltip='Keeps the indices of the whole time range on the GPU and discards samples outside of the time window in the shaders. Not used while glyphs, ellipsoids, the length filter or a roi with time interval depend on the window.'")->value_change,
             rebind(this, &plugin::set_traj_indices_out_of_date)
         );
 
@@ -644,7 +711,7 @@ void plugin::create_gui()
     );
     if (poi_node) {
         align("\a");
-        connect_copy(add_button("Search", "tooltip='Searches for regions with most trajectories with current specified filter active (including ROI size, length filter and time selection)'")->click,rebind(this, &plugin::search_points_of_interest));
+        connect_copy(add_button("Search", "tooltip='Searches in the background for regions with most trajectories with current specified filter active (including ROI size, length filter and time selection)'")->click,rebind(this, &plugin::search_points_of_interest));
 
         connect_copy(add_control("Results", poi_id, "value_slider", 
                     "min=0;max=" + std::to_string(max_pois - 1) + ";ticks=true")->value_change,
@@ -659,6 +726,38 @@ void plugin::create_gui()
     add_decorator("Additional Functionality","heading");
 
     connect_copy(add_button("Performance Statistics", "tooltip='Enables or resets performance statistics'")->click,rebind(this, &plugin::reset_perf_stats));
+    connect_copy(
+        add_control("index threads", index_threads, "value_slider", 
+        "min=1;max="+ std::to_string(default_thread_count()) +";tooltip='Number of threads that filter trajectories and compute indices'")->value_change,
+        rebind(this, &plugin::set_traj_indices_out_of_date)
+    );
+    connect_copy(
+        add_control("multi draw", multi_draw, "check",
+        "tooltip='Draws lines and 3D ribbons (GPU) with one indirect draw command per visible trajectory instead of indices (OpenGL 4.3).'")->value_change,
+        rebind(this, &plugin::set_traj_indices_out_of_date)
+    );
+    connect_copy(
+        add_control("cull on GPU", gpu_culling, "check",
+        "tooltip='Evaluates the length filter, the roi bounding box and the time window in a compute shader that writes the draw commands (requires multi draw, not used for exact roi, glyphs and ellipsoids).'")->value_change,
+        rebind(this, &plugin::set_traj_indices_out_of_date)
+    );
+    connect_copy(
+        add_control("frustum culling", frustum_culling, "check",
+        "tooltip='Chunks of trajectories whose bounding box lies outside of the view are not drawn when culling on GPU.'")->value_change,
+        rebind(this, &plugin::changed_setting)
+    );
+    connect_copy(
+        add_control("level of detail", lod_active, "check",
+        "tooltip='Lines and ribbons skip samples whose Douglas-Peucker error is smaller than the pixel error at the distance of their trajectory (disables multi draw).'")->value_change,
+        rebind(this, &plugin::set_traj_indices_out_of_date)
+    );
+    connect_copy(
+        add_control("pixel error", lod_pixel_error, "value_slider",
+        "min=0.25;max=8;ticks=true;tooltip='Largest distance of a skipped sample to the drawn line in pixels'")->value_change,
+        rebind(this, &plugin::set_traj_indices_out_of_date)
+    );
+    connect_copy(add_button("Verify GPU Culling", "tooltip='Compares the draw commands of the compute shader with the cpu reference (see console)'")->click,rebind(this, &plugin::verify_gpu_culling));
+    connect_copy(add_button("Benchmark Indices", "tooltip='Computes indices of current selection with 1 to N threads and compares time and results (see console)'")->click,rebind(this, &plugin::benchmark_indices));
 
     connect_copy(
         add_control("set light source on camera", set_light_to_eye_pos, "check", 
@@ -816,6 +915,9 @@ bool plugin::handle(cgv::gui::event& e)
 
 void plugin::timer_event(double, double dt)
 {
+    // search for points of interest runs in the background
+    finish_points_of_interest();
+
     if (animate && !paused) {
         auto time = std::chrono::steady_clock::now();
 
@@ -837,7 +939,14 @@ void plugin::timer_event(double, double dt)
             }
 
             update_member(&end_time);
-            set_traj_indices_out_of_date();
+            // indices of the whole time range are clipped by the shaders, otherwise
+            // indices stored in slots only have to be updated for the new end time
+            if (!full_time_indices || !time_window_on_gpu()) {
+                animation_step = true;
+                out_of_date = true;
+            } else if (!culled_on_gpu) {
+                count_window_trajs();
+            }
             post_redraw();
 
             current_time += animation_speed;
@@ -870,6 +979,12 @@ bool plugin::init(cgv::render::context& ctx)
     traj_renderer_ribbon.init(ctx, scene_light, tick_marks_sample);
     traj_renderer_3D_ribbon.init(ctx, scene_light, ribbon_material, tick_marks_sample);
     traj_renderer_3D_ribbon_gpu.init(ctx, scene_light, ribbon_material, tick_marks_sample);
+    culling.init(ctx);
+    time_colormap.init(ctx);
+    traj_renderer_line.use_colormap(time_colormap.texture());
+    traj_renderer_ribbon.use_colormap(time_colormap.texture());
+    traj_renderer_3D_ribbon.use_colormap(time_colormap.texture());
+    traj_renderer_3D_ribbon_gpu.use_colormap(time_colormap.texture());
     sphere_renderer.init(ctx, scene_light, stationary_material, false);
     normal_renderer_line.init(ctx);
     velocity_renderer_line.init(ctx);
@@ -925,40 +1040,20 @@ void plugin::scan_data()
         return;
 
     // filename pattern: ell_trn_<####>.bin
-    std::string filter = directory_name + "/*.bin";
     std::string prefix = "ell_trn_";
     std::cout << "  .. expected file name: " << prefix << "<timestep>.bin" << std::endl;
 
-    // search for all binary files in given folder
-    void* file_handle = cgv::utils::file::find_first(filter);
-
-    if (!file_handle)
+    // get physical time of all binary files in given folder (already sorted by time)
+    std::vector<manifest_entry> entries;
+    if (!scan_directory(directory_name, entries, load_threads))
         return;
 
     // store all filenames
-    while (file_handle != NULL) {
-        std::string file_name = cgv::utils::file::find_name(file_handle);
-        file_handle = cgv::utils::file::find_next(file_handle);
-
-        // open file and get physical time for sorting files afterwards
-        uint32_t record_length;
-        uint32_t s_number_particles;
-        double time;
-        std::ifstream file(file_name, std::ios::in | std::ios::binary);
-        file.seekg(0, std::ios::beg);
-        binary_read(file, record_length);
-        binary_read(file, s_number_particles);
-        binary_read(file, record_length);
-        binary_read(file, record_length);
-        binary_read(file, time);
-        file.close();
-
-        files.push_back(std::make_pair(time, directory_name + "/" + file_name));
+    files.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        files.push_back(std::make_pair(entries[i].time, directory_name + "/" + entries[i].file_name));
     }
 
-    // sort files based on time
-    sort(files.begin(), files.end());
-
     std::cout << "  .. found " << files.size() << " files" << std::endl;
 
     start_load_time_step = 1;
@@ -970,6 +1065,85 @@ void plugin::scan_data()
     create_gui();
 }
 
+void plugin::benchmark_readers()
+{
+    if (start_load_time_step < end_load_time_step) {
+        // use separate data storage to keep the currently displayed data set
+        data benchmark_data;
+        benchmark_data.benchmark_readers(files, start_load_time_step - 1, end_load_time_step - 1, time_step_resolution);
+    } else {
+        std::cerr << "Benchmark failed: start time < end time expected" << std::endl;
+    }
+}
+
+void plugin::benchmark_quaternions()
+{
+    if (!benchmark_quat_batch())
+        std::cerr << "Benchmark failed: batched quaternion functions exceed their error bounds" << std::endl;
+}
+
+void plugin::benchmark_indices()
+{
+    std::cout << "benchmark index computation of current selection ... " << std::endl;
+
+    int saved_threads = index_threads;
+    int max_threads = (int)default_thread_count();
+    double single_thread_time = 0.0;
+    std::vector<unsigned int> reference;
+
+    // the parallel path is measured for the current time window, neither the slots of the
+    // animation nor the whole time range of the time window on GPU are used
+    bool saved_animate = animate;
+    animate = false;
+    animation_step = false;
+    full_time_indices = false;
+
+    for (int threads = 1; ; threads = std::min(2 * threads, max_threads)) {
+        index_threads = threads;
+
+        // best of some runs to reduce influence of other processes
+        double best_time = std::numeric_limits<double>::max();
+        bool identical = true;
+        for (int run = 0; run < 10; run++) {
+            auto time_measure_start = std::chrono::steady_clock::now();
+            compute_window_traj_indices();
+            auto time_measure_end = std::chrono::steady_clock::now();
+            best_time = std::min(best_time, std::chrono::duration<double, std::milli>(time_measure_end - time_measure_start).count());
+
+            // indices of current render mode have to be independent of the number of threads
+            std::vector<unsigned int>* indices = mode_indices();
+            if (indices) {
+                if (threads == 1 && run == 0)
+                    reference = *indices;
+                else if (*indices != reference)
+                    identical = false;
+            }
+
+            clear_traj_indices();
+        }
+
+        if (threads == 1)
+            single_thread_time = best_time;
+        std::cout << "  " << threads << " threads: " << best_time << " ms (speedup " << single_thread_time / best_time << ")"
+                  << (identical ? "" : " - results differ") << std::endl;
+
+        if (threads == max_threads)
+            break;
+    }
+
+    index_threads = saved_threads;
+    animate = saved_animate;
+    std::cout << "  " << nr_visible_traj << " visible trajectories" << std::endl;
+
+    // buffers were cleared, the next frame computes them for the current settings again
+    set_traj_indices_out_of_date();
+}
+
+void plugin::changed_derived_cache_size()
+{
+    ellips_data->set_derived_cache_budget((size_t)derived_cache_size * 1024 * 1024);
+}
+
 void plugin::set_up_data()
 {
     // not every data set contains stationary variables (like the random generated data)
@@ -1017,6 +1191,16 @@ void plugin::set_up_data()
         time_colors.push_back(color);
     }
 
+    // samples store their time index if it fits into 16 bits, otherwise their color
+    time_indices.clear();
+    if (time_indices_supported()) {
+        time_indices.resize(time_steps + 1);
+        for (size_t t = 0; t <= time_steps; t++)
+            time_indices[t] = (unsigned short)t;
+    } else {
+        std::cout << "More than " << std::numeric_limits<unsigned short>::max() << " time steps, trajectories store a color per vertex" << std::endl;
+    }
+
     // ellipsoids and tubes needs to set up in the next draw call
     setup_ellipsoids = true;
 
@@ -1036,6 +1220,9 @@ void plugin::load_data(bool generated)
 {
     bool success = false;
 
+    // search in the background reads the data that is replaced now
+    poi_finder.cancel();
+
     if (generated) {
         std::cout << "generate data" << std::endl;
         data_name = "generated data";
@@ -1054,7 +1241,7 @@ void plugin::load_data(bool generated)
             ellips_data = new data();
     
             // load data for visualization
-            success = ellips_data->load(files, start_load_time_step - 1, end_load_time_step - 1, time_step_resolution, cut_trajs, same_start, create_equidistant, split_tolerance);
+            success = ellips_data->load(files, start_load_time_step - 1, end_load_time_step - 1, time_step_resolution, cut_trajs, same_start, create_equidistant, split_tolerance, load_threads, use_cache);
         } else {
             std::cerr << "Data loading failed: start time < end time expected" << std::endl;
         }
@@ -1068,15 +1255,22 @@ void plugin::load_data(bool generated)
         traj_renderer_line.reset();
         traj_renderer_ribbon.reset();
         traj_renderer_3D_ribbon.reset();
-        traj_renderer_3D_ribbon.reserve_memory(ellips_data->dynamics.axis_ids.size(),
-                                               ellips_data->max_time_steps);
+        traj_renderer_3D_ribbon.reserve_memory(ellips_data->dynamics.trajs.size());
         traj_renderer_3D_ribbon_gpu.reset();
+        culling.reset();
+        time_colormap.reset();
         b_box_renderer.reset();
         roi_box_renderer.reset();
         normal_renderer_line.reset();
         velocity_renderer_line.reset();
         angular_velocity_renderer_line.reset();
 
+        // buffers of previous data set may be much larger than needed
+        buffers.release();
+        slotted_indices = false;
+        invalidate_filter_bits();
+        changed_derived_cache_size();
+
         // sets light, view point and time encoding as color
         set_up_data();
 
@@ -1145,12 +1339,24 @@ void plugin::draw(context& ctx) {
         setup_ellipsoids = false;
     }
    
+    // levels of detail depend on the view, indices are only updated if it changed noticeably
+    if (lod_supported() && update_lod_view(ctx))
+        out_of_date = true;
+
     // update index vectors if necessary (if filter are applied etc)
+    culled_on_gpu = culling_on_gpu_supported();
     if (out_of_date) {
         auto time_measure_start = std::chrono::system_clock::now();
 
-        // compute new visible data
-        compute_traj_indices();
+        // compute new visible data, the commands of culling on GPU only need the vectors to be set up
+        if (culled_on_gpu) {
+            slotted_indices = false;
+            commands_computed = false;
+            setup_traj_indices();
+            buffers.end_update();
+        } else {
+            compute_traj_indices();
+        }
 
         auto time_measure_end = std::chrono::system_clock::now();
         indices_time = std::chrono::duration_cast<std::chrono::duration<double, std::ratio<1,1000>>>(time_measure_end - time_measure_start);
@@ -1179,7 +1385,16 @@ void plugin::draw(context& ctx) {
     if (roi_active)
         render_roi_box(ctx);
 
+    if (culled_on_gpu)
+        cull_on_gpu(ctx);
+
     if (!hide_trajs) {
+        set_time_window_uniforms();
+
+        // colors are looked up by the time index of each sample
+        if (time_colormap.initial && time_indices_supported())
+            time_colormap.set_colors(time_colors);
+
         if (mode == TRAJ_LINE)
             render_trajectory_lines(ctx);
 
@@ -1211,9 +1426,11 @@ void plugin::draw(context& ctx) {
         render_ellipsoids(ctx);
 
 
-    // clear index vectors to release unneeded memory
+    // clear index vectors, their memory is reused by the next update
+    // (slots are kept to be updated by the next animation step)
     if (out_of_date) {
-        clear_traj_indices();
+        if (!slotted_indices)
+            clear_traj_indices();
         out_of_date = false;
     }
     
@@ -1243,9 +1460,23 @@ void plugin::draw(context& ctx) {
 void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 {
 	// Convenience shortcut to selected trajectory and corresponding ellipsoid axes
-	auto traj = ellips_data->dynamics.trajs[traj_id];
+	const trajectory_data &traj = ellips_data->dynamics.trajs[traj_id];
 	const vec3 &axes = ellips_data->axes[ellips_data->dynamics.axis_ids[traj_id]];
 
+	// End caps need at least two samples
+	if (traj.length < 2)
+		return;
+
+	// The metatube needs the samples of the trajectory in separate vectors
+	const std::vector<vec3> positions(
+		ellips_data->dynamics.positions.begin() + traj.offset,
+		ellips_data->dynamics.positions.begin() + traj.offset + traj.length
+	);
+	const std::vector<vec4> orientations(
+		ellips_data->dynamics.orientations.begin() + traj.offset,
+		ellips_data->dynamics.orientations.begin() + traj.offset + traj.length
+	);
+
 
 	////
 	// Extract mesh
@@ -1253,7 +1484,7 @@ void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 	// Setup surface extraction
 	// - setup metatube implicit function with trajectory data
 	metatube<float> tube(
-		traj->positions, traj->orientations, ellips_data->axes[ellips_data->dynamics.axis_ids[traj_id]]
+		positions, orientations, ellips_data->axes[ellips_data->dynamics.axis_ids[traj_id]]
 	);
 	// - setup extraction handler (to output vertices as points on the fly - for now)
 	surface_extraction_handler<float> handler;
@@ -1273,13 +1504,13 @@ void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 	               max_extend_id = get_ellipsoid_max_axis_id(axes);
 	handler.cellsize = axes[min_extend_id]*2.0f / float(DC_SAMPLING_RES_TARGET);
 	// - sampling domain (do we even need this?)
-	cgv::media::axis_aligned_box<float, 3> domain = discretize(traj->b_box, handler.cellsize);
+	cgv::media::axis_aligned_box<float, 3> domain = discretize(traj.b_box, handler.cellsize);
 
 	// Estimate if tube is too flat for 1st-order MLS-approximant
 	bool use_mls = exact_metatube && ((axes[max_extend_id] < axes[min_extend_id]*2.5f) ? true : false);
 
 	// Scan-convert (kind of) the tube
-	if (use_mls) for (unsigned i=0; i<traj->positions.size(); /* no implicit increment */)
+	if (use_mls) for (unsigned i=0; i<positions.size(); /* no implicit increment */)
 	{
 		// Setup current sampling area
 		i = tube.set_window(i, handler.cellsize);
@@ -1314,14 +1545,14 @@ void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 	// - main loop: move along trajectory
 	float extrusion = (axes[max_extend_id] + axes[mid_extend_id] + axes[min_extend_id]) / 3.0f;
 	unsigned i_last = 0, seg_counts = 0;
-	for (unsigned i=1; i<traj->positions.size(); i++)
+	for (unsigned i=1; i<positions.size(); i++)
 	{
 		// Convencience shortcuts
 		unsigned &c = seg_counts;
-		const vec3 &pos = traj->positions[i];
+		const vec3 &pos = positions[i];
 
 		// Move forward
-		vec3 travel_dir = pos - traj->positions[i_last];
+		vec3 travel_dir = pos - positions[i_last];
 		if (travel_dir.length() >= extrusion/2.0f)
 		{
 			// Increase segment counter
@@ -1334,7 +1565,7 @@ void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 			#define DC_TESS_SECTIONS 12
 			if (i_last == 0)
 			{
-				const vec3 &pos0 = traj->positions[0];
+				const vec3 &pos0 = positions[0];
 				// - establish coordinate frame on cross-section plane
 				vec3 tmp = plane_project(vec3(0,0,0), travel_dir, pos0),
 				     refx = cgv::math::normalize(tmp - pos0),
@@ -1395,11 +1626,11 @@ void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 	#define DC_TESS_ENDCAPS_VCOUNT 1
 	vec3 endcap_extrusion(std::move(
 		cgv::math::normalize(std::move(
-			traj->positions[0] - traj->positions[1]
+			positions[0] - positions[1]
 		)))
 	);
 	unsigned last_idx = (unsigned)verts.size();
-	verts.push_back(std::move(traj->positions[0] + endcap_extrusion*extrusion));
+	verts.push_back(std::move(positions[0] + endcap_extrusion*extrusion));
 	nrmls.push_back(std::move(endcap_extrusion));
 	for (unsigned j=1; j<=DC_TESS_SECTIONS; j++)
 		handler.triangles.push_back(triangle(
@@ -1408,11 +1639,11 @@ void plugin::export_metatube (unsigned traj_id, bool implicit_progress)
 	// - end cap, leading
 	endcap_extrusion = std::move(
 		cgv::math::normalize(std::move(
-			traj->positions.back() - traj->positions[traj->positions.size()-2]
+			positions.back() - positions[positions.size()-2]
 		))
 	);
 	last_idx = (unsigned)verts.size();
-	verts.push_back(std::move(traj->positions.back() + endcap_extrusion*extrusion));
+	verts.push_back(std::move(positions.back() + endcap_extrusion*extrusion));
 	nrmls.push_back(std::move(endcap_extrusion));
 	for (unsigned j=1; j<=DC_TESS_SECTIONS; j++)
 		handler.triangles.push_back(triangle(
@@ -1470,7 +1701,7 @@ void plugin::export_csv(void)
 
 	// Generate filename
 	std::stringstream filename;
-	filename << "trajectories_" << generator_seed << trajs.size() << trajs[0]->positions.size() << ".csv";
+	filename << "trajectories_" << generator_seed << trajs.size() << trajs[0].length << ".csv";
 	std::cout << std::endl << "Exporting trajectories to file '" << filename.str() << "'...";
 
 	// Write data
@@ -1488,8 +1719,11 @@ void plugin::export_csv(void)
 			+ axes[get_ellipsoid_max_axis_id(axes)]
 		) / 3.0f;
 
-		for (const auto &pos : traj->positions)
+		for (size_t i=traj.offset; i<traj.offset+traj.length; i++)
+		{
+			const auto &pos = ellips_data->dynamics.positions[i];
 			csvfile << t << "," << pos.x() << "," << pos.y() << "," << pos.z() << "," << radius << std::endl;
+		}
 	}
 
 	// Done!
@@ -1523,7 +1757,7 @@ void plugin::export_bezdat(void)
 
 	// Generate filename
 	std::stringstream filename;
-	filename << "trajectories_" << generator_seed << trajs.size() << trajs[0]->positions.size() << ".bezdat";
+	filename << "trajectories_" << generator_seed << trajs.size() << trajs[0].length << ".bezdat";
 	std::cout << std::endl << "Exporting trajectories to file '" << filename.str() << "'...";
 
 	// Write data
@@ -1536,6 +1770,12 @@ void plugin::export_bezdat(void)
 	for (unsigned t=0; t<trajs.size(); t++)
 	{
 		const auto &traj = trajs[t];
+
+		// Tangents need at least two samples
+		if (traj.length < 2)
+			continue;
+
+		const vec3 *traj_positions = ellips_data->dynamics.positions.data() + traj.offset;
 		const auto &axes = ellips_data->axes[ellips_data->dynamics.axis_ids[t]];
 		const auto radius = (
 			  axes[get_ellipsoid_min_axis_id(axes)]
@@ -1547,31 +1787,31 @@ void plugin::export_bezdat(void)
 		const auto dist_thresh = radius*reduction_multiple,
 		           dist_thresh_sqr = dist_thresh*dist_thresh;
 		std::vector<vec3> positions, colors;
-		positions.reserve(traj->positions.size()/reduction_multiple);
+		positions.reserve(traj.length/reduction_multiple);
 		colors.reserve(positions.capacity());
-		positions.push_back(traj->positions[0]);
-		colors.emplace_back(toRGB(time_colors[0])*vec3::value_type(255));
-		vec3 *p_last = positions.data();
-		for (unsigned p=1; p<traj->positions.size(); p++)
+		positions.push_back(traj_positions[0]);
+		colors.emplace_back(toRGB(time_colors[traj.start_time])*vec3::value_type(255));
+		const vec3 *p_last = positions.data();
+		for (unsigned p=1; p<traj.length; p++)
 		{
 			// Skip samples that are too close to the previus control point
-			if ((traj->positions[p]-(*p_last)).sqr_length() < dist_thresh_sqr)
+			if ((traj_positions[p]-(*p_last)).sqr_length() < dist_thresh_sqr)
 			{
 				// Handle this becoming the last (or potentially only) bezier segment
-				if (  (traj->positions.back()-traj->positions[p]).sqr_length()
+				if (  (traj_positions[traj.length-1]-traj_positions[p]).sqr_length()
 				    < dist_thresh_sqr)
-					p = traj->positions.size()-1;
+					p = traj.length-1;
 				else
 					continue;
 			}
-			positions.push_back(traj->positions[p]);
-			colors.emplace_back(toRGB(time_colors[p])*vec3::value_type(255));
-			p_last = &(traj->positions[p]);
+			positions.push_back(traj_positions[p]);
+			colors.emplace_back(toRGB(time_colors[traj.start_time+p])*vec3::value_type(255));
+			p_last = &(traj_positions[p]);
 		}
 
 		// Keep track of original sample count for calculating achieved data reduction
 		// later on
-		orig_sampleCount += traj->positions.size();
+		orig_sampleCount += traj.length;
 
 		// Control tangent data
 		unsigned N = (unsigned)positions.size();
@@ -1742,32 +1982,60 @@ void plugin::render_coordinate_system(cgv::render::context& ctx)
     coord_renderer.draw(ctx);
 }
 
+// writes the value of the time step of each sample of all trajectories to vertices_per_sample
+// consecutive vertices starting at the first vertex of the trajectory (its first sample if empty)
+template<typename T>
+static void gather_time_values(std::vector<T>& out, const std::vector<T>& time_values, const std::vector<trajectory_data>& trajs,
+                               const std::vector<unsigned int>& first_vertex, size_t vertices_per_sample)
+{
+    for (size_t p = 0; p < trajs.size(); p++) {
+        const trajectory_data& traj = trajs[p];
+        size_t vertex = first_vertex.empty() ? traj.offset : first_vertex[p];
+        for (size_t t = 0; t < traj.length; t++) {
+            std::fill(out.begin() + vertex, out.begin() + vertex + vertices_per_sample, time_values[traj.start_time + t]);
+            vertex += vertices_per_sample;
+        }
+    }
+}
+
 void plugin::render_trajectory_lines(cgv::render::context& ctx)
 {
     // set all vertex data once
     if (traj_renderer_line.initial) {
         std::cout << "Set up trajectory lines ... ";
-        std::vector<vec3> positions;
-        std::vector<vec4> colors;
-
-        // set traj data
-        for (size_t p = 0; p < ellips_data->dynamics.trajs.size(); p++) {
-            positions.insert(positions.end(),
-                             ellips_data->dynamics.trajs[p]->positions.begin(),
-                             ellips_data->dynamics.trajs[p]->positions.end());
-            colors.insert(colors.end(),
-                          time_colors.begin(),
-                          time_colors.end());
+        size_t nr_samples = ellips_data->dynamics.positions.size();
+
+        // positions of all trajectories are already stored in one array, only the time
+        // index (or color) has to be set for each sample depending on its time step
+        if (time_indices_supported()) {
+            std::vector<unsigned short> sample_time_indices(nr_samples);
+            gather_time_values(sample_time_indices, time_indices, ellips_data->dynamics.trajs, std::vector<unsigned int>(), 1);
+            traj_renderer_line.set_buffers(ctx, ellips_data->dynamics.positions, sample_time_indices, *traj_indices_strip);
+        } else {
+            std::vector<vec4> colors(nr_samples);
+            gather_time_values(colors, time_colors, ellips_data->dynamics.trajs, std::vector<unsigned int>(), 1);
+            traj_renderer_line.set_buffers(ctx, ellips_data->dynamics.positions, colors, *traj_indices_strip);
         }
 
-        traj_renderer_line.set_buffers(ctx, positions, colors, *traj_indices_strip);
+        if (commands_computed)
+            traj_renderer_line.update_command_buffer(buffers.commands);
 
         traj_renderer_line.initial = false;
         std::cout << " finished" << std::endl;
-    } else if (out_of_date) {
-        traj_renderer_line.update_element_buffer(*traj_indices_strip);
+    } else if (out_of_date && !culled_on_gpu) {
+        if (commands_computed) {
+            traj_renderer_line.update_command_buffer(buffers.commands);
+        } else if (indices_patched) {
+            for (size_t i = 0; i < index_patches.size(); i++)
+                traj_renderer_line.update_element_buffer_range(*traj_indices_strip, index_patches[i].first, index_patches[i].second - index_patches[i].first);
+        } else {
+            traj_renderer_line.update_element_buffer(*traj_indices_strip);
+        }
     }
 
+    if (culled_on_gpu)
+        traj_renderer_line.use_command_buffer(culling.command_buffer(), culling.nr_commands());
+
     // all data already transfered to GPU
     // draw with current view
     traj_renderer_line.draw(ctx);
@@ -1781,23 +2049,38 @@ void plugin::render_trajectory_ribbons(cgv::render::context& ctx)
 
         // compute vertices
         std::vector<vec3> vertices;
-        std::vector<vec4> new_colors;
         for (size_t p = 0; p < ellips_data->dynamics.trajs.size(); p++) {
-            traj_renderer_ribbon.create_vertices(vertices, new_colors,
-                                                 ellips_data->dynamics.trajs[p]->positions,
+            const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+            traj_renderer_ribbon.create_vertices(vertices,
+                                                 &ellips_data->dynamics.positions[traj.offset],
+                                                 traj.length,
                                                  ellips_data->axes[ellips_data->dynamics.axis_ids[p]],
-                                                 ellips_data->dynamics.trajs[p]->orientations,
-                                                 time_colors);
+                                                 &ellips_data->dynamics.orientations[traj.offset]);
         }
 
         // need to be called here too since the indices-vector was just filled yet
         compute_traj_indices();
-        traj_renderer_ribbon.set_buffers(ctx, vertices, new_colors, *traj_ribbon_indices);
+
+        // both vertices of a sample get its time index (or color)
+        if (time_indices_supported()) {
+            std::vector<unsigned short> vertex_time_indices(vertices.size());
+            gather_time_values(vertex_time_indices, time_indices, ellips_data->dynamics.trajs, traj_renderer_ribbon.first_vertex, 2);
+            traj_renderer_ribbon.set_buffers(ctx, vertices, vertex_time_indices, *traj_ribbon_indices);
+        } else {
+            std::vector<vec4> colors(vertices.size());
+            gather_time_values(colors, time_colors, ellips_data->dynamics.trajs, traj_renderer_ribbon.first_vertex, 2);
+            traj_renderer_ribbon.set_buffers(ctx, vertices, colors, *traj_ribbon_indices);
+        }
 
         traj_renderer_ribbon.initial = false;
         std::cout << " finished" << std::endl;
     } else if (out_of_date) {
-        traj_renderer_ribbon.update_element_buffer(*traj_ribbon_indices);
+        if (indices_patched) {
+            for (size_t i = 0; i < index_patches.size(); i++)
+                traj_renderer_ribbon.update_element_buffer_range(*traj_ribbon_indices, index_patches[i].first, index_patches[i].second - index_patches[i].first);
+        } else {
+            traj_renderer_ribbon.update_element_buffer(*traj_ribbon_indices);
+        }
     }
 
     // all data already transfered to GPU
@@ -1810,43 +2093,48 @@ void plugin::render_trajectory_3D_ribbons(cgv::render::context& ctx)
     // set all vertex data once
     if (traj_renderer_3D_ribbon.initial) {
         std::cout << "Set up trajectory 3D ribbons (GPU)... ";
-        std::vector<vec4> colors;
-
-        // compute color
-        for (size_t p = 0; p < ellips_data->dynamics.trajs.size(); p++) {
-            colors.insert(colors.end(),
-                          time_colors.begin(),
-                          time_colors.end());
-        }
 
         // compute vertices
         std::vector<vec3> vertices;
-        std::vector<vec4> new_colors;
         std::vector<vec3> normals;
 
-        vertices.reserve(ellips_data->dynamics.axis_ids.size() * ellips_data->max_time_steps * 2);
-        new_colors.reserve(ellips_data->dynamics.axis_ids.size() * ellips_data->max_time_steps * 2);
-        normals.reserve(ellips_data->dynamics.axis_ids.size() * ellips_data->max_time_steps * 2);
+        vertices.reserve(ellips_data->dynamics.positions.size() * 2);
+        normals.reserve(ellips_data->dynamics.positions.size() * 2);
 
 
         for (size_t p = 0; p < ellips_data->dynamics.trajs.size(); p++) {
-            traj_renderer_3D_ribbon.create_vertices(vertices, new_colors, normals,
-                                                    ellips_data->dynamics.trajs[p]->positions,
+            const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+            traj_renderer_3D_ribbon.create_vertices(vertices, normals,
+                                                    &ellips_data->dynamics.positions[traj.offset],
+                                                    traj.length,
                                                     vec3(ellips_data->axes[ellips_data->dynamics.axis_ids[p]][0], 0.0f, 0.0f),
-                                                    ellips_data->dynamics.trajs[p]->main_axis_normals,
-                                                    ellips_data->dynamics.trajs[p]->orientations,
-                                                    colors);
+                                                    ellips_data->get_derived_attributes(p).main_axis_normals,
+                                                    &ellips_data->dynamics.orientations[traj.offset]);
         }
 
         // need to be called here too since the indices-vector was just filled yet
         compute_traj_indices();
 
-        traj_renderer_3D_ribbon.set_buffers(ctx, vertices, new_colors, normals, *traj_3D_ribbon_indices);
+        // all eight vertices of a sample get its time index (or color)
+        if (time_indices_supported()) {
+            std::vector<unsigned short> vertex_time_indices(vertices.size());
+            gather_time_values(vertex_time_indices, time_indices, ellips_data->dynamics.trajs, traj_renderer_3D_ribbon.first_vertex, 8);
+            traj_renderer_3D_ribbon.set_buffers(ctx, vertices, vertex_time_indices, normals, *traj_3D_ribbon_indices);
+        } else {
+            std::vector<vec4> colors(vertices.size());
+            gather_time_values(colors, time_colors, ellips_data->dynamics.trajs, traj_renderer_3D_ribbon.first_vertex, 8);
+            traj_renderer_3D_ribbon.set_buffers(ctx, vertices, colors, normals, *traj_3D_ribbon_indices);
+        }
 
         traj_renderer_3D_ribbon.initial = false;
         std::cout << " finished" << std::endl;
     } else if (out_of_date) {
-        traj_renderer_3D_ribbon.update_element_buffer(*traj_3D_ribbon_indices);
+        if (indices_patched) {
+            for (size_t i = 0; i < index_patches.size(); i++)
+                traj_renderer_3D_ribbon.update_element_buffer_range(*traj_3D_ribbon_indices, index_patches[i].first, index_patches[i].second - index_patches[i].first);
+        } else {
+            traj_renderer_3D_ribbon.update_element_buffer(*traj_3D_ribbon_indices);
+        }
     }
 
     // all data already transfered to GPU
@@ -1859,26 +2147,14 @@ void plugin::render_trajectory_3D_ribbons_gpu(cgv::render::context& ctx)
     // set all vertex data once
     if (traj_renderer_3D_ribbon_gpu.initial) {
         std::cout << "Set up trajectory 3D ribbons (GPU)... ";
-        std::vector<vec3> positions;
-        std::vector<vec4> orientations;
-        std::vector<vec4> colors;
-        std::vector<vec3> axes;
+        std::vector<vec3> axes(ellips_data->dynamics.positions.size());
         std::vector<vec3> normals;
+        ellips_data->gather_main_axis_normals(normals);
 
-        // set traj data
+        // positions and orientations of all trajectories are already stored in one
+        // array each, only time indices (or colors) and axes have to be set for each sample
         for (size_t p = 0; p < ellips_data->dynamics.trajs.size(); p++) {
-            positions.insert(positions.end(),
-                             ellips_data->dynamics.trajs[p]->positions.begin(),
-                             ellips_data->dynamics.trajs[p]->positions.end());
-            orientations.insert(orientations.end(),
-                                ellips_data->dynamics.trajs[p]->orientations.begin(),
-                                ellips_data->dynamics.trajs[p]->orientations.end());
-            normals.insert(normals.end(),
-                           ellips_data->dynamics.trajs[p]->main_axis_normals.begin(),
-                           ellips_data->dynamics.trajs[p]->main_axis_normals.end());
-            colors.insert(colors.end(),
-                          time_colors.begin(),
-                          time_colors.end());
+            const trajectory_data& traj = ellips_data->dynamics.trajs[p];
 
             // find largest axis
             float axis_max = 0.0f;
@@ -1896,24 +2172,44 @@ void plugin::render_trajectory_3D_ribbons_gpu(cgv::render::context& ctx)
                 main_axis = vec3(0.0f, 0.0f, ellips_data->axes[ellips_data->dynamics.axis_ids[p]][2]);
             }
 
-            std::vector<vec3> axis;
-            axis.resize(ellips_data->dynamics.trajs[p]->positions.size());
             // same axis along trajectory
-            std::fill(axis.begin(), axis.end(), main_axis);
-            axes.insert(axes.end(),
-                        axis.begin(),
-                        axis.end());
+            std::fill(axes.begin() + traj.offset, axes.begin() + traj.offset + traj.length, main_axis);
+        }
 
+        size_t nr_samples = ellips_data->dynamics.positions.size();
+        if (time_indices_supported()) {
+            std::vector<unsigned short> sample_time_indices(nr_samples);
+            gather_time_values(sample_time_indices, time_indices, ellips_data->dynamics.trajs, std::vector<unsigned int>(), 1);
+            traj_renderer_3D_ribbon_gpu.set_buffers(ctx, ellips_data->dynamics.positions, sample_time_indices, axes,
+                                                    ellips_data->dynamics.orientations,
+                                                    normals, *traj_indices);
+        } else {
+            std::vector<vec4> colors(nr_samples);
+            gather_time_values(colors, time_colors, ellips_data->dynamics.trajs, std::vector<unsigned int>(), 1);
+            traj_renderer_3D_ribbon_gpu.set_buffers(ctx, ellips_data->dynamics.positions, colors, axes,
+                                                    ellips_data->dynamics.orientations,
+                                                    normals, *traj_indices);
         }
 
-        traj_renderer_3D_ribbon_gpu.set_buffers(ctx, positions, colors, axes, orientations, normals, *traj_indices);
+        if (commands_computed)
+            traj_renderer_3D_ribbon_gpu.update_command_buffer(buffers.commands);
 
         traj_renderer_3D_ribbon_gpu.initial = false;
         std::cout << " finished" << std::endl;
-    } else if (out_of_date) {
-        traj_renderer_3D_ribbon_gpu.update_element_buffer(*traj_indices);
+    } else if (out_of_date && !culled_on_gpu) {
+        if (commands_computed) {
+            traj_renderer_3D_ribbon_gpu.update_command_buffer(buffers.commands);
+        } else if (indices_patched) {
+            for (size_t i = 0; i < index_patches.size(); i++)
+                traj_renderer_3D_ribbon_gpu.update_element_buffer_range(*traj_indices, index_patches[i].first, index_patches[i].second - index_patches[i].first);
+        } else {
+            traj_renderer_3D_ribbon_gpu.update_element_buffer(*traj_indices);
+        }
     }
 
+    if (culled_on_gpu)
+        traj_renderer_3D_ribbon_gpu.use_command_buffer(culling.command_buffer(), culling.nr_commands());
+
     traj_renderer_3D_ribbon_gpu.height = ribbon_height;
 
     // all data already transfered to GPU
@@ -2148,200 +2444,180 @@ void plugin::set_traj_indices_out_of_date()
     }
 
     out_of_date = true;
+    slotted_indices = false;
 
     post_redraw();
 }
 
-bool plugin::filter_length(std::shared_ptr<trajectory_data> traj)
+bool plugin::time_window_on_gpu() const
 {
-    float total_length_x = ellips_data->b_box.max[0] - ellips_data->b_box.min[0];
-    float very_small_x = total_length_x * length_filter_data.thresh_very_small / 100;
-    float small_x = total_length_x * length_filter_data.thresh_small / 100;
-    float medium_x = total_length_x * length_filter_data.thresh_medium / 100;
-
-    float length_x =  abs(traj->b_box.max[0] - traj->b_box.min[0]);
+    // the first and last sample of the window are always part of the level of detail
+    return gpu_time_window && !hide_trajs && !display_glyphs && !display_ellipsoids && time_indices_supported()
+        && !filter_length_active && !(roi_active && roi_with_time_interval) && !lod_supported();
+}
 
+bool plugin::time_indices_supported() const
+{
+    return time_steps <= std::numeric_limits<unsigned short>::max();
+}
 
-    // very small particle that should not be displayed
-    if (length_x < very_small_x && !length_filter_data.x_very_small_traj){
-        return true;
-    }
-    // small particle that should not be displayed
-    else if (length_x > very_small_x && length_x < small_x && !length_filter_data.x_small_traj){
-        return true;
-    }
-    // medium particle that should not be displayed
-    else if (length_x > small_x && length_x < medium_x && !length_filter_data.x_medium_traj) {
-        return true;
-    }
-    // large particle that should not be displayed
-    else if (length_x > medium_x  && !length_filter_data.x_large_traj) {
-        return true;
+void plugin::changed_time_window()
+{
+    // indices of the whole time range stay on the GPU, only the uniforms change
+    if (start_time <= end_time && full_time_indices && time_window_on_gpu()) {
+        // culling on GPU counts the visible trajectories itself
+        if (!culled_on_gpu)
+            count_window_trajs();
+        post_redraw();
+        return;
     }
 
-    float total_length_y = ellips_data->b_box.max[1] - ellips_data->b_box.min[1];
-    float very_small_y = total_length_y * length_filter_data.thresh_very_small / 100;
-    float small_y = total_length_y * length_filter_data.thresh_small / 100;
-    float medium_y = total_length_y * length_filter_data.thresh_medium / 100;
-
-    float length_y =  abs(traj->b_box.max[1] - traj->b_box.min[1]);
-
+    set_traj_indices_out_of_date();
+}
 
-    // very small particle that should not be displayed
-    if (length_y < very_small_y && !length_filter_data.y_very_small_traj){
-        return true;
-    }
-    // small particle that should not be displayed
-    else if (length_y > very_small_y && length_y < small_y && !length_filter_data.y_small_traj){
-        return true;
-    }
-    // medium particle that should not be displayed
-    else if (length_y > small_y && length_y < medium_y && !length_filter_data.y_medium_traj) {
-        return true;
-    }
-    // large particle that should not be displayed
-    else if (length_y > medium_y  && !length_filter_data.y_large_traj) {
-        return true;
+void plugin::set_time_window_uniforms()
+{
+    // time index of each sample is a vertex attribute (or alpha of its color), the window
+    // covers samples [start_time - 1, end_time - 1] (see time_window_samples)
+    float window_start = (float)(start_time - 1);
+    float window_end = (float)(end_time - 1);
+
+    traj_renderer_line.time_window_start = window_start;
+    traj_renderer_line.time_window_end = window_end;
+    traj_renderer_ribbon.time_window_start = window_start;
+    traj_renderer_ribbon.time_window_end = window_end;
+    traj_renderer_3D_ribbon.time_window_start = window_start;
+    traj_renderer_3D_ribbon.time_window_end = window_end;
+    traj_renderer_3D_ribbon_gpu.time_window_start = window_start;
+    traj_renderer_3D_ribbon_gpu.time_window_end = window_end;
+    for (size_t e = 0; e < traj_renderer_tubes.size(); e++) {
+        traj_renderer_tubes[e]->time_window_start = window_start;
+        traj_renderer_tubes[e]->time_window_end = window_end;
     }
+}
 
-    float total_length_z = ellips_data->b_box.max[2] - ellips_data->b_box.min[2];
-    float very_small_z = total_length_z * length_filter_data.thresh_very_small / 100;
-    float small_z = total_length_z * length_filter_data.thresh_small / 100;
-    float medium_z = total_length_z * length_filter_data.thresh_medium / 100;
-
-    float length_z =  abs(traj->b_box.max[2] - traj->b_box.min[2]);
-
-
-    // very small particle that should not be displayed
-    if (length_z < very_small_z && !length_filter_data.z_very_small_traj){
-        return true;
-    }
-    // small particle that should not be displayed
-    else if (length_z > very_small_z && length_z < small_z && !length_filter_data.z_small_traj){
-        return true;
-    }
-    // medium particle that should not be displayed
-    else if (length_z > small_z && length_z < medium_z && !length_filter_data.z_medium_traj) {
-        return true;
-    }
-    // large particle that should not be displayed
-    else if (length_z > medium_z  && !length_filter_data.z_large_traj) {
-        return true;
+void plugin::time_window_samples(const trajectory_data& traj, int start, int end, size_t& first, size_t& last)
+{
+    // time steps are given in range [1, timesteps], samples relative to first sample of trajectory
+    int traj_start = (int)traj.start_time;
+    int traj_end = (int)(traj.start_time + traj.length);
+    int window_start = std::max(start - 1, traj_start);
+    int window_end = std::min(end, traj_end);
+
+    if (window_start >= window_end) {
+        first = 0;
+        last = 0;
+    } else {
+        first = (size_t)(window_start - traj_start);
+        last = (size_t)(window_end - traj_start);
     }
+}
 
-    return false;
+unsigned short plugin::length_class_code(size_t p)
+{
+    // extent of trajectory within the displayed time interval
+    const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+    size_t first, last;
+    time_window_samples(traj, start_time, end_time, first, last);
+    if (first >= last)
+        return length_class_empty;
+    Bounding_Box extent = ellips_data->traj_segments.extent(p, traj.length, &ellips_data->dynamics.positions[traj.offset], first, last);
+
+    unsigned short code = 0;
+    for (int i = 0; i < 3; i++) {
+        float total_length = ellips_data->b_box.max[i] - ellips_data->b_box.min[i];
+        float very_small_length = total_length * length_filter_data.thresh_very_small / 100;
+        float small_length = total_length * length_filter_data.thresh_small / 100;
+        float medium_length = total_length * length_filter_data.thresh_medium / 100;
+
+        float length = abs(extent.max[i] - extent.min[i]);
+
+        // thresholds are independent of each other, therefore a length may belong to several
+        // classes or to none if it equals a threshold
+        unsigned short classes = 0;
+        if (length < very_small_length)
+            classes |= 1;
+        if (length > very_small_length && length < small_length)
+            classes |= 2;
+        if (length > small_length && length < medium_length)
+            classes |= 4;
+        if (length > medium_length)
+            classes |= 8;
+
+        code |= classes << (4 * i);
+    }
+
+    return code;
 }
 
-bool plugin::in_region_of_interest(std::shared_ptr<trajectory_data> traj)
+bool plugin::in_region_of_interest(const trajectory_data& traj)
 {
-    if (traj->b_box.min[0] <= roi.max[0] && traj->b_box.max[0] >= roi.min[0] &&
-            traj->b_box.min[1] <= roi.max[1] && traj->b_box.max[1] >= roi.min[1] &&
-            traj->b_box.min[2] <= roi.max[2] && traj->b_box.max[2] >= roi.min[2]){
+    if (traj.b_box.min[0] <= roi.max[0] && traj.b_box.max[0] >= roi.min[0] &&
+            traj.b_box.min[1] <= roi.max[1] && traj.b_box.max[1] >= roi.min[1] &&
+            traj.b_box.min[2] <= roi.max[2] && traj.b_box.max[2] >= roi.min[2]){
         return true;
     }
 
     return false;
 }
 
-bool plugin::in_region_of_interest_exact(std::shared_ptr<trajectory_data> traj)
+bool plugin::in_region_of_interest_exact(size_t p)
 {
-    bool result = false;
-
-    for (int t = 0; t < (int)traj->positions.size(); t++) {
-        if (traj->positions[t][0] >= roi.min[0] && traj->positions[t][0] <= roi.max[0] &&
-                traj->positions[t][1] >= roi.min[1] && traj->positions[t][1] <= roi.max[1] &&
-                traj->positions[t][2] >= roi.min[2] && traj->positions[t][2] <= roi.max[2]) {
+    const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+    size_t first = 0;
+    size_t last = traj.length;
 
-            if (roi_with_time_interval) {
-                // if automatically searched regions of interests are viewed use time interval
-                // of their search for determining if they are displayed
-                if (show_pois && poi_searched) {
-                    if (t <= poi_end_time && t >= poi_start_time){
-                        result = true;
-                    }
-                } else {
-                    if (t <= end_time && t >= start_time){
-                        result = true;
-                    }
-                }
-            } else {
-                result = true;
-            }
-        }
+    if (roi_with_time_interval) {
+        // if automatically searched regions of interests are viewed use time interval
+        // of their search for determining if they are displayed
+        if (show_pois && poi_searched)
+            time_window_samples(traj, poi_start_time, poi_end_time, first, last);
+        else
+            time_window_samples(traj, start_time, end_time, first, last);
     }
 
-    return result;
+    return ellips_data->traj_segments.intersects(p, traj.length, &ellips_data->dynamics.positions[traj.offset], first, last, roi);
 }
 
-bool plugin::skip_traj(size_t p)
+void plugin::update_roi()
 {
-    bool check_length = !(length_filter_data.x_very_small_traj && length_filter_data.x_small_traj && length_filter_data.x_medium_traj && length_filter_data.x_large_traj
-                        && length_filter_data.y_very_small_traj && length_filter_data.y_small_traj && length_filter_data.y_medium_traj && length_filter_data.y_large_traj
-                        && length_filter_data.z_very_small_traj && length_filter_data.z_small_traj && length_filter_data.z_medium_traj && length_filter_data.z_large_traj)
-                        && filter_length_active;
-
-    if (check_length) {
-        // skips trajectory if it doesn't fit the selected lengths
-        if (filter_length(ellips_data->dynamics.trajs[p]))
-            return true;
-    }
-
-    if (roi_active) {
-        // compute new roi
-        vec3 diff = ellips_data->b_box.max - ellips_data->b_box.min;
-        vec3 length = vec3(roi_data.length_x_percent / 100.0f * diff[0],
-                           roi_data.length_y_percent / 100.0f * diff[1],
-                           roi_data.length_z_percent / 100.0f * diff[2]);
-        roi.min = vec3(roi_data.pos_x_percent / 100.0f * diff[0],
-                       roi_data.pos_y_percent / 100.0f * diff[1],
-                       roi_data.pos_z_percent / 100.0f * diff[2])
-                     + ellips_data->b_box.min;
-        roi.max = roi.min + length;
-        roi.center = roi.min + (length / 2);
-
-        // first check if bounding box of trajectory intersects with roi, skip if not
-        if (!in_region_of_interest(ellips_data->dynamics.trajs[p]))
-                return true;
-
-        // consideration of time interval is only possible for exact computation
-        // therefore turn it on and update gui
-        if (roi_with_time_interval && !roi_exact) {
-            roi_exact = true;
-            update_all_members();
-        }
-
-        // it is possible that the trajectory not really intersected with current roi
-        if (roi_exact) {
-            if (!in_region_of_interest_exact(ellips_data->dynamics.trajs[p]))
-                return true;
-        }
-    }
+    vec3 diff = ellips_data->b_box.max - ellips_data->b_box.min;
+    vec3 length = vec3(roi_data.length_x_percent / 100.0f * diff[0],
+                       roi_data.length_y_percent / 100.0f * diff[1],
+                       roi_data.length_z_percent / 100.0f * diff[2]);
+    roi.min = vec3(roi_data.pos_x_percent / 100.0f * diff[0],
+                   roi_data.pos_y_percent / 100.0f * diff[1],
+                   roi_data.pos_z_percent / 100.0f * diff[2])
+                 + ellips_data->b_box.min;
+    roi.max = roi.min + length;
+    roi.center = roi.min + (length / 2);
+}
 
-    return false;
+bool plugin::skip_traj(size_t p)
+{
+    return !visible_bits.test(p);
 }
 
 void plugin::setup_traj_indices()
 {
-    size_t vis_traj = ellips_data->dynamics.trajs.size();
+    // vectors are persistent and keep their capacity, sizes are set by compute_traj_indices
+    // once the number of elements is known
+    buffers.begin_update(ellips_data->axes.size());
 
     if (mode == TRAJ_LINE && !hide_trajs) {
-        traj_indices_strip = new std::vector<unsigned int>();
-        traj_indices_strip->reserve(vis_traj * (end_time - start_time));
+        traj_indices_strip = &buffers.indices_strip;
     }
 
     if (mode == TRAJ_3D_RIBBON && !hide_trajs) {
-        traj_3D_ribbon_indices = new std::vector<unsigned int>();
-        traj_3D_ribbon_indices->reserve(vis_traj * (end_time - start_time) * 2);
+        traj_3D_ribbon_indices = &buffers.ribbon_3D_indices;
     }
 
     if (mode == TRAJ_3D_RIBBON_GPU && !hide_trajs) {
-        traj_indices = new std::vector<unsigned int>();
-        traj_indices->reserve(vis_traj * (end_time - start_time) * 2);
+        traj_indices = &buffers.indices;
     }
 
     if (mode == TRAJ_RIBBON && !hide_trajs) {
-        traj_ribbon_indices = new std::vector<unsigned int>();
-        traj_ribbon_indices->reserve(vis_traj * (end_time - start_time) * 2);
+        traj_ribbon_indices = &buffers.ribbon_indices;
     }
 
     if (mode == TRAJ_TUBE && !hide_trajs) {
@@ -2350,24 +2626,17 @@ void plugin::setup_traj_indices()
         tubes_colors.resize(ellips_data->axes.size());
 
         for (size_t e = 0; e < ellips_data->axes.size(); e++) {
-            tubes_positions[e] = new std::vector<vec3>();
-            tubes_positions[e]->reserve(vis_traj);
-            tubes_orientations[e] = new std::vector<vec4>();
-            tubes_orientations[e]->reserve(vis_traj);
-            tubes_colors[e] = new std::vector<vec4>();
-            tubes_colors[e]->reserve(vis_traj);
+            tubes_positions[e] = &buffers.tubes_positions[e];
+            tubes_orientations[e] = &buffers.tubes_orientations[e];
+            tubes_colors[e] = &buffers.tubes_colors[e];
         }
     }
 
     if (display_glyphs) {
-        glyph_positions = new std::vector<vec3>();
-        normals_vis = new std::vector<vec3>();
-        velocities = new std::vector<vec3>();
-        angular_velocities = new std::vector<vec3>();
-        glyph_positions->reserve(vis_traj * (end_time - start_time));
-        velocities->reserve(vis_traj * (end_time - start_time));
-        angular_velocities->reserve(vis_traj * (end_time - start_time));
-        normals_vis->reserve(vis_traj * (end_time - start_time));
+        glyph_positions = &buffers.glyph_positions;
+        normals_vis = &buffers.normals;
+        velocities = &buffers.velocities;
+        angular_velocities = &buffers.angular_velocities;
     }
 
     if (display_ellipsoids) {
@@ -2375,244 +2644,1104 @@ void plugin::setup_traj_indices()
         ellipsoid_positions.resize(ellips_data->axes.size());
 
         for (size_t e = 0; e < ellips_data->axes.size(); e++) {
-            ellipsoid_positions[e] = new std::vector<vec3>();
-            ellipsoid_positions[e]->reserve(vis_traj);
-            ellipsoid_orientations[e] = new std::vector<vec4>();
-            ellipsoid_orientations[e]->reserve(vis_traj);
+            ellipsoid_positions[e] = &buffers.ellipsoid_positions[e];
+            ellipsoid_orientations[e] = &buffers.ellipsoid_orientations[e];
         }
     }
 }
 
 void plugin::clear_traj_indices()
 {
-    if (mode == TRAJ_LINE && !hide_trajs)
-        delete traj_indices_strip;
+    // memory is kept for the next update
+    buffers.clear();
+    slotted_indices = false;
+}
+
+// number of candidate trajectories one thread filters and writes at once
+static const size_t index_block_size = 256;
+
+// number of multiples of step in [begin, end) for positive begin
+static size_t count_multiples(int begin, int end, int step)
+{
+    if (begin >= end)
+        return 0;
+    return (size_t)((end - 1) / step - (begin - 1) / step);
+}
 
-    if (mode == TRAJ_3D_RIBBON_GPU && !hide_trajs)
-        delete traj_indices;
+// bits of length classes of the length filter whose trajectories are not displayed
+static unsigned short rejected_length_classes(const LengthFilterData& data)
+{
+    const bool displayed[12] = {
+        data.x_very_small_traj, data.x_small_traj, data.x_medium_traj, data.x_large_traj,
+        data.y_very_small_traj, data.y_small_traj, data.y_medium_traj, data.y_large_traj,
+        data.z_very_small_traj, data.z_small_traj, data.z_medium_traj, data.z_large_traj
+    };
+
+    unsigned short rejected = length_class_empty;
+    for (int c = 0; c < 12; c++) {
+        if (!displayed[c])
+            rejected |= 1 << c;
+    }
+    return rejected;
+}
 
-    if (mode == TRAJ_3D_RIBBON && !hide_trajs)
-        delete traj_3D_ribbon_indices;
+// checks if sample t of window [start_offset, end_offset) is part of the given level of detail
+static bool lod_keep(const unsigned char* levels, int t, int start_offset, int end_offset, unsigned char level)
+{
+    return levels[t] >= level || t == start_offset || t == end_offset - 1;
+}
+
+// number of samples of window [start_offset, end_offset) that are part of the given level of detail
+static size_t lod_sample_count(const unsigned char* levels, int start_offset, int end_offset, unsigned char level)
+{
+    size_t count = 0;
+    for (int t = start_offset; t < end_offset; t++) {
+        if (lod_keep(levels, t, start_offset, end_offset, level))
+            count++;
+    }
+    return count;
+}
 
-    if (mode == TRAJ_RIBBON && !hide_trajs)
-        delete traj_ribbon_indices;
+static bool same_box(const Bounding_Box& a, const Bounding_Box& b)
+{
+    for (int i = 0; i < 3; i++) {
+        if (a.min[i] != b.min[i] || a.max[i] != b.max[i])
+            return false;
+    }
+    return true;
+}
 
-    if (mode == TRAJ_TUBE && !hide_trajs) {
-        for (size_t e = 0; e < ellipsoid_positions.size(); e++) {
-            delete tubes_positions[e];
-            delete tubes_orientations[e];
-            delete tubes_colors[e];
+void plugin::update_length_classes()
+{
+    size_t nr_trajs = ellips_data->dynamics.trajs.size();
+    size_t nr_blocks = (nr_trajs + index_block_size - 1) / index_block_size;
+
+    // classes only change with the time interval and the thresholds
+    bool same_classes = length_classes_valid && length_classes_start == start_time && length_classes_end == end_time
+                        && length_classes_data.thresh_very_small == length_filter_data.thresh_very_small
+                        && length_classes_data.thresh_small == length_filter_data.thresh_small
+                        && length_classes_data.thresh_medium == length_filter_data.thresh_medium;
+    if (same_classes)
+        return;
+
+    length_classes.resize(nr_trajs);
+    index_pool.run(0, nr_blocks, (unsigned int)std::max(index_threads, 1), [&](size_t block) {
+        size_t block_end = std::min((block + 1) * index_block_size, nr_trajs);
+        for (size_t p = block * index_block_size; p < block_end; p++)
+            length_classes[p] = length_class_code(p);
+    });
+
+    length_classes_start = start_time;
+    length_classes_end = end_time;
+    length_classes_data = length_filter_data;
+    length_classes_valid = true;
+    length_bits_valid = false;
+    culling_classes_valid = false;
+}
+
+void plugin::update_length_bits()
+{
+    size_t nr_trajs = ellips_data->dynamics.trajs.size();
+    size_t nr_blocks = (nr_trajs + index_block_size - 1) / index_block_size;
+    unsigned int threads = (unsigned int)std::max(index_threads, 1);
+
+    update_length_classes();
+
+    // toggling the display of a class only tests the codes again
+    unsigned short rejected = rejected_length_classes(length_filter_data);
+    if (length_bits_valid && length_bits_rejected == rejected)
+        return;
+
+    // blocks cover whole words of the bitset
+    length_bits.assign(nr_trajs, false);
+    index_pool.run(0, nr_blocks, threads, [&](size_t block) {
+        size_t block_end = std::min((block + 1) * index_block_size, nr_trajs);
+        for (size_t w = block * index_block_size / 64; w * 64 < block_end; w++) {
+            uint64_t word = 0;
+            for (size_t p = w * 64; p < std::min((w + 1) * 64, block_end); p++) {
+                if (!(length_classes[p] & rejected))
+                    word |= uint64_t(1) << (p % 64);
+            }
+            length_bits.words[w] = word;
         }
+    });
+
+    length_bits_rejected = rejected;
+    length_bits_valid = true;
+}
+
+void plugin::update_roi_bits()
+{
+    size_t nr_trajs = ellips_data->dynamics.trajs.size();
+
+    // time interval is only considered by the exact test (see in_region_of_interest_exact)
+    int window_start = 0;
+    int window_end = 0;
+    if (roi_exact && roi_with_time_interval) {
+        window_start = (show_pois && poi_searched) ? poi_start_time : start_time;
+        window_end = (show_pois && poi_searched) ? poi_end_time : end_time;
     }
-    
-    if (display_ellipsoids) {
-        for (size_t e = 0; e < ellipsoid_positions.size(); e++) {
-            delete ellipsoid_positions[e];
-            delete ellipsoid_orientations[e];
+
+    if (roi_bits_valid && same_box(roi_bits_box, roi) && roi_bits_exact == roi_exact
+            && roi_bits_start == window_start && roi_bits_end == window_end)
+        return;
+
+    // only trajectories whose bounding box intersects the roi have to be tested, the hierarchy
+    // finds them without testing every trajectory
+    if (!ellips_data->traj_bvh.empty()) {
+        ellips_data->traj_bvh.query(roi, roi_candidates);
+    } else {
+        roi_candidates.resize(nr_trajs);
+        for (size_t p = 0; p < nr_trajs; p++)
+            roi_candidates[p] = p;
+    }
+
+    // results are collected per candidate first since bits of one word may be set by different threads
+    size_t nr_candidates = roi_candidates.size();
+    size_t nr_blocks = (nr_candidates + index_block_size - 1) / index_block_size;
+    roi_results.resize(nr_candidates);
+    index_pool.run(0, nr_blocks, (unsigned int)std::max(index_threads, 1), [&](size_t block) {
+        size_t block_end = std::min((block + 1) * index_block_size, nr_candidates);
+        for (size_t c = block * index_block_size; c < block_end; c++) {
+            size_t p = roi_candidates[c];
+            // it is possible that the trajectory not really intersected with current roi
+            roi_results[c] = in_region_of_interest(ellips_data->dynamics.trajs[p]) && (!roi_exact || in_region_of_interest_exact(p));
         }
+    });
+
+    roi_bits.assign(nr_trajs, false);
+    for (size_t c = 0; c < nr_candidates; c++) {
+        if (roi_results[c])
+            roi_bits.set(roi_candidates[c]);
     }
 
-    if (display_glyphs) {
-        delete glyph_positions;
-        delete velocities;
-        delete normals_vis;
-        delete angular_velocities;
+    roi_bits_box = roi;
+    roi_bits_exact = roi_exact;
+    roi_bits_start = window_start;
+    roi_bits_end = window_end;
+    roi_bits_valid = true;
+}
+
+void plugin::update_filter_bits()
+{
+    bool check_length = filter_length_active && !all_length_classes_displayed();
+
+    // results of each filter are cached and only recomputed if its settings changed
+    visible_bits.assign(ellips_data->dynamics.trajs.size(), true);
+
+    if (check_length) {
+        update_length_bits();
+        visible_bits.intersect(length_bits);
+    }
+
+    if (roi_active) {
+        update_roi_bits();
+        visible_bits.intersect(roi_bits);
     }
 }
 
-void plugin::compute_traj_indices()
+bool plugin::all_length_classes_displayed() const
+{
+    return length_filter_data.x_very_small_traj && length_filter_data.x_small_traj && length_filter_data.x_medium_traj && length_filter_data.x_large_traj
+        && length_filter_data.y_very_small_traj && length_filter_data.y_small_traj && length_filter_data.y_medium_traj && length_filter_data.y_large_traj
+        && length_filter_data.z_very_small_traj && length_filter_data.z_small_traj && length_filter_data.z_medium_traj && length_filter_data.z_large_traj;
+}
+
+bool plugin::culling_on_gpu_supported() const
+{
+    // exact roi tests and the instances of glyphs and ellipsoids need the filter results on the cpu
+    return gpu_culling && culling.supported && draw_commands_supported()
+        && !display_glyphs && !display_ellipsoids && !(roi_active && (roi_exact || roi_with_time_interval));
+}
+
+// compares all settings of two culling passes except for the view
+static bool same_culling_filters(const Cull_Settings& a, const Cull_Settings& b)
+{
+    return a.start_time == b.start_time && a.end_time == b.end_time && a.rejected_classes == b.rejected_classes
+        && a.roi_active == b.roi_active && same_box(a.roi, b.roi) && a.single_traj == b.single_traj
+        && a.frustum_culling == b.frustum_culling;
+}
+
+void plugin::cull_on_gpu(cgv::render::context& ctx)
+{
+    // trajectories are transferred once per data set
+    if (culling.initial) {
+        std::vector<Cull_Trajectory> trajectories(ellips_data->dynamics.trajs.size());
+        for (size_t p = 0; p < trajectories.size(); p++) {
+            const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+            Cull_Trajectory& cull_traj = trajectories[p];
+            cull_traj.box_min = vec4(traj.b_box.min[0], traj.b_box.min[1], traj.b_box.min[2], 0.0f);
+            cull_traj.box_max = vec4(traj.b_box.max[0], traj.b_box.max[1], traj.b_box.max[2], 0.0f);
+            cull_traj.first = (unsigned int)traj.offset;
+            cull_traj.length = (unsigned int)traj.length;
+            cull_traj.start_time = (unsigned int)traj.start_time;
+            cull_traj.padding = 0;
+        }
+        culling.set_trajectories(trajectories, ellips_data->dynamics.positions);
+        culling_classes_valid = false;
+    }
+
+    Cull_Settings settings;
+    settings.start_time = start_time;
+    settings.end_time = end_time;
+
+    // length classes depend on the extent within the time window and are therefore computed on the cpu
+    settings.rejected_classes = 0;
+    if (filter_length_active && !all_length_classes_displayed()) {
+        update_length_classes();
+        if (!culling_classes_valid) {
+            culling.update_length_classes(length_classes);
+            culling_classes_valid = true;
+        }
+        settings.rejected_classes = rejected_length_classes(length_filter_data);
+    }
+
+    settings.roi_active = roi_active;
+    if (roi_active)
+        update_roi();
+    settings.roi = roi;
+    settings.single_traj = display_single_traj ? single_traj_id : -1;
+    settings.frustum_culling = frustum_culling;
+    frustum_planes(ctx.get_projection_matrix() * ctx.get_modelview_matrix(), settings.planes);
+
+    // without frustum culling the commands only change with the filters
+    bool filters_changed = out_of_date || !same_culling_filters(settings, culling_settings);
+    if (filters_changed || frustum_culling)
+        culling.cull(ctx, settings);
+
+    // reading the counters waits for the shader
+    if (filters_changed || perf_stats) {
+        unsigned int visible, drawn_chunks, culled_chunks;
+        culling.read_counts(visible, drawn_chunks, culled_chunks);
+        nr_visible_traj = (int)visible;
+        nr_drawn_chunks = (int)drawn_chunks;
+        nr_culled_chunks = (int)culled_chunks;
+    }
+
+    if (verify_culling) {
+        size_t differences = culling.verify(settings);
+        std::cout << "GPU culling: " << differences << " of " << culling.nr_commands() << " commands differ from cpu reference" << std::endl;
+        verify_culling = false;
+    }
+
+    culling_settings = settings;
+}
+
+void plugin::verify_gpu_culling()
+{
+    if (!culled_on_gpu) {
+        std::cout << "GPU culling is not used for current settings" << std::endl;
+        return;
+    }
+
+    verify_culling = true;
+    post_redraw();
+}
+
+void plugin::invalidate_filter_bits()
+{
+    length_classes_valid = false;
+    length_bits_valid = false;
+    roi_bits_valid = false;
+}
+
+size_t plugin::prepare_candidates()
 {
     // get number of trajectories that should be displayed
     size_t vis_traj = ellips_data->dynamics.trajs.size();
-    size_t start_id = 0;
-
-    setup_traj_indices();
+    candidate_start_id = 0;
 
     // display only one trajectory
     if (display_single_traj) {
-        start_id = single_traj_id;
-        vis_traj = start_id + 1;
+        candidate_start_id = single_traj_id;
+        vis_traj = candidate_start_id + 1;
     }
 
-    // count number of visualized trajectory
-    nr_visible_traj = 0;
+    use_roi_candidates = false;
+    if (roi_active) {
+        update_roi();
 
-    for (size_t p = start_id; p < vis_traj; p++) {
-        if (skip_traj(p)) {
-            continue;
+        // consideration of time interval is only possible for exact computation
+        // therefore turn it on and update gui
+        if (roi_with_time_interval && !roi_exact) {
+            roi_exact = true;
+            update_all_members();
         }
 
-        // compute offsets for inserting vector elements
-        //   - std::vector::end is the element past the last element of the vector
-        //   - std::vector::insert inserts element between first and last position
-        //     (including first but not including last)
-        //   - start and end time is given in range of [1, timesteps]
-        int start_offset = start_time - 1;
-        int end_offset = end_time;
-
-        if (mode == TRAJ_LINE && !hide_trajs) {
-            traj_indices_strip->insert(traj_indices_strip->end(),
-                    ellips_data->dynamics.trajs[p]->indices_strip.begin() + start_offset,
-                    ellips_data->dynamics.trajs[p]->indices_strip.begin() + end_offset);
-            // determine end of primitive
-            traj_indices_strip->push_back(restart_id);
+        // only trajectories whose bounding box intersects the roi are candidates (see update_roi_bits)
+        use_roi_candidates = !display_single_traj && !ellips_data->traj_bvh.empty();
+    }
+
+    update_filter_bits();
+
+    return use_roi_candidates ? roi_candidates.size() : vis_traj - candidate_start_id;
+}
+
+void plugin::compute_traj_indices()
+{
+    full_time_indices = time_window_on_gpu();
+    if (!full_time_indices) {
+        compute_window_traj_indices();
+        return;
+    }
+
+    // the shaders apply the time window, therefore indices of the whole time range are computed
+    int window_start = start_time;
+    int window_end = end_time;
+    start_time = 1;
+    end_time = (int)time_steps;
+
+    compute_window_traj_indices();
+
+    start_time = window_start;
+    end_time = window_end;
+    count_window_trajs();
+}
+
+void plugin::count_window_trajs()
+{
+    // candidates that passed the filters and have samples inside of the time window
+    int count = 0;
+    for (size_t c = 0; c < visible_trajs.size(); c++) {
+        const VisibleTraj& visible = visible_trajs[c];
+        if (visible.start_offset >= visible.end_offset)
+            continue;
+
+        const trajectory_data& traj = ellips_data->dynamics.trajs[visible.id];
+        int traj_start = (int)traj.start_time;
+        int traj_end = (int)(traj.start_time + traj.length);
+        if (std::max(start_time - 1, traj_start) < std::min(end_time, traj_end))
+            count++;
+    }
+    nr_visible_traj = count;
+}
+
+void plugin::compute_window_traj_indices()
+{
+    bool step = animation_step;
+    animation_step = false;
+    indices_patched = false;
+    commands_computed = false;
+
+    // while animating the indices are stored in slots that allow to move the end of the time window
+    bool slotted = animate && !paused && !full_time_indices && slotted_indices_supported();
+    if (slotted && step && slotted_indices && start_time == slotted_start_time && mode == slotted_mode) {
+        update_slotted_traj_indices();
+        return;
+    }
+    slotted_indices = false;
+
+    setup_traj_indices();
+    size_t nr_candidates = prepare_candidates();
+
+    if (slotted) {
+        compute_slotted_traj_indices(nr_candidates);
+        return;
+    }
+
+    // index vector of current render mode, stays empty if the trajectories are drawn with commands
+    bool commands = draw_commands_supported();
+    std::vector<unsigned int>* indices = commands ? nullptr : mode_indices();
+    bool tubes = mode == TRAJ_TUBE && !hide_trajs;
+    bool ellipsoid_ticks = ellipsoid_tick_sample < (int)time_steps;
+
+    // candidates are split into blocks that are handled by different threads:
+    //   1. each block filters its candidates and counts its output elements
+    //   2. prefix sums of the counts give the position of each block inside the output vectors
+    //   3. each block writes its elements to its position
+    // output is therefore identical to appending the elements of one trajectory after another
+    size_t nr_blocks = (nr_candidates + index_block_size - 1) / index_block_size;
+    size_t nr_ids = ellips_data->axes.size();
+
+    // samples of each trajectory are decimated by its level of detail
+    bool lod = lod_supported();
+    const unsigned char* lod_levels = lod ? ellips_data->traj_lod.sample_levels(0) : nullptr;
+
+    // counts of each block: visible trajectories, indices, glyphs, samples and drawn samples with
+    // level of detail, tube samples and ellipsoids of each id
+    const size_t count_visible = 0;
+    const size_t count_indices = 1;
+    const size_t count_glyphs = 2;
+    const size_t count_samples = 3;
+    const size_t count_lod_samples = 4;
+    const size_t count_tubes = 5;
+    const size_t count_ellipsoids = 5 + nr_ids;
+    const size_t nr_counts = 5 + 2 * nr_ids;
+
+    visible_trajs.resize(nr_candidates);
+    block_counts.assign((nr_blocks + 1) * nr_counts, 0);
+    unsigned int threads = (unsigned int)std::max(index_threads, 1);
+
+    // 1. filter and count
+    index_pool.run(0, nr_blocks, threads, [&](size_t block) {
+        size_t* counts = &block_counts[(block + 1) * nr_counts];
+        size_t block_end = std::min((block + 1) * index_block_size, nr_candidates);
+
+        for (size_t c = block * index_block_size; c < block_end; c++) {
+            VisibleTraj& visible = visible_trajs[c];
+            visible.id = candidate_id(c);
+            visible.start_offset = 0;
+            visible.end_offset = 0;
+            visible.lod_level = 0;
+
+            visible.filtered = skip_traj(visible.id);
+            if (visible.filtered)
+                continue;
+
+            // start and end time is given in range of [1, timesteps], a trajectory does not need
+            // to cover all time steps, therefore the offsets are clipped to its time steps and
+            // given relative to its first sample
+            const trajectory_data& traj = ellips_data->dynamics.trajs[visible.id];
+            int traj_start = (int)traj.start_time;
+            int traj_end = (int)(traj.start_time + traj.length);
+            int start_offset = std::max(start_time - 1, traj_start);
+            int end_offset = std::min(end_time, traj_end);
+            if (start_offset >= end_offset)
+                continue;
+            visible.start_offset = start_offset - traj_start;
+            visible.end_offset = end_offset - traj_start;
+
+            size_t samples = (size_t)(visible.end_offset - visible.start_offset);
+            counts[count_visible]++;
+
+            // lines and ribbons only get the samples of the level of detail of the trajectory
+            if (lod) {
+                counts[count_samples] += samples;
+                visible.lod_level = traj_lod_level(traj);
+                if (visible.lod_level > 0)
+                    samples = lod_sample_count(lod_levels + traj.offset, visible.start_offset, visible.end_offset, visible.lod_level);
+                counts[count_lod_samples] += samples;
+            }
+
+            if (mode == TRAJ_LINE && indices)
+                counts[count_indices] += samples + 1;
+            if (mode == TRAJ_3D_RIBBON_GPU && indices)
+                counts[count_indices] += 2 * samples;
+            if (mode == TRAJ_3D_RIBBON && indices && traj_renderer_3D_ribbon.first_vertex.size() > 0)
+                counts[count_indices] += 4 * (2 * samples + 1);
+            if (mode == TRAJ_RIBBON && indices)
+                counts[count_indices] += (traj_renderer_ribbon.first_vertex.size() > 0 ? 2 * samples : 0) + 1;
+
+            size_t id = ellips_data->dynamics.axis_ids[visible.id];
+            if (tubes)
+                counts[count_tubes + id] += samples;
+            if (display_ellipsoids)
+                counts[count_ellipsoids + id] += (ellipsoid_ticks ? count_multiples(std::max(start_time, traj_start), traj_start + visible.end_offset, ellipsoid_tick_sample) : 0) + 1;
+            if (display_glyphs)
+                counts[count_glyphs] += count_multiples(std::max(start_time, traj_start), traj_start + visible.end_offset, glyph_sample);
         }
+    });
+
+    // 2. prefix sums, afterwards the first row holds the total counts
+    //    and row block + 1 the position of block inside the output vectors
+    for (size_t block = 0; block < nr_blocks; block++) {
+        size_t* total = &block_counts[0];
+        size_t* counts = &block_counts[(block + 1) * nr_counts];
+        for (size_t k = 0; k < nr_counts; k++) {
+            size_t count = counts[k];
+            counts[k] = total[k];
+            total[k] += count;
+        }
+    }
 
-        if (mode == TRAJ_3D_RIBBON_GPU && !hide_trajs) {
-            traj_indices->insert(traj_indices->end(),
-                    ellips_data->dynamics.trajs[p]->indices.begin() + (start_offset * 2),
-                    ellips_data->dynamics.trajs[p]->indices.begin() + (end_offset * 2) - 1);
-            // determine end of primitive
-            traj_indices->push_back(restart_id);
+    nr_visible_traj = (int)block_counts[count_visible];
+    nr_lod_samples = block_counts[count_samples];
+    nr_lod_drawn_samples = block_counts[count_lod_samples];
+    if (indices)
+        indices->resize(block_counts[count_indices]);
+    if (commands)
+        buffers.commands.resize(block_counts[count_visible]);
+    commands_computed = commands;
+    if (tubes) {
+        for (size_t e = 0; e < nr_ids; e++) {
+            tubes_positions[e]->resize(block_counts[count_tubes + e]);
+            tubes_orientations[e]->resize(block_counts[count_tubes + e]);
+            tubes_colors[e]->resize(block_counts[count_tubes + e]);
         }
+    }
+    if (display_ellipsoids) {
+        for (size_t e = 0; e < nr_ids; e++) {
+            ellipsoid_positions[e]->resize(block_counts[count_ellipsoids + e]);
+            ellipsoid_orientations[e]->resize(block_counts[count_ellipsoids + e]);
+        }
+    }
 
-        if (mode == TRAJ_3D_RIBBON && !hide_trajs) {
-            if (traj_renderer_3D_ribbon.indices_top.size() > 0){
-                traj_3D_ribbon_indices->insert(traj_3D_ribbon_indices->end(),
-                        traj_renderer_3D_ribbon.indices_top[p].begin() + (start_offset * 2),
-                        traj_renderer_3D_ribbon.indices_top[p].begin() + (end_offset * 2));
-                traj_3D_ribbon_indices->push_back(restart_id);
-
-                traj_3D_ribbon_indices->insert(traj_3D_ribbon_indices->end(),
-                        traj_renderer_3D_ribbon.indices_side1[p].begin() + (start_offset * 2),
-                        traj_renderer_3D_ribbon.indices_side1[p].begin() + (end_offset * 2));
-                traj_3D_ribbon_indices->push_back(restart_id);
-
-                traj_3D_ribbon_indices->insert(traj_3D_ribbon_indices->end(),
-                        traj_renderer_3D_ribbon.indices_bottom[p].begin() + (start_offset * 2),
-                        traj_renderer_3D_ribbon.indices_bottom[p].begin() + (end_offset * 2));
-                traj_3D_ribbon_indices->push_back(restart_id);
-
-                traj_3D_ribbon_indices->insert(traj_3D_ribbon_indices->end(),
-                        traj_renderer_3D_ribbon.indices_side2[p].begin() + (start_offset * 2),
-                        traj_renderer_3D_ribbon.indices_side2[p].begin() + (end_offset * 2));
-                traj_3D_ribbon_indices->push_back(restart_id);
+    // 3. write elements of each block
+    const vec3* positions = ellips_data->dynamics.positions.data();
+    const vec4* orientations = ellips_data->dynamics.orientations.data();
+
+    index_pool.run(0, nr_blocks, threads, [&](size_t block) {
+        // positions of block inside output vectors are advanced by each written element
+        size_t* offsets = &block_counts[(block + 1) * nr_counts];
+        size_t block_end = std::min((block + 1) * index_block_size, nr_candidates);
+
+        for (size_t c = block * index_block_size; c < block_end; c++) {
+            const VisibleTraj& visible = visible_trajs[c];
+            if (visible.start_offset >= visible.end_offset)
+                continue;
+
+            size_t p = visible.id;
+            const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+            int traj_start = (int)traj.start_time;
+            int start_offset = visible.start_offset;
+            int end_offset = visible.end_offset;
+
+            // all index ranges are consecutive and therefore generated instead of copied
+            // from stored index arrays
+            unsigned int first_sample = (unsigned int)(traj.offset + start_offset);
+            unsigned int end_sample = (unsigned int)(traj.offset + end_offset);
+
+            if (commands) {
+                Draw_Command& command = buffers.commands[offsets[count_visible]++];
+                command.count = end_sample - first_sample;
+                command.instance_count = 1;
+                command.first = first_sample;
+                command.base_instance = 0;
             }
-        }
 
-        if (mode == TRAJ_RIBBON && !hide_trajs) {
-            if (traj_renderer_ribbon.indices.size() > 0){
-                traj_ribbon_indices->insert(traj_ribbon_indices->end(),
-                        traj_renderer_ribbon.indices[p].begin() + (start_offset * 2),
-                        traj_renderer_ribbon.indices[p].begin() + (end_offset * 2));
+            // samples of the level of detail, the first and last sample of the window are always kept
+            unsigned char level = visible.lod_level;
+            const unsigned char* levels = level > 0 ? lod_levels + traj.offset : nullptr;
+
+            if (mode == TRAJ_LINE && indices && levels) {
+                unsigned int* begin = &(*indices)[offsets[count_indices]];
+                unsigned int* out = begin;
+                for (int t = start_offset; t < end_offset; t++) {
+                    if (lod_keep(levels, t, start_offset, end_offset, level))
+                        *out++ = (unsigned int)traj.offset + t;
+                }
+                *out++ = restart_id;
+                offsets[count_indices] += out - begin;
+            } else if (mode == TRAJ_LINE && indices) {
+                unsigned int* out = &(*indices)[offsets[count_indices]];
+                for (unsigned int i = first_sample; i < end_sample; i++)
+                    *out++ = i;
+                // determine end of primitive
+                *out++ = restart_id;
+                offsets[count_indices] += end_sample - first_sample + 1;
             }
-            traj_ribbon_indices->push_back(restart_id);
-        }
 
-        if (mode == TRAJ_TUBE && !hide_trajs) {    
-            // get ellipsoid id of current traj
-            size_t id = ellips_data->dynamics.axis_ids[p];
+            if (mode == TRAJ_3D_RIBBON_GPU && indices && levels) {
+                unsigned int* begin = &(*indices)[offsets[count_indices]];
+                unsigned int* out = begin;
+                // line segments between neighbouring kept samples
+                unsigned int previous = first_sample;
+                for (int t = start_offset + 1; t < end_offset; t++) {
+                    if (lod_keep(levels, t, start_offset, end_offset, level)) {
+                        *out++ = previous;
+                        *out++ = (unsigned int)traj.offset + t;
+                        previous = (unsigned int)traj.offset + t;
+                    }
+                }
+                *out++ = previous;
+                *out++ = restart_id;
+                offsets[count_indices] += out - begin;
+            } else if (mode == TRAJ_3D_RIBBON_GPU && indices) {
+                unsigned int* out = &(*indices)[offsets[count_indices]];
+                // line segments between neighbouring samples, the last sample only starts a segment
+                for (unsigned int i = first_sample; i + 1 < end_sample; i++) {
+                    *out++ = i;
+                    *out++ = i + 1;
+                }
+                *out++ = end_sample - 1;
+                // determine end of primitive
+                *out++ = restart_id;
+                offsets[count_indices] += 2 * (end_sample - first_sample);
+            }
 
-            // TODO: this is very slow (because of vec3 and vec4 elements?)
-            // update position and orientation vectors for tubes
-            tubes_positions[id]->insert(tubes_positions[id]->end(),
-                    ellips_data->dynamics.trajs[p]->positions.begin() + start_offset,
-                    ellips_data->dynamics.trajs[p]->positions.begin() + end_offset);
-            tubes_orientations[id]->insert(tubes_orientations[id]->end(),
-                    ellips_data->dynamics.trajs[p]->orientations.begin() + start_offset,
-                    ellips_data->dynamics.trajs[p]->orientations.begin() + end_offset);
-            tubes_colors[id]->insert(tubes_colors[id]->end(),
-                    time_colors.begin() + start_offset,
-                    time_colors.begin() + end_offset);
-        }
+            if (mode == TRAJ_3D_RIBBON && indices) {
+                if (traj_renderer_3D_ribbon.first_vertex.size() > 0){
+                    unsigned int* out = &(*indices)[offsets[count_indices]];
+                    unsigned int first_vertex = traj_renderer_3D_ribbon.first_vertex[p];
+
+                    // top, side 1, bottom and side 2 are separate strips
+                    for (unsigned int side = 0; side < 4; side++) {
+                        for (int t = start_offset; t < end_offset; t++) {
+                            unsigned int vertex = first_vertex + 8 * t + 2 * side;
+                            *out++ = vertex;
+                            *out++ = vertex + 1;
+                        }
+                        *out++ = restart_id;
+                    }
+                    offsets[count_indices] += 4 * (2 * (end_offset - start_offset) + 1);
+                }
+            }
+
+            if (mode == TRAJ_RIBBON && indices && levels) {
+                unsigned int* begin = &(*indices)[offsets[count_indices]];
+                unsigned int* out = begin;
+                // both vertices of each kept sample
+                unsigned int first_vertex = traj_renderer_ribbon.first_vertex[p];
+                for (int t = start_offset; t < end_offset; t++) {
+                    if (lod_keep(levels, t, start_offset, end_offset, level)) {
+                        *out++ = first_vertex + 2 * t;
+                        *out++ = first_vertex + 2 * t + 1;
+                    }
+                }
+                *out++ = restart_id;
+                offsets[count_indices] += out - begin;
+            } else if (mode == TRAJ_RIBBON && indices) {
+                unsigned int* out = &(*indices)[offsets[count_indices]];
+                if (traj_renderer_ribbon.first_vertex.size() > 0){
+                    unsigned int first_vertex = traj_renderer_ribbon.first_vertex[p];
+                    for (int v = start_offset * 2; v < end_offset * 2; v++)
+                        *out++ = first_vertex + v;
+                }
+                *out++ = restart_id;
+                offsets[count_indices] += (traj_renderer_ribbon.first_vertex.size() > 0 ? 2 * (end_offset - start_offset) : 0) + 1;
+            }
 
-        if (display_ellipsoids) {
             // get ellipsoid id of current traj
             size_t id = ellips_data->dynamics.axis_ids[p];
 
-            if (ellipsoid_tick_sample < (int)time_steps) {
-                for (int t = start_time; t < end_time; t++) {
-                    // do not display ellipsoid at every timestep
-                    if (!(t % ellipsoid_tick_sample)) {
-                        // update position and orientation vectors with last ellipsoid position
-                        ellipsoid_positions[id]->push_back(ellips_data->dynamics.trajs[p]->positions[t]);
-                        ellipsoid_orientations[id]->push_back(ellips_data->dynamics.trajs[p]->orientations[t]);
+            if (tubes) {
+                // update position, orientation and color vectors for tubes
+                size_t& offset = offsets[count_tubes + id];
+                std::copy(positions + traj.offset + start_offset, positions + traj.offset + end_offset,
+                          tubes_positions[id]->begin() + offset);
+                std::copy(orientations + traj.offset + start_offset, orientations + traj.offset + end_offset,
+                          tubes_orientations[id]->begin() + offset);
+                std::copy(time_colors.begin() + traj_start + start_offset, time_colors.begin() + traj_start + end_offset,
+                          tubes_colors[id]->begin() + offset);
+                offset += end_offset - start_offset;
+            }
+
+            if (display_ellipsoids) {
+                size_t& offset = offsets[count_ellipsoids + id];
+
+                if (ellipsoid_ticks) {
+                    for (int t = std::max(start_time, traj_start); t < traj_start + end_offset; t++) {
+                        // do not display ellipsoid at every timestep
+                        if (!(t % ellipsoid_tick_sample)) {
+                            (*ellipsoid_positions[id])[offset] = positions[traj.offset + t - traj_start];
+                            (*ellipsoid_orientations[id])[offset] = orientations[traj.offset + t - traj_start];
+                            offset++;
+                        }
                     }
                 }
-            }
 
-            // always display ellipsoid at end of traj
-            int index = end_time - 1;
-            // update position and orientation vectors with last ellipsoid position
-            ellipsoid_positions[id]->push_back(ellips_data->dynamics.trajs[p]->positions[index]);
-            ellipsoid_orientations[id]->push_back(ellips_data->dynamics.trajs[p]->orientations[index]);
+                // always display ellipsoid at end of traj
+                int index = end_offset - 1;
+                (*ellipsoid_positions[id])[offset] = positions[traj.offset + index];
+                (*ellipsoid_orientations[id])[offset] = orientations[traj.offset + index];
+                offset++;
+            }
         }
+    });
+
+    // glyphs need derived attributes of the trajectories which are computed on first use by the
+    // shared cache (in parallel on their own), therefore they are written by this thread only
+    if (display_glyphs) {
+        glyph_positions->reserve(block_counts[count_glyphs]);
+        velocities->reserve(block_counts[count_glyphs]);
+        normals_vis->reserve(block_counts[count_glyphs]);
+        angular_velocities->reserve(block_counts[count_glyphs]);
+
+        for (size_t c = 0; c < nr_candidates; c++) {
+            const VisibleTraj& visible = visible_trajs[c];
+            if (visible.start_offset >= visible.end_offset)
+                continue;
+
+            const trajectory_data& traj = ellips_data->dynamics.trajs[visible.id];
+            int traj_start = (int)traj.start_time;
 
-        if (display_glyphs) {
-            for (int t = start_time; t < end_time; t++) {
+            derived_attributes derived = ellips_data->get_derived_attributes(visible.id);
+            for (int t = std::max(start_time, traj_start); t < traj_start + visible.end_offset; t++) {
                 // do not display glyph at every timestep
                 if (!(t % glyph_sample)) {
-                    glyph_positions->push_back(ellips_data->dynamics.trajs[p]->positions[t]);
-                    velocities->push_back(glyph_scale_rate * ellips_data->dynamics.trajs[p]->velocities[t]);
-                    normals_vis->push_back(glyph_scale_rate * ellips_data->dynamics.trajs[p]->main_axis_normals[t]);
-                    angular_velocities->push_back(glyph_scale_rate * ellips_data->dynamics.trajs[p]->angular_velocities[t]);
+                    size_t i = t - traj_start;
+                    glyph_positions->push_back(positions[traj.offset + i]);
+                    velocities->push_back(glyph_scale_rate * derived.velocities[i]);
+                    normals_vis->push_back(glyph_scale_rate * derived.main_axis_normals[i]);
+                    angular_velocities->push_back(glyph_scale_rate * derived.angular_velocities[i]);
                 }
             }
         }
+    }
+
+    buffers.end_update();
+}
+
+
+// maximum number of ranges transferred to the element buffer by an incremental update
+static const size_t max_index_patches = 64;
+
+// number of index strips of each trajectory
+static size_t slot_strips(RenderMode mode)
+{
+    return mode == TRAJ_3D_RIBBON ? 4 : 1;
+}
 
-        nr_visible_traj++;
-    }   
+// number of indices of one strip of a slot for the given number of samples
+static size_t strip_capacity(RenderMode mode, size_t samples)
+{
+    return (mode == TRAJ_LINE ? 1 : 2) * samples + 1;
 }
 
+std::vector<unsigned int>* plugin::mode_indices()
+{
+    if (hide_trajs)
+        return nullptr;
+    if (mode == TRAJ_LINE)
+        return traj_indices_strip;
+    if (mode == TRAJ_3D_RIBBON_GPU)
+        return traj_indices;
+    if (mode == TRAJ_3D_RIBBON)
+        return traj_3D_ribbon_indices;
+    if (mode == TRAJ_RIBBON)
+        return traj_ribbon_indices;
+    return nullptr;
+}
 
-class CompareROIData
+bool plugin::draw_commands_supported() const
 {
-public:
-    bool operator() (std::pair<int, ROIData> a, std::pair<int, ROIData> b)
-    {
-        return a.first < b.first;
+    // commands always draw all samples of the window
+    if (!multi_draw || hide_trajs || lod_supported())
+        return false;
+
+    return (mode == TRAJ_LINE && traj_renderer_line.multi_draw_supported)
+        || (mode == TRAJ_3D_RIBBON_GPU && traj_renderer_3D_ribbon_gpu.multi_draw_supported);
+}
+
+bool plugin::lod_supported() const
+{
+    if (!lod_active || hide_trajs || ellips_data->traj_lod.empty())
+        return false;
+
+    return mode == TRAJ_LINE || mode == TRAJ_3D_RIBBON_GPU
+        || (mode == TRAJ_RIBBON && traj_renderer_ribbon.first_vertex.size() > 0);
+}
+
+bool plugin::update_lod_view(cgv::render::context& ctx)
+{
+    if (!view_ptr || ctx.get_height() == 0)
+        return false;
+
+    dvec3 _eye = view_ptr->get_eye();
+    dvec3 _focus = view_ptr->get_focus();
+    vec3 eye((float)_eye[0], (float)_eye[1], (float)_eye[2]);
+    vec3 focus((float)_focus[0], (float)_focus[1], (float)_focus[2]);
+    float focus_distance = (focus - eye).length();
+
+    // a view angle of 0 is an orthographic projection
+    double angle = view_ptr->get_y_view_angle();
+    bool perspective = angle > 0.01;
+    float pixel_size = perspective ? (float)(2.0 * std::tan(0.5 * angle * M_PI / 180.0) / ctx.get_height())
+                                   : (float)(view_ptr->get_y_extent_at_focus() / ctx.get_height());
+
+    // levels only change by one for twice the pixel size, small changes of the view keep the indices
+    if (lod_view_valid && perspective == lod_perspective) {
+        float ratio = pixel_size / lod_pixel_size;
+        bool moved = perspective && (eye - lod_eye).length() > 0.1f * std::min(focus_distance, lod_focus_distance);
+        if (!moved && ratio > 0.8f && ratio < 1.25f)
+            return false;
+    }
+
+    lod_eye = eye;
+    lod_focus_distance = focus_distance;
+    lod_pixel_size = pixel_size;
+    lod_perspective = perspective;
+    lod_view_valid = true;
+    return true;
+}
+
+unsigned char plugin::traj_lod_level(const trajectory_data& traj) const
+{
+    // size of a pixel at the point of the bounding box closest to the eye, full resolution if the eye lies inside
+    float pixel_size = lod_pixel_size;
+    if (lod_perspective) {
+        vec3 distance;
+        for (int i = 0; i < 3; i++)
+            distance[i] = std::max(std::max(traj.b_box.min[i] - lod_eye[i], lod_eye[i] - traj.b_box.max[i]), 0.0f);
+        pixel_size *= distance.length();
+    }
+    return trajectory_lod::level(traj.b_box, lod_pixel_error * pixel_size);
+}
+
+bool plugin::slotted_indices_supported() const
+{
+    // instances of tubes, ellipsoids and glyphs are always computed completely,
+    // commands are small enough to be rewritten on each animation step
+    if (hide_trajs || display_glyphs || display_ellipsoids || draw_commands_supported() || lod_supported())
+        return false;
+
+    return mode == TRAJ_LINE || mode == TRAJ_3D_RIBBON_GPU
+        || (mode == TRAJ_RIBBON && traj_renderer_ribbon.first_vertex.size() > 0)
+        || (mode == TRAJ_3D_RIBBON && traj_renderer_3D_ribbon.first_vertex.size() > 0);
+}
+
+size_t plugin::slot_samples(const VisibleTraj& visible) const
+{
+    const trajectory_data& traj = ellips_data->dynamics.trajs[visible.id];
+    int end_offset = std::min(end_time - (int)traj.start_time, (int)traj.length);
+
+    if (visible.filtered || end_offset <= visible.start_offset)
+        return 0;
+    return (size_t)(end_offset - visible.start_offset);
+}
+
+unsigned int plugin::slot_index(size_t p, unsigned int first_sample, int start_offset, size_t samples, size_t strip, size_t pos) const
+{
+    if (mode == TRAJ_LINE)
+        return pos < samples ? first_sample + (unsigned int)pos : restart_id;
+
+    if (mode == TRAJ_3D_RIBBON_GPU) {
+        // line segments between neighbouring samples, the last sample only starts a segment
+        if (pos + 2 < 2 * samples)
+            return first_sample + (unsigned int)(pos / 2 + pos % 2);
+        if (samples > 0 && pos + 2 == 2 * samples)
+            return first_sample + (unsigned int)samples - 1;
+        return restart_id;
     }
-};
 
+    if (pos >= 2 * samples)
+        return restart_id;
 
-void plugin::search_points_of_interest()
+    if (mode == TRAJ_RIBBON)
+        return traj_renderer_ribbon.first_vertex[p] + 2 * start_offset + (unsigned int)pos;
+
+    // top, side 1, bottom and side 2 are separate strips
+    return traj_renderer_3D_ribbon.first_vertex[p] + 8 * (start_offset + (unsigned int)(pos / 2)) + 2 * (unsigned int)strip + (unsigned int)(pos % 2);
+}
+
+void plugin::write_slot(std::vector<unsigned int>& indices, size_t c, size_t from, size_t to)
 {
-    std::cout << "start searching for interesting points ... ";
+    const VisibleTraj& visible = visible_trajs[c];
+    const trajectory_data& traj = ellips_data->dynamics.trajs[visible.id];
+    unsigned int first_sample = (unsigned int)(traj.offset + visible.start_offset);
+    size_t samples = (size_t)(visible.end_offset - visible.start_offset);
 
-    poi_points.resize(0);
+    size_t strips = slot_strips(mode);
+    size_t capacity = (slot_offsets[c + 1] - slot_offsets[c]) / strips;
+    to = std::min(to, capacity);
 
-    // save current state of length and time filter
-    poi_start_time = start_time;
-    poi_end_time = end_time;
-    poi_length_filter_data = length_filter_data;
+    for (size_t strip = 0; strip < strips; strip++) {
+        unsigned int* out = &indices[slot_offsets[c] + strip * capacity];
+        for (size_t pos = from; pos < to; pos++)
+            out[pos] = slot_index(visible.id, first_sample, visible.start_offset, samples, strip, pos);
+    }
+}
 
-    // activate length filter
-    filter_length_active = true;
+void plugin::compute_slotted_traj_indices(size_t nr_candidates)
+{
+    std::vector<unsigned int>& indices = *mode_indices();
+    size_t strips = slot_strips(mode);
+
+    // each candidate gets a slot that is large enough for all of its samples after start time,
+    // unused indices are filled with restart indices which do not create any primitives
+    visible_trajs.resize(nr_candidates);
+    slot_offsets.resize(nr_candidates + 1);
+    size_t nr_indices = 0;
+    for (size_t c = 0; c < nr_candidates; c++) {
+        VisibleTraj& visible = visible_trajs[c];
+        const trajectory_data& traj = ellips_data->dynamics.trajs[candidate_id(c)];
+        visible.id = candidate_id(c);
+        visible.start_offset = std::max(start_time - 1 - (int)traj.start_time, 0);
+        visible.end_offset = visible.start_offset;
+
+        slot_offsets[c] = nr_indices;
+        if (visible.start_offset < (int)traj.length)
+            nr_indices += strips * strip_capacity(mode, traj.length - visible.start_offset);
+    }
+    slot_offsets[nr_candidates] = nr_indices;
+    indices.resize(nr_indices);
+
+    size_t nr_blocks = (nr_candidates + index_block_size - 1) / index_block_size;
+    index_pool.run(0, nr_blocks, (unsigned int)std::max(index_threads, 1), [&](size_t block) {
+        size_t block_end = std::min((block + 1) * index_block_size, nr_candidates);
+
+        for (size_t c = block * index_block_size; c < block_end; c++) {
+            VisibleTraj& visible = visible_trajs[c];
+            visible.filtered = skip_traj(visible.id);
+            visible.end_offset = visible.start_offset + (int)slot_samples(visible);
+            write_slot(indices, c, 0, slot_offsets[c + 1] - slot_offsets[c]);
+        }
+    });
 
-    // activate roi
-    roi_active = true;
-    roi_exact = true;
-    roi_with_time_interval = true;
+    nr_visible_traj = 0;
+    for (size_t c = 0; c < nr_candidates; c++) {
+        if (visible_trajs[c].start_offset < visible_trajs[c].end_offset)
+            nr_visible_traj++;
+    }
 
-    // store results ordered by number of found trajectories
-    std::priority_queue<std::pair<int, ROIData>, std::vector<std::pair<int, ROIData>>, CompareROIData> pq;
+    slotted_indices = true;
+    slotted_start_time = start_time;
+    slotted_mode = mode;
+    buffers.end_update();
+}
 
-    // move roi through whole dataset
-    for (int x = 0; x < 100; x = x + (roi_data.length_x_percent / 2)) {
-        for (int y = 0; y < 100; y = y + (roi_data.length_x_percent / 2)) {
-            for (int z = 0; z < 100; z = z + (roi_data.length_x_percent / 2)) {
-                roi_data.pos_x_percent = x;
-                roi_data.pos_y_percent = y;
-                roi_data.pos_z_percent = z;
+void plugin::update_slotted_traj_indices()
+{
+    std::vector<unsigned int>& indices = *mode_indices();
+    size_t strips = slot_strips(mode);
+    size_t nr_candidates = visible_trajs.size();
+    size_t indices_per_sample = mode == TRAJ_LINE ? 1 : 2;
+
+    // filters depending on the time window have to be applied again
+    bool time_filters = filter_length_active || (roi_active && roi_with_time_interval);
+    if (time_filters)
+        update_filter_bits();
+
+    // only the end of the slot of each trajectory changes, index ranges of each strip that
+    // are written are stored in index_patches (empty if nothing changed)
+    index_patches.resize(nr_candidates * strips);
+
+    size_t nr_blocks = (nr_candidates + index_block_size - 1) / index_block_size;
+    index_pool.run(0, nr_blocks, (unsigned int)std::max(index_threads, 1), [&](size_t block) {
+        size_t block_end = std::min((block + 1) * index_block_size, nr_candidates);
+
+        for (size_t c = block * index_block_size; c < block_end; c++) {
+            VisibleTraj& visible = visible_trajs[c];
+            for (size_t strip = 0; strip < strips; strip++)
+                index_patches[c * strips + strip] = std::make_pair(0, 0);
+
+            if (time_filters)
+                visible.filtered = skip_traj(visible.id);
+
+            size_t old_samples = (size_t)(visible.end_offset - visible.start_offset);
+            size_t samples = slot_samples(visible);
+            if (samples == old_samples)
+                continue;
+            visible.end_offset = visible.start_offset + (int)samples;
+
+            // last primitive before the changed samples is written too since the line segment
+            // of the last sample and the restart index move
+            size_t from = indices_per_sample * std::min(samples, old_samples);
+            from = from >= 2 ? from - 2 : 0;
+            size_t capacity = (slot_offsets[c + 1] - slot_offsets[c]) / strips;
+            size_t to = std::min(indices_per_sample * std::max(samples, old_samples) + 1, capacity);
+
+            write_slot(indices, c, from, to);
+            for (size_t strip = 0; strip < strips; strip++) {
+                size_t first = slot_offsets[c] + strip * capacity;
+                index_patches[c * strips + strip] = std::make_pair(first + from, first + to);
+            }
+        }
+    });
+
+    merge_index_patches();
 
-                compute_traj_indices();
+    nr_visible_traj = 0;
+    for (size_t c = 0; c < nr_candidates; c++) {
+        if (visible_trajs[c].start_offset < visible_trajs[c].end_offset)
+            nr_visible_traj++;
+    }
 
-                if (nr_visible_traj > 0)
-                    pq.push(std::make_pair(nr_visible_traj, roi_data));
+    indices_patched = true;
+    buffers.end_update();
+}
 
-                clear_traj_indices();
+void plugin::merge_index_patches()
+{
+    // remove empty ranges, ranges are already ordered by their position
+    size_t count = 0;
+    for (size_t i = 0; i < index_patches.size(); i++) {
+        if (index_patches[i].first < index_patches[i].second)
+            index_patches[count++] = index_patches[i];
+    }
+    index_patches.resize(count);
+
+    // transfer of many small ranges is slower than transferring some unchanged indices,
+    // therefore ranges are merged across all but the largest gaps
+    if (count > max_index_patches) {
+        patch_gaps.resize(count - 1);
+        for (size_t i = 0; i + 1 < count; i++)
+            patch_gaps[i] = index_patches[i + 1].first - index_patches[i].second;
+        size_t merges = count - max_index_patches;
+        std::nth_element(patch_gaps.begin(), patch_gaps.begin() + merges, patch_gaps.end());
+        size_t min_gap = patch_gaps[merges];
+
+        // gaps equal to the smallest kept one are merged until enough ranges are removed
+        size_t equal_merges = merges;
+        for (size_t i = 0; i < merges; i++) {
+            if (patch_gaps[i] < min_gap)
+                equal_merges--;
+        }
+
+        size_t merged = 0;
+        for (size_t i = 1; i < count; i++) {
+            size_t gap = index_patches[i].first - index_patches[merged].second;
+            if (gap < min_gap || (gap == min_gap && equal_merges > 0)) {
+                if (gap == min_gap)
+                    equal_merges--;
+                index_patches[merged].second = index_patches[i].second;
+            } else {
+                index_patches[++merged] = index_patches[i];
             }
         }
+        index_patches.resize(merged + 1);
+    }
+}
+
+void plugin::search_points_of_interest()
+{
+    if (poi_finder.running()) {
+        std::cout << "search for interesting points is already running" << std::endl;
+        return;
+    }
+
+    std::cout << "start searching for interesting points in the background" << std::endl;
+
+    // save current state of length and time filter
+    pending_poi_start_time = start_time;
+    pending_poi_end_time = end_time;
+    pending_poi_length_filter_data = length_filter_data;
+    pending_poi_roi = roi_data;
+
+    // the length filter is always active during the search
+    bool check_length = !all_length_classes_displayed();
+    if (check_length)
+        update_length_bits();
+
+    // samples of the time interval of every trajectory passing the length filter
+    std::vector<std::pair<size_t, size_t>> sample_ranges;
+    size_t first_traj = display_single_traj ? (size_t)single_traj_id : 0;
+    size_t end_traj = display_single_traj ? first_traj + 1 : ellips_data->dynamics.trajs.size();
+    for (size_t p = first_traj; p < end_traj; p++) {
+        if (check_length && !length_bits.test(p))
+            continue;
+
+        const trajectory_data& traj = ellips_data->dynamics.trajs[p];
+        size_t first, last;
+        time_window_samples(traj, start_time, end_time, first, last);
+        if (first < last)
+            sample_ranges.push_back(std::make_pair(traj.offset + first, traj.offset + last));
     }
 
-    while (poi_points.size() < max_pois && pq.size() > 0) {
-        std::pair<int, ROIData> data = pq.top();
-        poi_points.push_back(data.second);
-        pq.pop();
-        
+    // roi is moved through whole dataset in steps of half of its length in x direction
+    poi_settings settings;
+    settings.b_box = ellips_data->b_box;
+    settings.step = roi_data.length_x_percent / 2;
+    settings.length_percent[0] = roi_data.length_x_percent;
+    settings.length_percent[1] = roi_data.length_y_percent;
+    settings.length_percent[2] = roi_data.length_z_percent;
+    settings.max_pois = max_pois;
+    settings.threads = (unsigned int)std::max(index_threads, 1);
+
+    poi_finder.start(ellips_data->dynamics.positions, sample_ranges, settings);
+}
+
+void plugin::finish_points_of_interest()
+{
+    std::vector<poi_result> results;
+    if (!poi_finder.fetch(results))
+        return;
+
+    // results are ordered by number of found trajectories
+    poi_points.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        poi_points[i] = pending_poi_roi;
+        poi_points[i].pos_x_percent = results[i].pos_percent[0];
+        poi_points[i].pos_y_percent = results[i].pos_percent[1];
+        poi_points[i].pos_z_percent = results[i].pos_percent[2];
     }
 
-    std::cout << "finished with " << poi_points.size() << " points" << std::endl;
+    poi_start_time = pending_poi_start_time;
+    poi_end_time = pending_poi_end_time;
+    poi_length_filter_data = pending_poi_length_filter_data;
+
+    std::cout << "finished searching for interesting points with " << poi_points.size() << " points ("
+              << poi_finder.placements << " placements in " << poi_finder.search_time << " ms)" << std::endl;
     poi_searched = true;
 
     show_pois = true;
@@ -2740,6 +3869,19 @@ void plugin::stream_stats(std::ostream& os)
 
     cgv::utils::oprintf(os, "  number of trajectories: %s visible - %s total \n", nr_visible_traj, nr_particles);
 
+    cgv::utils::oprintf(os, "  memory usage: %s MB current - %s MB peak\n", current_memory_usage() / (1024 * 1024), peak_memory_usage() / (1024 * 1024));
+
+    cgv::utils::oprintf(os, "  index buffers: %s MB reserved - %s buffers grown on last update - %s buffers grown on %s updates\n", buffers.capacity_bytes() / (1024 * 1024), buffers.last_grown, buffers.total_grown, buffers.updates);
+    if (culled_on_gpu)
+        cgv::utils::oprintf(os, "  culling on GPU: %s chunks drawn - %s chunks culled by view frustum (%s samples per chunk)\n", nr_drawn_chunks, nr_culled_chunks, traj_culling::chunk_size);
+    if (lod_supported())
+        cgv::utils::oprintf(os, "  level of detail: %s of %s samples drawn (%.2f pixel error)\n", nr_lod_drawn_samples, nr_lod_samples, lod_pixel_error);
+    if (commands_computed)
+        cgv::utils::oprintf(os, "  draw commands: %s (%s KB) instead of indices\n", buffers.commands.size(), buffers.commands.size() * sizeof(Draw_Command) / 1024);
+
+    const derived_attribute_cache& derived = ellips_data->dynamics.derived;
+    cgv::utils::oprintf(os, "  derived attributes: %s MB cached - %s hits / %s misses / %s evictions\n", derived.size / (1024 * 1024), derived.hits, derived.misses, derived.evictions);
+
     if (perf_stats) {
         double _min_gpu_time = (min_gpu_time == std::numeric_limits<double>::max()) ? 0 : min_gpu_time;
         double _min_indices_time = (min_indices_time == std::numeric_limits<double>::max()) ? 0 : min_indices_time;
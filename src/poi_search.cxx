@@ -0,0 +1,182 @@
+#include <chrono>
+#include <queue>
+#include <algorithm>
+
+#include "poi_search.h"
+#include "parallel.h"
+
+namespace ellipsoid_trajectory {
+
+// orders results by count and placements with same count by their position in the search grid
+static bool better_result(const poi_result& a, const poi_result& b)
+{
+    if (a.count != b.count)
+        return a.count > b.count;
+    for (int i = 0; i < 3; i++) {
+        if (a.pos_percent[i] != b.pos_percent[i])
+            return a.pos_percent[i] < b.pos_percent[i];
+    }
+    return false;
+}
+
+poi_search::poi_search()
+    : placements(0), search_time(0.0), positions(nullptr), number_steps(0), stop(false), finished(false)
+{
+}
+
+poi_search::~poi_search()
+{
+    cancel();
+}
+
+void poi_search::start(const std::vector<vec3>& _positions, std::vector<std::pair<size_t, size_t>>& sample_ranges, const poi_settings& _settings)
+{
+    cancel();
+
+    positions = &_positions;
+    ranges.swap(sample_ranges);
+    settings = _settings;
+    settings.step = std::max(settings.step, 1);
+
+    // roi of each placement is computed like plugin::update_roi, therefore a sample lies inside of a placement
+    // found here if and only if it lies inside of the roi set to this placement
+    number_steps = (100 + settings.step - 1) / settings.step;
+    vec3 diff = settings.b_box.max - settings.b_box.min;
+    for (int a = 0; a < 3; a++) {
+        float length = settings.length_percent[a] / 100.0f * diff[a];
+        roi_min[a].resize(number_steps);
+        roi_max[a].resize(number_steps);
+        for (int i = 0; i < number_steps; i++) {
+            roi_min[a][i] = (i * settings.step) / 100.0f * diff[a] + settings.b_box.min[a];
+            roi_max[a][i] = roi_min[a][i] + length;
+        }
+    }
+
+    stop = false;
+    finished = false;
+    results.clear();
+    worker = std::thread(&poi_search::run, this);
+}
+
+void poi_search::cancel()
+{
+    if (worker.joinable()) {
+        stop = true;
+        worker.join();
+    }
+    stop = false;
+}
+
+bool poi_search::fetch(std::vector<poi_result>& result)
+{
+    if (!worker.joinable() || !finished)
+        return false;
+
+    worker.join();
+    result.swap(results);
+    results.clear();
+    return true;
+}
+
+void poi_search::score_ranges(size_t begin, size_t end, std::vector<int>& counts, std::vector<size_t>& stamps)
+{
+    const vec3* samples = positions->data();
+    size_t steps = (size_t)number_steps;
+
+    for (size_t r = begin; r < end && !stop; r++) {
+        // stamp of a placement is set to the trajectory that counted it last, thus each trajectory
+        // is counted at most once per placement
+        size_t stamp = r + 1;
+        size_t lo[3] = { 0, 0, 0 };
+        size_t hi[3] = { 0, 0, 0 };
+
+        for (size_t s = ranges[r].first; s < ranges[r].second; s++) {
+            // placements containing the sample along each axis: min <= position <= max
+            size_t sample_lo[3];
+            size_t sample_hi[3];
+            for (int a = 0; a < 3; a++) {
+                float position = samples[s][a];
+                sample_lo[a] = std::lower_bound(roi_max[a].begin(), roi_max[a].end(), position) - roi_max[a].begin();
+                sample_hi[a] = std::upper_bound(roi_min[a].begin(), roi_min[a].end(), position) - roi_min[a].begin();
+            }
+
+            // consecutive samples usually lie inside of the same placements
+            if (std::equal(sample_lo, sample_lo + 3, lo) && std::equal(sample_hi, sample_hi + 3, hi))
+                continue;
+            std::copy(sample_lo, sample_lo + 3, lo);
+            std::copy(sample_hi, sample_hi + 3, hi);
+
+            for (size_t x = lo[0]; x < hi[0]; x++) {
+                for (size_t y = lo[1]; y < hi[1]; y++) {
+                    size_t cell = (x * steps + y) * steps;
+                    for (size_t z = lo[2]; z < hi[2]; z++) {
+                        if (stamps[cell + z] != stamp) {
+                            stamps[cell + z] = stamp;
+                            counts[cell + z]++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void poi_search::run()
+{
+    auto time_start = std::chrono::steady_clock::now();
+
+    // every thread scores a part of the trajectories with its own counts which are summed up afterwards
+    size_t number_placements = (size_t)number_steps * number_steps * number_steps;
+    unsigned int threads = std::max(settings.threads, 1u);
+    size_t parts = std::min((size_t)threads, std::max(ranges.size(), (size_t)1));
+    std::vector<std::vector<int>> part_counts(parts);
+
+    parallel_for(0, parts, threads, [&](size_t part) {
+        std::vector<int>& counts = part_counts[part];
+        std::vector<size_t> stamps(number_placements, 0);
+        counts.assign(number_placements, 0);
+        score_ranges(part * ranges.size() / parts, (part + 1) * ranges.size() / parts, counts, stamps);
+    });
+
+    if (stop)
+        return;
+
+    for (size_t part = 1; part < parts; part++) {
+        for (size_t cell = 0; cell < number_placements; cell++)
+            part_counts[0][cell] += part_counts[part][cell];
+    }
+
+    // heap keeps the best max_pois placements, its top is the worst of them
+    auto worse = [](const poi_result& a, const poi_result& b) { return better_result(a, b); };
+    std::priority_queue<poi_result, std::vector<poi_result>, decltype(worse)> best(worse);
+    for (size_t cell = 0; cell < number_placements && settings.max_pois > 0; cell++) {
+        if (part_counts[0][cell] == 0)
+            continue;
+
+        poi_result result;
+        result.count = part_counts[0][cell];
+        result.pos_percent[0] = (int)(cell / (number_steps * number_steps)) * settings.step;
+        result.pos_percent[1] = (int)(cell / number_steps % number_steps) * settings.step;
+        result.pos_percent[2] = (int)(cell % number_steps) * settings.step;
+
+        if (best.size() < settings.max_pois) {
+            best.push(result);
+        } else if (better_result(result, best.top())) {
+            best.pop();
+            best.push(result);
+        }
+    }
+
+    results.clear();
+    while (!best.empty()) {
+        results.push_back(best.top());
+        best.pop();
+    }
+    std::reverse(results.begin(), results.end());
+
+    placements = number_placements;
+    search_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - time_start).count();
+    finished = true;
+}
+
+}
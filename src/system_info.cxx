@@ -0,0 +1,59 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#include "system_info.h"
+
+namespace ellipsoid_trajectory {
+
+size_t current_memory_usage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (size_t)counters.WorkingSetSize;
+#elif defined(__linux__)
+    // second value is the number of resident pages
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr)
+        return 0;
+    if (fscanf(file, "%zu %zu", &total_pages, &resident_pages) != 2)
+        resident_pages = 0;
+    fclose(file);
+    return resident_pages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+size_t peak_memory_usage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (size_t)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    // bytes on macOS
+    return (size_t)usage.ru_maxrss;
+#else
+    // kilobytes on linux
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+}
@@ -0,0 +1,45 @@
+#include "traj_bitset.h"
+
+namespace ellipsoid_trajectory {
+
+static size_t count_bits(uint64_t word)
+{
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (size_t)((word * 0x0101010101010101ull) >> 56);
+}
+
+trajectory_bitset::trajectory_bitset()
+    : bits(0)
+{
+}
+
+void trajectory_bitset::assign(size_t size, bool value)
+{
+    bits = size;
+    words.assign((size + 63) / 64, value ? ~uint64_t(0) : uint64_t(0));
+
+    if (value && size % 64 != 0)
+        words.back() = (uint64_t(1) << (size % 64)) - 1;
+}
+
+void trajectory_bitset::intersect(const trajectory_bitset& other)
+{
+    // plain loop over words without dependencies, vectorized by the compiler
+    uint64_t* dst = words.data();
+    const uint64_t* src = other.words.data();
+    size_t number_words = words.size();
+    for (size_t w = 0; w < number_words; w++)
+        dst[w] &= src[w];
+}
+
+size_t trajectory_bitset::count() const
+{
+    size_t number = 0;
+    for (size_t w = 0; w < words.size(); w++)
+        number += count_bits(words[w]);
+    return number;
+}
+
+}
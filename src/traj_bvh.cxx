@@ -0,0 +1,130 @@
+#include <limits>
+#include <algorithm>
+
+#include "traj_bvh.h"
+#include "data.h"
+
+namespace ellipsoid_trajectory {
+
+// maximum number of trajectories in one leaf
+static const size_t bvh_leaf_size = 4;
+// median split halves the number of trajectories on each level, therefore 64 levels are never reached
+static const size_t bvh_max_depth = 64;
+
+static bool intersects(const bvh_node& node, const Bounding_Box& box)
+{
+    return node.min[0] <= box.max[0] && node.max[0] >= box.min[0] &&
+           node.min[1] <= box.max[1] && node.max[1] >= box.min[1] &&
+           node.min[2] <= box.max[2] && node.max[2] >= box.min[2];
+}
+
+void trajectory_bvh::build(const std::vector<trajectory_data>& trajs)
+{
+    clear();
+    if (trajs.empty())
+        return;
+
+    ids.resize(trajs.size());
+    for (size_t p = 0; p < trajs.size(); p++)
+        ids[p] = (uint32_t)p;
+
+    // binary tree with at most one leaf per trajectory
+    nodes.reserve(2 * trajs.size());
+    build_node(trajs, 0, trajs.size());
+
+    bounding_boxes.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        bounding_boxes[i] = trajs[ids[i]].b_box;
+}
+
+void trajectory_bvh::clear()
+{
+    nodes.clear();
+    ids.clear();
+    bounding_boxes.clear();
+}
+
+uint32_t trajectory_bvh::build_node(const std::vector<trajectory_data>& trajs, size_t begin, size_t end)
+{
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.push_back(bvh_node());
+
+    // bounding box of all trajectories and of their centers
+    vec3 min = vec3(std::numeric_limits<float>::max());
+    vec3 max = vec3(-std::numeric_limits<float>::max());
+    vec3 center_min = min;
+    vec3 center_max = max;
+    for (size_t i = begin; i < end; i++) {
+        const Bounding_Box& b_box = trajs[ids[i]].b_box;
+        for (int j = 0; j < 3; j++) {
+            min[j] = std::min(min[j], b_box.min[j]);
+            max[j] = std::max(max[j], b_box.max[j]);
+            center_min[j] = std::min(center_min[j], b_box.center[j]);
+            center_max[j] = std::max(center_max[j], b_box.center[j]);
+        }
+    }
+    nodes[index].min = min;
+    nodes[index].max = max;
+
+    if (end - begin <= bvh_leaf_size) {
+        nodes[index].first = (uint32_t)begin;
+        nodes[index].count = (uint32_t)(end - begin);
+        return index;
+    }
+
+    // split at median of centers along longest axis
+    vec3 extent = center_max - center_min;
+    int axis = 0;
+    if (extent[1] > extent[axis])
+        axis = 1;
+    if (extent[2] > extent[axis])
+        axis = 2;
+
+    size_t mid = begin + (end - begin) / 2;
+    std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return trajs[a].b_box.center[axis] < trajs[b].b_box.center[axis]; });
+
+    // left child is the next node
+    build_node(trajs, begin, mid);
+    uint32_t right = build_node(trajs, mid, end);
+
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+void trajectory_bvh::query(const Bounding_Box& box, std::vector<size_t>& result) const
+{
+    result.clear();
+    if (nodes.empty())
+        return;
+
+    uint32_t stack[bvh_max_depth];
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const bvh_node& node = nodes[stack[--stack_size]];
+        if (!intersects(node, box))
+            continue;
+
+        if (node.count > 0) {
+            // bounding box of each trajectory of leaf is tested on its own
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Bounding_Box& b_box = bounding_boxes[i];
+                if (b_box.min[0] <= box.max[0] && b_box.max[0] >= box.min[0] &&
+                        b_box.min[1] <= box.max[1] && b_box.max[1] >= box.min[1] &&
+                        b_box.min[2] <= box.max[2] && b_box.max[2] >= box.min[2])
+                    result.push_back(ids[i]);
+            }
+        } else {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = (uint32_t)(&node - &nodes[0]) + 1;
+        }
+    }
+
+    // trajectories are processed in the same order as without hierarchy
+    std::sort(result.begin(), result.end());
+}
+
+}
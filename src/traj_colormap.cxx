@@ -0,0 +1,43 @@
+#include <cgv_gl/gl/gl.h>
+#include <cgv_gl/gl/gl_tools.h>
+
+#include "traj_colormap.h"
+
+using namespace cgv::render;
+
+namespace ellipsoid_trajectory {
+
+    traj_colormap::traj_colormap()
+    {
+        initial = true;
+        TBO = 0;
+        TBO_texture = 0;
+    }
+
+    void traj_colormap::init(context& ctx)
+    {
+        glGenBuffers(1, &TBO);
+        glGenTextures(1, &TBO_texture);
+
+        // texture buffers are not limited to the maximum size of 1D textures
+        glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+        glBindTexture(GL_TEXTURE_BUFFER, TBO_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void traj_colormap::reset()
+    {
+        initial = true;
+    }
+
+    void traj_colormap::set_colors(std::vector<vec4>& colors)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+        glBufferData(GL_TEXTURE_BUFFER, colors.size() * sizeof(vec4), colors.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        initial = false;
+    }
+}
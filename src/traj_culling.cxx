@@ -0,0 +1,285 @@
+#include <string>
+#include <limits>
+#include <algorithm>
+
+#include <cgv_gl/gl/gl.h>
+#include <cgv_gl/gl/gl_tools.h>
+
+#include "traj_culling.h"
+#include "parallel.h"
+
+using namespace cgv::render;
+
+namespace ellipsoid_trajectory {
+
+    const size_t traj_culling::chunk_size;
+
+    // number of chunks handled by one work group (see traj_culling_shader.glcs)
+    static const size_t cull_group_size = 256;
+
+    traj_culling::traj_culling()
+    {
+        initial = true;
+        supported = false;
+    }
+
+    void traj_culling::init(context& ctx)
+    {
+        if (!prog.is_created()) {
+            if (!prog.build_program(ctx, "traj_culling_shader.glpr", true)) {
+                std::cerr << "ERROR in traj_culling::init() ... could not build program traj_culling_shader.glpr" << std::endl;
+            }
+        }
+
+        glGenBuffers(1, &SSBO_trajectories);
+        glGenBuffers(1, &SSBO_chunks);
+        glGenBuffers(1, &SSBO_classes);
+        glGenBuffers(1, &SSBO_counts);
+        glGenBuffers(1, &DIBO);
+
+        // counters of visible trajectories and of drawn and culled chunks
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_counts);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(unsigned int), nullptr, GL_DYNAMIC_READ);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // compute shaders and glMultiDrawArraysIndirect are core since OpenGL 4.3
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        supported = major > 4 || (major == 4 && minor >= 3);
+    }
+
+    void traj_culling::reset()
+    {
+        initial = true;
+    }
+
+    void traj_culling::set_trajectories(std::vector<Cull_Trajectory>& _trajectories, const std::vector<vec3>& positions)
+    {
+        trajectories = _trajectories;
+        classes.assign(trajectories.size(), 0);
+
+        build_cull_chunks(trajectories, positions, chunks);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_trajectories);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, trajectories.size() * sizeof(Cull_Trajectory), trajectories.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_chunks);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, chunks.size() * sizeof(Cull_Chunk), chunks.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_classes);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, classes.size() * sizeof(unsigned int), classes.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        // written by the compute shader only
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, DIBO);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, chunks.size() * sizeof(Draw_Command), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        initial = false;
+    }
+
+    void traj_culling::update_length_classes(std::vector<unsigned short>& length_classes)
+    {
+        // glsl has no 16 bit integers in buffers
+        classes.assign(length_classes.begin(), length_classes.end());
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_classes);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, classes.size() * sizeof(unsigned int), classes.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    void traj_culling::cull(context& ctx, const Cull_Settings& settings)
+    {
+        // Account for CGV shaderpath not being set until after ::init
+        glGetError();
+        if (!prog.is_linked()) {
+            if (!prog.build_program(ctx, "traj_culling_shader.glpr", true)) {
+                std::cerr << "ERROR in traj_culling::cull() ... could not build program traj_culling_shader.glpr" << std::endl;
+                return;
+            }
+        }
+
+        // counters are increased by the shader
+        const unsigned int zero[3] = { 0, 0, 0 };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_counts);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        if (chunks.empty())
+            return;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO_trajectories);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, SSBO_chunks);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_classes);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, DIBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_counts);
+
+        // enable shader and set all uniform shader variables
+        prog.enable(ctx);
+        prog.set_uniform(ctx, "nr_chunks", (int)chunks.size());
+        prog.set_uniform(ctx, "start_time", settings.start_time);
+        prog.set_uniform(ctx, "end_time", settings.end_time);
+        prog.set_uniform(ctx, "rejected_classes", (int)settings.rejected_classes);
+        prog.set_uniform(ctx, "roi_active", settings.roi_active);
+        prog.set_uniform(ctx, "roi_min", settings.roi.min);
+        prog.set_uniform(ctx, "roi_max", settings.roi.max);
+        prog.set_uniform(ctx, "single_traj", settings.single_traj);
+        prog.set_uniform(ctx, "frustum_culling", settings.frustum_culling);
+        for (int i = 0; i < 6; i++)
+            prog.set_uniform(ctx, "planes[" + std::to_string(i) + "]", settings.planes[i]);
+
+        glDispatchCompute((GLuint)((chunks.size() + cull_group_size - 1) / cull_group_size), 1, 1);
+
+        prog.disable(ctx);
+        for (GLuint binding = 0; binding < 5; binding++)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+
+        // commands are read by the following draw calls, counters by read_counts
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    void traj_culling::read_counts(unsigned int& visible, unsigned int& drawn_chunks, unsigned int& culled_chunks)
+    {
+        unsigned int counts[3] = { 0, 0, 0 };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_counts);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), counts);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        visible = counts[0];
+        drawn_chunks = counts[1];
+        culled_chunks = counts[2];
+    }
+
+    size_t traj_culling::verify(const Cull_Settings& settings)
+    {
+        std::vector<Draw_Command> gpu_commands(chunks.size());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, DIBO);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, gpu_commands.size() * sizeof(Draw_Command), gpu_commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        std::vector<Draw_Command> commands;
+        cull_trajectories(trajectories, chunks, classes, settings, commands);
+
+        size_t differences = 0;
+        for (size_t p = 0; p < commands.size(); p++) {
+            if (commands[p].count != gpu_commands[p].count || commands[p].instance_count != gpu_commands[p].instance_count
+                    || commands[p].first != gpu_commands[p].first || commands[p].base_instance != gpu_commands[p].base_instance)
+                differences++;
+        }
+        return differences;
+    }
+
+    // same test as in traj_culling_shader.glcs: the corner of the box farthest along the normal
+    // of a plane decides if the box lies completely on its negative side
+    static bool inside_frustum(const Cull_Chunk& chunk, const vec4 planes[6])
+    {
+        for (int i = 0; i < 6; i++) {
+            const vec4& plane = planes[i];
+            float x = plane[0] >= 0.0f ? chunk.box_max[0] : chunk.box_min[0];
+            float y = plane[1] >= 0.0f ? chunk.box_max[1] : chunk.box_min[1];
+            float z = plane[2] >= 0.0f ? chunk.box_max[2] : chunk.box_min[2];
+            if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    unsigned int cull_trajectories(const std::vector<Cull_Trajectory>& trajectories, const std::vector<Cull_Chunk>& chunks,
+                                   const std::vector<unsigned int>& length_classes, const Cull_Settings& settings,
+                                   std::vector<Draw_Command>& commands)
+    {
+        const Bounding_Box& roi = settings.roi;
+        unsigned int visible_count = 0;
+        commands.resize(chunks.size());
+
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const Cull_Chunk& chunk = chunks[c];
+            const Cull_Trajectory& traj = trajectories[chunk.traj];
+            Draw_Command& command = commands[c];
+            command.count = 0;
+            command.instance_count = 0;
+            command.first = 0;
+            command.base_instance = 0;
+
+            // filters of the whole trajectory
+            if (settings.single_traj >= 0 && chunk.traj != (unsigned int)settings.single_traj)
+                continue;
+            if (length_classes[chunk.traj] & settings.rejected_classes)
+                continue;
+            if (settings.roi_active && !(traj.box_min[0] <= roi.max[0] && traj.box_max[0] >= roi.min[0] &&
+                                         traj.box_min[1] <= roi.max[1] && traj.box_max[1] >= roi.min[1] &&
+                                         traj.box_min[2] <= roi.max[2] && traj.box_max[2] >= roi.min[2]))
+                continue;
+
+            // clip time window to time steps of trajectory (see plugin::compute_window_traj_indices)
+            int traj_start = (int)traj.start_time;
+            int start_offset = std::max(settings.start_time - 1, traj_start) - traj_start;
+            int end_offset = std::min(settings.end_time, traj_start + (int)traj.length) - traj_start;
+            if (start_offset >= end_offset)
+                continue;
+
+            // first chunk counts the trajectory
+            if (chunk.begin == 0)
+                visible_count++;
+
+            // segments starting at samples of chunk inside of the window, the last one ends at the next chunk
+            int first = std::max((int)chunk.begin, start_offset);
+            int last = std::min((int)chunk.end, end_offset - 1);
+            if (first >= last)
+                continue;
+
+            if (settings.frustum_culling && !inside_frustum(chunk, settings.planes))
+                continue;
+
+            command.count = (unsigned int)(last - first + 1);
+            command.instance_count = 1;
+            command.first = traj.first + (unsigned int)first;
+        }
+
+        return visible_count;
+    }
+
+    void build_cull_chunks(const std::vector<Cull_Trajectory>& trajectories, const std::vector<vec3>& positions,
+                           std::vector<Cull_Chunk>& chunks)
+    {
+        // chunks of all trajectories one after another
+        std::vector<size_t> chunk_offsets(trajectories.size() + 1, 0);
+        for (size_t p = 0; p < trajectories.size(); p++)
+            chunk_offsets[p + 1] = chunk_offsets[p] + (trajectories[p].length + traj_culling::chunk_size - 1) / traj_culling::chunk_size;
+        chunks.resize(chunk_offsets.back());
+
+        parallel_for(0, trajectories.size(), default_thread_count(), [&](size_t p) {
+            const Cull_Trajectory& traj = trajectories[p];
+            for (size_t c = chunk_offsets[p]; c < chunk_offsets[p + 1]; c++) {
+                Cull_Chunk& chunk = chunks[c];
+                chunk.traj = (unsigned int)p;
+                chunk.begin = (unsigned int)((c - chunk_offsets[p]) * traj_culling::chunk_size);
+                chunk.end = std::min(chunk.begin + (unsigned int)traj_culling::chunk_size, traj.length);
+                chunk.padding = 0;
+
+                // segment to first sample of next chunk is drawn by this chunk
+                chunk.box_min = vec4(std::numeric_limits<float>::max());
+                chunk.box_max = vec4(-std::numeric_limits<float>::max());
+                for (unsigned int i = chunk.begin; i < std::min(chunk.end + 1, traj.length); i++) {
+                    const vec3& position = positions[traj.first + i];
+                    for (int j = 0; j < 3; j++) {
+                        chunk.box_min[j] = std::min(chunk.box_min[j], position[j]);
+                        chunk.box_max[j] = std::max(chunk.box_max[j], position[j]);
+                    }
+                }
+            }
+        });
+    }
+
+    void frustum_planes(const cgv::math::fmat<double, 4, 4>& mvp, vec4 planes[6])
+    {
+        // rows of the matrix combined as described by Gribb and Hartmann
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                planes[2 * i][j] = (float)(mvp(3, j) + mvp(i, j));
+                planes[2 * i + 1][j] = (float)(mvp(3, j) - mvp(i, j));
+            }
+        }
+    }
+}
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <cgv_gl/gl/gl.h>
 #include <cgv_gl/gl/gl_tools.h>
 
@@ -13,6 +15,13 @@ namespace ellipsoid_trajectory {
     {
         initial = true;
         nr_elements = 0;
+        nr_commands = 0;
+        draw_commands = false;
+        colormap_active = false;
+        colormap_texture = 0;
+        multi_draw_supported = false;
+        time_window_start = 0.0f;
+        time_window_end = std::numeric_limits<float>::max();
     }
 
     void traj_line_renderer::init(context& ctx)
@@ -30,9 +39,21 @@ namespace ellipsoid_trajectory {
         glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
         glGenBuffers(1, &VBO_colors);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_colors);
+        glGenBuffers(1, &VBO_time_indices);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
         glGenBuffers(1, &EBO);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBindVertexArray(0);
+
+        // buffer of draw commands is not part of the VAO state
+        glGenBuffers(1, &DIBO);
+        command_buffer = DIBO;
+
+        // glMultiDrawArraysIndirect is core since OpenGL 4.3
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        multi_draw_supported = major > 4 || (major == 4 && minor >= 3);
     }
 
     void traj_line_renderer::reset()
@@ -42,6 +63,8 @@ namespace ellipsoid_trajectory {
 
         // internal values
         nr_elements = 0;
+        nr_commands = 0;
+        draw_commands = false;
     }
 
     void traj_line_renderer::set_buffers(context& ctx, std::vector<vec3>& positions, std::vector<vec4>& colors, std::vector<unsigned int>& indices)
@@ -77,9 +100,54 @@ namespace ellipsoid_trajectory {
 
         // bind element buffer object
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
+
+        nr_elements = indices.size();
+        draw_commands = false;
+        colormap_active = false;
+
+        // unbind VAO
+        glBindVertexArray(0);
+    }
+
+    void traj_line_renderer::set_buffers(context& ctx, std::vector<vec3>& positions, std::vector<unsigned short>& time_indices, std::vector<unsigned int>& indices)
+    {
+        // Account for CGV shaderpath not being set until after ::init (This might not be the optimal place to put this)
+        glGetError(); // <-- Take care of potentially orphaned previous errors to prevent false failure detection in CGV shader building code
+        if (!prog.is_linked()) {
+            if (!prog.build_program(ctx, "traj_line_shader.glpr", true)) {
+                std::cerr << "ERROR in traj_line_renderer::init() ... could not build program traj_line_shader.glpr" << std::endl;
+            }
+        }
+
+        // bind vertex attribute object
+        glBindVertexArray(VAO);
+
+        // bind vertex buffer object for positions
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * 3 * sizeof(float), (float*)positions[0], GL_STATIC_DRAW);
+
+        // position attribute
+        int loc = prog.get_attribute_location(ctx, "position");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for time indices (2 bytes per sample instead of a color)
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
+        glBufferData(GL_ARRAY_BUFFER, time_indices.size() * sizeof(unsigned short), time_indices.data(), GL_STATIC_DRAW);
+
+        // time index attribute
+        loc = prog.get_attribute_location(ctx, "time_index");
+        glVertexAttribIPointer(loc, 1, GL_UNSIGNED_SHORT, sizeof(unsigned short), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind element buffer object
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
 
         nr_elements = indices.size();
+        draw_commands = false;
+        colormap_active = true;
 
         // unbind VAO
         glBindVertexArray(0);
@@ -90,13 +158,47 @@ namespace ellipsoid_trajectory {
         glBindVertexArray(VAO);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
 
         nr_elements = indices.size();
+        draw_commands = false;
+
+        glBindVertexArray(0);
+    }
+
+    void traj_line_renderer::update_element_buffer_range(std::vector<unsigned int>& indices, size_t first, size_t count)
+    {
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(unsigned int), count * sizeof(unsigned int), &indices[first]);
 
         glBindVertexArray(0);
     }
 
+    void traj_line_renderer::update_command_buffer(std::vector<Draw_Command>& commands)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, DIBO);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(Draw_Command), commands.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        nr_commands = commands.size();
+        command_buffer = DIBO;
+        draw_commands = true;
+    }
+
+    void traj_line_renderer::use_command_buffer(unsigned int buffer, size_t count)
+    {
+        nr_commands = count;
+        command_buffer = buffer;
+        draw_commands = true;
+    }
+
+    void traj_line_renderer::use_colormap(unsigned int texture)
+    {
+        colormap_texture = texture;
+    }
+
     void traj_line_renderer::update_position_buffer(std::vector<vec3>& positions)
     {
         glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
@@ -110,12 +212,29 @@ namespace ellipsoid_trajectory {
 
         // enable shader and set all uniform shader variables
         prog.enable(ctx);
+        prog.set_uniform(ctx, "time_window_start", time_window_start);
+        prog.set_uniform(ctx, "time_window_end", time_window_end);
+        prog.set_uniform(ctx, "use_colormap", colormap_active);
+        if (colormap_active) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, colormap_texture);
+            prog.set_uniform(ctx, "time_colormap", 0);
+        }
 
         // draw call
         // glDrawElements(GL_LINES, nr_elements, GL_UNSIGNED_INT, 0);
-        glDrawElements(GL_LINE_STRIP, nr_elements, GL_UNSIGNED_INT, 0);
+        if (draw_commands) {
+            // one line strip per command, no restart index needed
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+            glMultiDrawArraysIndirect(GL_LINE_STRIP, 0, nr_commands, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            glDrawElements(GL_LINE_STRIP, nr_elements, GL_UNSIGNED_INT, 0);
+        }
 
         // disable everything again
+        if (colormap_active)
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
         glBindVertexArray(0);
         prog.disable(ctx);
     }
@@ -0,0 +1,105 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "traj_lod.h"
+#include "data.h"
+#include "parallel.h"
+
+namespace ellipsoid_trajectory {
+
+const unsigned char trajectory_lod::keep_always;
+const int trajectory_lod::exponent_offset;
+
+// range of samples whose inner samples are not yet tagged and error of the sample that split it
+struct lod_range
+{
+    size_t first;
+    size_t last;
+    float error;
+};
+
+// level of an error relative to the diagonal of a trajectory, monotonic in error
+static unsigned char error_level(float error, float diagonal)
+{
+    if (!(error > 0.0f) || !(diagonal > 0.0f))
+        return 0;
+
+    // floor(log2(error / diagonal)) is exponent - 1
+    int exponent;
+    std::frexp(error / diagonal, &exponent);
+    int level = exponent + trajectory_lod::exponent_offset;
+    return (unsigned char)std::min(std::max(level, 0), (int)trajectory_lod::keep_always - 1);
+}
+
+static float box_diagonal(const Bounding_Box& b_box)
+{
+    vec3 diagonal = b_box.max - b_box.min;
+    return diagonal.length();
+}
+
+// distance of position to segment [a, b]
+static float segment_distance(const vec3& position, const vec3& a, const vec3& b)
+{
+    vec3 direction = b - a;
+    float sqr_length = direction.sqr_length();
+    float t = sqr_length > 0.0f ? std::min(std::max(dot(position - a, direction) / sqr_length, 0.0f), 1.0f) : 0.0f;
+    return (position - (a + direction * t)).length();
+}
+
+void trajectory_lod::build(const std::vector<trajectory_data>& trajs, const std::vector<vec3>& positions, unsigned int threads)
+{
+    clear();
+    levels.resize(positions.size(), 0);
+
+    parallel_for(0, trajs.size(), threads, [&](size_t p) {
+        const trajectory_data& traj = trajs[p];
+        if (traj.length == 0)
+            return;
+
+        const vec3* samples = &positions[traj.offset];
+        unsigned char* sample_levels = &levels[traj.offset];
+        float diagonal = box_diagonal(traj.b_box);
+
+        sample_levels[0] = keep_always;
+        sample_levels[traj.length - 1] = keep_always;
+
+        // error of a sample is limited by the error of the sample that split its range before,
+        // thus the samples of each level form the simplification of Douglas-Peucker for that level
+        std::vector<lod_range> stack;
+        stack.push_back({ 0, traj.length - 1, std::numeric_limits<float>::max() });
+        while (!stack.empty()) {
+            lod_range range = stack.back();
+            stack.pop_back();
+            if (range.last - range.first < 2)
+                continue;
+
+            size_t split = range.first + 1;
+            float max_distance = -1.0f;
+            for (size_t i = range.first + 1; i < range.last; i++) {
+                float distance = segment_distance(samples[i], samples[range.first], samples[range.last]);
+                if (distance > max_distance) {
+                    max_distance = distance;
+                    split = i;
+                }
+            }
+
+            float error = std::min(max_distance, range.error);
+            sample_levels[split] = error_level(error, diagonal);
+            stack.push_back({ range.first, split, error });
+            stack.push_back({ split, range.last, error });
+        }
+    });
+}
+
+void trajectory_lod::clear()
+{
+    levels.clear();
+}
+
+unsigned char trajectory_lod::level(const Bounding_Box& b_box, float error)
+{
+    return error_level(error, box_diagonal(b_box));
+}
+
+}
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <cgv_gl/gl/gl.h>
 #include <cgv_gl/gl/gl_tools.h>
 
@@ -15,6 +17,10 @@ namespace ellipsoid_trajectory {
         initial = true;
         nr_elements = 0;
         current_index = 0;
+        colormap_texture = 0;
+        colormap_active = false;
+        time_window_start = 0.0f;
+        time_window_end = std::numeric_limits<float>::max();
     }
 
     void traj_ribbon_3d_renderer::init(context& ctx, lighting* _scene_light, Material _material, int _tick_sample_count)
@@ -36,6 +42,8 @@ namespace ellipsoid_trajectory {
         glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
         glGenBuffers(1, &VBO_colors);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_colors);
+        glGenBuffers(1, &VBO_time_indices);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
         glGenBuffers(1, &VBO_normals);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
         glGenBuffers(1, &EBO);
@@ -52,18 +60,12 @@ namespace ellipsoid_trajectory {
         current_index = 0;
         nr_elements = 0;
 
-        indices_top.resize(0);
-        indices_side1.resize(0);
-        indices_bottom.resize(0);
-        indices_side2.resize(0);
+        first_vertex.resize(0);
     }
 
-    void traj_ribbon_3d_renderer::reserve_memory(size_t trajs, size_t time_steps)
+    void traj_ribbon_3d_renderer::reserve_memory(size_t trajs)
     {
-        indices_top.reserve(trajs * time_steps * 2);
-        indices_side1.reserve(trajs * time_steps * 2);
-        indices_bottom.reserve(trajs * time_steps * 2);
-        indices_side2.reserve(trajs * time_steps * 2);
+        first_vertex.reserve(trajs);
     }
 
     void traj_ribbon_3d_renderer::set_buffers(context& ctx, std::vector<vec3>& positions, std::vector<vec4>& colors, std::vector<vec3>& normals, std::vector<unsigned int>& indices)
@@ -108,6 +110,55 @@ namespace ellipsoid_trajectory {
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
 
         nr_elements = indices.size();
+        colormap_active = false;
+
+        // unbind VAO
+        glBindVertexArray(0);
+    }
+
+    void traj_ribbon_3d_renderer::set_buffers(context& ctx, std::vector<vec3>& positions, std::vector<unsigned short>& time_indices, std::vector<vec3>& normals, std::vector<unsigned int>& indices)
+    {
+        // Account for CGV shaderpath not being set until after ::init (This might not be the optimal place to put this)
+        glGetError(); // <-- Take care of potentially orphaned previous errors to prevent false failure detection in CGV shader building code
+        if (!prog.is_linked()) {
+            if (!prog.build_program(ctx, "traj_ribbon_3d_shader.glpr", true)) {
+                std::cerr << "ERROR in traj_ribbon_3d_renderer::init() ... could not build program traj_ribbon_3d_shader.glpr" << std::endl;
+            }
+        }
+
+        // bind vertex attribute object
+        glBindVertexArray(VAO);
+
+        // bind vertex buffer object for positions
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * 3 * sizeof(float), (float*)positions[0], GL_STATIC_DRAW);
+
+        int loc = prog.get_attribute_location(ctx, "position");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for time indices
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
+        glBufferData(GL_ARRAY_BUFFER, time_indices.size() * sizeof(unsigned short), time_indices.data(), GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "time_index");
+        glVertexAttribIPointer(loc, 1, GL_UNSIGNED_SHORT, sizeof(unsigned short), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for normals
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+        glBufferData(GL_ARRAY_BUFFER, normals.size() * 3 * sizeof(float), (float*)normals[0], GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "normal");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind element buffer object
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+
+        nr_elements = indices.size();
+        colormap_active = true;
 
         // unbind VAO
         glBindVertexArray(0);
@@ -125,11 +176,26 @@ namespace ellipsoid_trajectory {
         glBindVertexArray(0);
     }
 
+    void traj_ribbon_3d_renderer::update_element_buffer_range(std::vector<unsigned int>& indices, size_t first, size_t count)
+    {
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(unsigned int), count * sizeof(unsigned int), &indices[first]);
+
+        glBindVertexArray(0);
+    }
+
     void traj_ribbon_3d_renderer::update_material(Material _material)
     {
         material = _material;
     }
 
+    void traj_ribbon_3d_renderer::use_colormap(unsigned int texture)
+    {
+        colormap_texture = texture;
+    }
+
     void traj_ribbon_3d_renderer::draw(context& ctx)
     {
         // enable VAO and shader with all its variables
@@ -139,6 +205,8 @@ namespace ellipsoid_trajectory {
         prog.enable(ctx);
 
         prog.set_uniform(ctx, "tick_sample_count", tick_sample_count);
+        prog.set_uniform(ctx, "time_window_start", time_window_start);
+        prog.set_uniform(ctx, "time_window_end", time_window_end);
 
         prog.set_uniform(ctx, "light.ambient", scene_light->light.ambient);
         prog.set_uniform(ctx, "light.diffuse", scene_light->light.diffuse);
@@ -151,28 +219,30 @@ namespace ellipsoid_trajectory {
         prog.set_uniform(ctx, "material.specular", material.specular);
         prog.set_uniform(ctx, "material.shininess", material.shininess);
 
+        prog.set_uniform(ctx, "use_colormap", colormap_active);
+        if (colormap_active) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, colormap_texture);
+            prog.set_uniform(ctx, "time_colormap", 0);
+        }
+
         // draw call
         glDrawElements(GL_TRIANGLE_STRIP, nr_elements, GL_UNSIGNED_INT, 0);
 
         // disable everything again
+        if (colormap_active)
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
         glBindVertexArray(0);
         prog.disable(ctx);
     }
 
-    void traj_ribbon_3d_renderer::create_vertices(std::vector<vec3>& vertices_out, std::vector<vec4>& colors_out, std::vector<vec3>& normals_out, std::vector<vec3>& positions_in, vec3 main_axis_in, std::vector<vec3>& normals_in, std::vector<vec4>& orientations_in, std::vector<vec4>&colors_in)
+    void traj_ribbon_3d_renderer::create_vertices(std::vector<vec3>& vertices_out, std::vector<vec3>& normals_out, const vec3* positions_in, size_t length, vec3 main_axis_in, const vec3* normals_in, const vec4* orientations_in)
     {
         // both axis directions
         vec3 axis_positive = main_axis_in;
         vec3 axis_negative = axis_positive * -1;
 
-        std::vector<unsigned int> _indices_top;
-        indices_top.reserve(positions_in.size() * 2);
-        std::vector<unsigned int> _indices_side1;
-        indices_side1.reserve(positions_in.size() * 2);
-        std::vector<unsigned int> _indices_bottom;
-        indices_bottom.reserve(positions_in.size() * 2);
-        std::vector<unsigned int> _indices_side2;
-        indices_side2.reserve(positions_in.size() * 2);
+        first_vertex.push_back(current_index);
 
         // form a mantle of a 3D ribbon:
         //        v1   next1
@@ -185,12 +255,7 @@ namespace ellipsoid_trajectory {
         // height of ribbon
         float height = 0.1f;
 
-        for (size_t t = 0; t < positions_in.size(); t++) {
-            // color for this tmestep
-            vec4 color;
-            // adding darker ticks at every 10. time step
-            color = colors_in[t];
-
+        for (size_t t = 0; t < length; t++) {
             // apply current orientation to axis
             vec3 axis1 = quat_rotate(axis_positive, orientations_in[t]);
             vec3 axis2 = quat_rotate(axis_negative, orientations_in[t]);
@@ -211,16 +276,9 @@ namespace ellipsoid_trajectory {
             vertices_out.push_back(v1);
             vertices_out.push_back(v2);
 
-            // store indices
-            _indices_top.push_back(current_index++);
-            _indices_top.push_back(current_index++);
-
             normals_out.push_back(normals_in[t]);
             normals_out.push_back(normals_in[t]);
 
-            colors_out.push_back(color);
-            colors_out.push_back(color);
-
 
             // side of ribbon
             //
@@ -228,16 +286,9 @@ namespace ellipsoid_trajectory {
             vertices_out.push_back(_v1);
             vertices_out.push_back(v1);
 
-            // store indices
-            _indices_side1.push_back(current_index++);
-            _indices_side1.push_back(current_index++);
-
             normals_out.push_back(normal_side);
             normals_out.push_back(normal_side);
 
-            colors_out.push_back(color);
-            colors_out.push_back(color);
-
 
             // bottom of ribbon
             //
@@ -245,16 +296,9 @@ namespace ellipsoid_trajectory {
             vertices_out.push_back(_v2);
             vertices_out.push_back(_v1);
 
-            // store indices
-            _indices_bottom.push_back(current_index++);
-            _indices_bottom.push_back(current_index++);
-
             normals_out.push_back(normals_in[t] * -1);
             normals_out.push_back(normals_in[t] * -1);
 
-            colors_out.push_back(color);
-            colors_out.push_back(color);
-
 
             // side 2 of ribbon
             //
@@ -262,20 +306,10 @@ namespace ellipsoid_trajectory {
             vertices_out.push_back(v2);
             vertices_out.push_back(_v2);
 
-            // store indices
-            _indices_side2.push_back(current_index++);
-            _indices_side2.push_back(current_index++);
-
             normals_out.push_back(normal_side * -1);
             normals_out.push_back(normal_side * -1);
 
-            colors_out.push_back(color);
-            colors_out.push_back(color);
+            current_index += 8;
         }
-
-        indices_top.push_back(_indices_top);
-        indices_side1.push_back(_indices_side1);
-        indices_bottom.push_back(_indices_bottom);
-        indices_side2.push_back(_indices_side2);
     }
 }
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <cgv_gl/gl/gl.h>
 #include <cgv_gl/gl/gl_tools.h>
 
@@ -13,7 +15,14 @@ namespace ellipsoid_trajectory {
     {
         initial = true;
         nr_elements = 0;
+        nr_commands = 0;
+        draw_commands = false;
+        colormap_texture = 0;
+        colormap_active = false;
+        multi_draw_supported = false;
         height = 0.1;
+        time_window_start = 0.0f;
+        time_window_end = std::numeric_limits<float>::max();
     }
 
     void traj_ribbon_3d_renderer_gpu::init(context& ctx, lighting* _scene_light, Material _material, int _tick_sample_count)
@@ -35,6 +44,8 @@ namespace ellipsoid_trajectory {
         glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
         glGenBuffers(1, &VBO_colors);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_colors);
+        glGenBuffers(1, &VBO_time_indices);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
         glGenBuffers(1, &VBO_axes);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_axes);
         glGenBuffers(1, &VBO_orientations);
@@ -44,6 +55,16 @@ namespace ellipsoid_trajectory {
         glGenBuffers(1, &EBO);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBindVertexArray(0);
+
+        // buffer of draw commands is not part of the VAO state
+        glGenBuffers(1, &DIBO);
+        command_buffer = DIBO;
+
+        // glMultiDrawArraysIndirect is core since OpenGL 4.3
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        multi_draw_supported = major > 4 || (major == 4 && minor >= 3);
     }
 
     void traj_ribbon_3d_renderer_gpu::reset()
@@ -53,6 +74,8 @@ namespace ellipsoid_trajectory {
 
         // internal values
         nr_elements = 0;
+        nr_commands = 0;
+        draw_commands = false;
     }
 
     void traj_ribbon_3d_renderer_gpu::set_buffers(context& ctx, std::vector<vec3>& positions, std::vector<vec4>& colors, std::vector<vec3>& axes, std::vector<vec4>& orientations, std::vector<vec3>& normals, std::vector<unsigned int>& indices)
@@ -110,9 +133,76 @@ namespace ellipsoid_trajectory {
 
         // bind element buffer object
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
+
+        nr_elements = indices.size();
+        colormap_active = false;
+        draw_commands = false;
+
+        // unbind VAO
+        glBindVertexArray(0);
+    }
+
+    void traj_ribbon_3d_renderer_gpu::set_buffers(context& ctx, std::vector<vec3>& positions, std::vector<unsigned short>& time_indices, std::vector<vec3>& axes, std::vector<vec4>& orientations, std::vector<vec3>& normals, std::vector<unsigned int>& indices)
+    {
+        // Account for CGV shaderpath not being set until after ::init (This might not be the optimal place to put this)
+        glGetError(); // <-- Take care of potentially orphaned previous errors to prevent false failure detection in CGV shader building code
+        if (!prog.is_linked()) {
+            if (!prog.build_program(ctx, "traj_ribbon_3d_gpu_shader.glpr", true)) {
+                std::cerr << "ERROR in traj_ribbon_3d_renderer_gpu::init() ... could not build program traj_ribbon_3d_gpu_shader.glpr" << std::endl;
+            }
+        }
+
+        // bind vertex attribute object
+        glBindVertexArray(VAO);
+
+        // bind vertex buffer object for positions
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * 3 * sizeof(float), (float*)positions[0], GL_STATIC_DRAW);
+
+        int loc = prog.get_attribute_location(ctx, "position");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for time indices
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
+        glBufferData(GL_ARRAY_BUFFER, time_indices.size() * sizeof(unsigned short), time_indices.data(), GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "time_index");
+        glVertexAttribIPointer(loc, 1, GL_UNSIGNED_SHORT, sizeof(unsigned short), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for axes
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_axes);
+        glBufferData(GL_ARRAY_BUFFER, axes.size() * 3 * sizeof(float), (float*)axes[0], GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "main_axis");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for orientations
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_orientations);
+        glBufferData(GL_ARRAY_BUFFER, orientations.size() * 4 * sizeof(float), (float*)orientations[0], GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "orientation");
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for normals
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+        glBufferData(GL_ARRAY_BUFFER, normals.size() * 3 * sizeof(float), (float*)normals[0], GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "normal");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind element buffer object
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
 
         nr_elements = indices.size();
+        colormap_active = true;
+        draw_commands = false;
 
         // unbind VAO
         glBindVertexArray(0);
@@ -123,13 +213,47 @@ namespace ellipsoid_trajectory {
         glBindVertexArray(VAO);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_DYNAMIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_DYNAMIC_DRAW);
 
         nr_elements = indices.size();
+        draw_commands = false;
+
+        glBindVertexArray(0);
+    }
+
+    void traj_ribbon_3d_renderer_gpu::update_element_buffer_range(std::vector<unsigned int>& indices, size_t first, size_t count)
+    {
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(unsigned int), count * sizeof(unsigned int), &indices[first]);
 
         glBindVertexArray(0);
     }
 
+    void traj_ribbon_3d_renderer_gpu::update_command_buffer(std::vector<Draw_Command>& commands)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, DIBO);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(Draw_Command), commands.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        nr_commands = commands.size();
+        command_buffer = DIBO;
+        draw_commands = true;
+    }
+
+    void traj_ribbon_3d_renderer_gpu::use_command_buffer(unsigned int buffer, size_t count)
+    {
+        nr_commands = count;
+        command_buffer = buffer;
+        draw_commands = true;
+    }
+
+    void traj_ribbon_3d_renderer_gpu::use_colormap(unsigned int texture)
+    {
+        colormap_texture = texture;
+    }
+
     void traj_ribbon_3d_renderer_gpu::update_material(Material _material)
     {
         material = _material;
@@ -145,6 +269,8 @@ namespace ellipsoid_trajectory {
 
         prog.set_uniform(ctx, "tick_sample_count", tick_sample_count);
         prog.set_uniform(ctx, "height", height);
+        prog.set_uniform(ctx, "time_window_start", time_window_start);
+        prog.set_uniform(ctx, "time_window_end", time_window_end);
 
         prog.set_uniform(ctx, "light.ambient", scene_light->light.ambient);
         prog.set_uniform(ctx, "light.diffuse", scene_light->light.diffuse);
@@ -157,10 +283,26 @@ namespace ellipsoid_trajectory {
         prog.set_uniform(ctx, "material.specular", material.specular);
         prog.set_uniform(ctx, "material.shininess", material.shininess);
 
+        prog.set_uniform(ctx, "use_colormap", colormap_active);
+        if (colormap_active) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, colormap_texture);
+            prog.set_uniform(ctx, "time_colormap", 0);
+        }
+
         // draw call
-        glDrawElements(GL_LINES, nr_elements, GL_UNSIGNED_INT, 0);
+        if (draw_commands) {
+            // a line strip per command yields the same segments of neighbouring samples for the geometry shader
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+            glMultiDrawArraysIndirect(GL_LINE_STRIP, 0, nr_commands, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            glDrawElements(GL_LINES, nr_elements, GL_UNSIGNED_INT, 0);
+        }
 
         // disable everything again
+        if (colormap_active)
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
         glBindVertexArray(0);
         prog.disable(ctx);
     }
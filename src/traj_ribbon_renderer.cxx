@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <cgv_gl/gl/gl.h>
 #include <cgv_gl/gl/gl_tools.h>
 
@@ -16,6 +18,10 @@ namespace ellipsoid_trajectory {
         initial = true;
         nr_elements = 0;
         current_index = 0;
+        colormap_texture = 0;
+        colormap_active = false;
+        time_window_start = 0.0f;
+        time_window_end = std::numeric_limits<float>::max();
     }
 
     void traj_ribbon_renderer::init(context& ctx, lighting* _scene_light, int _tick_sample_count)
@@ -36,6 +42,8 @@ namespace ellipsoid_trajectory {
         glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
         glGenBuffers(1, &VBO_colors);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_colors);
+        glGenBuffers(1, &VBO_time_indices);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
         glGenBuffers(1, &EBO);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBindVertexArray(0);
@@ -50,7 +58,7 @@ namespace ellipsoid_trajectory {
         current_index = 0;
         nr_elements = 0;
 
-        indices.resize(0);
+        first_vertex.resize(0);
     }
 
     void traj_ribbon_renderer::set_buffers(context& ctx, std::vector<vec3>& vertices, std::vector<vec4>& colors, std::vector<unsigned int>& indices)
@@ -87,6 +95,47 @@ namespace ellipsoid_trajectory {
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
         nr_elements = indices.size();
+        colormap_active = false;
+
+        // unbind VAO
+        glBindVertexArray(0);
+    }
+
+    void traj_ribbon_renderer::set_buffers(context& ctx, std::vector<vec3>& vertices, std::vector<unsigned short>& time_indices, std::vector<unsigned int>& indices)
+    {
+        // Account for CGV shaderpath not being set until after ::init (This might not be the optimal place to put this)
+        glGetError(); // <-- Take care of potentially orphaned previous errors to prevent false failure detection in CGV shader building code
+        if (!prog.is_linked()) {
+            if (!prog.build_program(ctx, "traj_ribbon_shader.glpr", true)) {
+                std::cerr << "ERROR in traj_ribbon_renderer::init() ... could not build program traj_ribbon_shader.glpr" << std::endl;
+            }
+        }
+
+        // bind vertex attribute object
+        glBindVertexArray(VAO);
+
+        // bind vertex buffer object for positions
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * 3 * sizeof(float), (float*)vertices[0], GL_STATIC_DRAW);
+
+        int loc = prog.get_attribute_location(ctx, "position");
+        glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind vertex buffer object for time indices
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_time_indices);
+        glBufferData(GL_ARRAY_BUFFER, time_indices.size() * sizeof(unsigned short), time_indices.data(), GL_STATIC_DRAW);
+
+        loc = prog.get_attribute_location(ctx, "time_index");
+        glVertexAttribIPointer(loc, 1, GL_UNSIGNED_SHORT, sizeof(unsigned short), (void*)0);
+        glEnableVertexAttribArray(loc);
+
+        // bind element buffer object
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+        nr_elements = indices.size();
+        colormap_active = true;
 
         // unbind VAO
         glBindVertexArray(0);
@@ -104,6 +153,21 @@ namespace ellipsoid_trajectory {
         glBindVertexArray(0);
     }
 
+    void traj_ribbon_renderer::update_element_buffer_range(std::vector<unsigned int>& indices, size_t first, size_t count)
+    {
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(unsigned int), count * sizeof(unsigned int), &indices[first]);
+
+        glBindVertexArray(0);
+    }
+
+    void traj_ribbon_renderer::use_colormap(unsigned int texture)
+    {
+        colormap_texture = texture;
+    }
+
     void traj_ribbon_renderer::draw(context& ctx)
     {
         // enable VAO and shader with all its variables
@@ -114,18 +178,29 @@ namespace ellipsoid_trajectory {
         // enable shader and set all uniform shader variables
         prog.enable(ctx);
         prog.set_uniform(ctx, "tick_sample_count", tick_sample_count);
+        prog.set_uniform(ctx, "time_window_start", time_window_start);
+        prog.set_uniform(ctx, "time_window_end", time_window_end);
+
+        prog.set_uniform(ctx, "use_colormap", colormap_active);
+        if (colormap_active) {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, colormap_texture);
+            prog.set_uniform(ctx, "time_colormap", 0);
+        }
 
         // draw call
         glDrawElements(GL_TRIANGLE_STRIP, nr_elements, GL_UNSIGNED_INT, 0);
 
         // disable everything again
+        if (colormap_active)
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
         glBindVertexArray(0);
         prog.disable(ctx);
 
         glEnable(GL_CULL_FACE);
     }
 
-    void traj_ribbon_renderer::create_vertices(std::vector<vec3>& vertices_out, std::vector<vec4>& colors_out, std::vector<vec3>& positions_in, vec3 axes_in, std::vector<vec4>& orientations_in, std::vector<vec4>&colors_in)
+    void traj_ribbon_renderer::create_vertices(std::vector<vec3>& vertices_out, const vec3* positions_in, size_t length, vec3 axes_in, const vec4* orientations_in)
     {
         // find largest axis
         float axis_max = 0.0f;
@@ -147,9 +222,9 @@ namespace ellipsoid_trajectory {
         vec3 axis_positive = main_axis;
         vec3 axis_negative = axis_positive * -1;
 
-        std::vector<unsigned int> _indices;
+        first_vertex.push_back(current_index);
 
-        for (size_t t = 0; t < positions_in.size(); t++) {
+        for (size_t t = 0; t < length; t++) {
             // apply current orientation
             vec3 v1 = quat_rotate(axis_positive, orientations_in[t]);
             vec3 v2 = quat_rotate(axis_negative, orientations_in[t]);
@@ -158,17 +233,7 @@ namespace ellipsoid_trajectory {
             vertices_out.push_back(v1 + positions_in[t]);
             vertices_out.push_back(v2 + positions_in[t]);
 
-            // store indices
-            _indices.push_back(current_index);
-            current_index++;
-            _indices.push_back(current_index);
-            current_index++;
-
-            colors_out.push_back(colors_in[t]);
-            colors_out.push_back(colors_in[t]);
-
+            current_index += 2;
         }
-
-        indices.push_back(_indices);
     }
 }
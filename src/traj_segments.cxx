@@ -0,0 +1,178 @@
+#include <limits>
+#include <algorithm>
+
+#include "traj_segments.h"
+#include "data.h"
+#include "parallel.h"
+
+namespace ellipsoid_trajectory {
+
+const size_t trajectory_segments::chunk_size;
+
+// number of leaves of the tree of a trajectory with the given number of samples
+static size_t number_leaves(size_t length)
+{
+    size_t chunks = (length + trajectory_segments::chunk_size - 1) / trajectory_segments::chunk_size;
+    size_t leaves = 1;
+    while (leaves < chunks)
+        leaves *= 2;
+    return leaves;
+}
+
+static void reset_segment(segment_box& box)
+{
+    box.min = vec3(std::numeric_limits<float>::max());
+    box.max = vec3(-std::numeric_limits<float>::max());
+}
+
+static void extend_segment(segment_box& box, const vec3& position)
+{
+    for (int i = 0; i < 3; i++) {
+        box.min[i] = std::min(box.min[i], position[i]);
+        box.max[i] = std::max(box.max[i], position[i]);
+    }
+}
+
+static void merge_segment(segment_box& box, const segment_box& other)
+{
+    for (int i = 0; i < 3; i++) {
+        box.min[i] = std::min(box.min[i], other.min[i]);
+        box.max[i] = std::max(box.max[i], other.max[i]);
+    }
+}
+
+// empty boxes (min > max) never intersect
+static bool segment_intersects(const segment_box& segment, const Bounding_Box& box)
+{
+    return segment.min[0] <= box.max[0] && segment.max[0] >= box.min[0] &&
+           segment.min[1] <= box.max[1] && segment.max[1] >= box.min[1] &&
+           segment.min[2] <= box.max[2] && segment.max[2] >= box.min[2];
+}
+
+static bool segment_inside(const segment_box& segment, const Bounding_Box& box)
+{
+    return segment.min[0] >= box.min[0] && segment.max[0] <= box.max[0] &&
+           segment.min[1] >= box.min[1] && segment.max[1] <= box.max[1] &&
+           segment.min[2] >= box.min[2] && segment.max[2] <= box.max[2];
+}
+
+static bool position_inside(const vec3& position, const Bounding_Box& box)
+{
+    return position[0] >= box.min[0] && position[0] <= box.max[0] &&
+           position[1] >= box.min[1] && position[1] <= box.max[1] &&
+           position[2] >= box.min[2] && position[2] <= box.max[2];
+}
+
+void trajectory_segments::build(const std::vector<trajectory_data>& trajs, const std::vector<vec3>& positions, unsigned int threads)
+{
+    clear();
+
+    // tree of each trajectory is stored in heap order with root at index 1
+    tree_offsets.resize(trajs.size());
+    size_t number_nodes = 0;
+    for (size_t p = 0; p < trajs.size(); p++) {
+        tree_offsets[p] = number_nodes;
+        number_nodes += 2 * number_leaves(trajs[p].length);
+    }
+    nodes.resize(number_nodes);
+
+    parallel_for(0, trajs.size(), threads, [&](size_t p) {
+        const trajectory_data& traj = trajs[p];
+        segment_box* tree = &nodes[tree_offsets[p]];
+        size_t leaves = number_leaves(traj.length);
+
+        // leaves behind the last chunk stay empty
+        for (size_t leaf = 0; leaf < leaves; leaf++) {
+            segment_box& box = tree[leaves + leaf];
+            reset_segment(box);
+
+            size_t end = std::min((leaf + 1) * chunk_size, traj.length);
+            for (size_t i = leaf * chunk_size; i < end; i++)
+                extend_segment(box, positions[traj.offset + i]);
+        }
+
+        for (size_t node = leaves - 1; node > 0; node--) {
+            tree[node] = tree[2 * node];
+            merge_segment(tree[node], tree[2 * node + 1]);
+        }
+    });
+}
+
+void trajectory_segments::clear()
+{
+    nodes.clear();
+    tree_offsets.clear();
+}
+
+void trajectory_segments::extent_node(const segment_box* tree, size_t node, size_t begin, size_t end, const vec3* positions,
+                                      size_t first, size_t last, segment_box& result) const
+{
+    if (end <= first || begin >= last)
+        return;
+
+    // node covers samples [begin, end) completely inside of the range
+    if (begin >= first && end <= last) {
+        merge_segment(result, tree[node]);
+        return;
+    }
+
+    if (end - begin == chunk_size) {
+        for (size_t i = std::max(begin, first); i < std::min(end, last); i++)
+            extend_segment(result, positions[i]);
+        return;
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    extent_node(tree, 2 * node, begin, mid, positions, first, last, result);
+    extent_node(tree, 2 * node + 1, mid, end, positions, first, last, result);
+}
+
+bool trajectory_segments::intersects_node(const segment_box* tree, size_t node, size_t begin, size_t end, const vec3* positions,
+                                          size_t first, size_t last, const Bounding_Box& box) const
+{
+    if (end <= first || begin >= last || !segment_intersects(tree[node], box))
+        return false;
+
+    // every sample of node lies inside of the box
+    if (begin >= first && end <= last && segment_inside(tree[node], box))
+        return true;
+
+    if (end - begin == chunk_size) {
+        for (size_t i = std::max(begin, first); i < std::min(end, last); i++) {
+            if (position_inside(positions[i], box))
+                return true;
+        }
+        return false;
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    return intersects_node(tree, 2 * node, begin, mid, positions, first, last, box)
+        || intersects_node(tree, 2 * node + 1, mid, end, positions, first, last, box);
+}
+
+Bounding_Box trajectory_segments::extent(size_t p, size_t length, const vec3* positions, size_t first, size_t last) const
+{
+    segment_box result;
+    reset_segment(result);
+
+    last = std::min(last, length);
+    if (first < last)
+        extent_node(&nodes[tree_offsets[p]], 1, 0, number_leaves(length) * chunk_size, positions, first, last, result);
+
+    Bounding_Box b_box;
+    b_box.min = result.min;
+    b_box.max = result.max;
+    b_box.center = result.min + (result.max - result.min) / 2;
+    return b_box;
+}
+
+bool trajectory_segments::intersects(size_t p, size_t length, const vec3* positions, size_t first, size_t last, const Bounding_Box& box) const
+{
+    last = std::min(last, length);
+    if (first >= last)
+        return false;
+
+    return intersects_node(&nodes[tree_offsets[p]], 1, 0, number_leaves(length) * chunk_size, positions, first, last, box);
+}
+
+}
@@ -1,3 +1,5 @@
+#include <limits>
+
 #include <cgv_gl/gl/gl.h>
 #include <cgv_gl/gl/gl_tools.h>
 
@@ -18,6 +20,8 @@ namespace ellipsoid_trajectory {
 
         nr_vertices = 0;
         nr_instances = 0;
+        time_window_start = 0.0f;
+        time_window_end = std::numeric_limits<float>::max();
 
         initial = true;
     }
@@ -178,6 +182,8 @@ namespace ellipsoid_trajectory {
 
         // enable shader and set all uniform shader variables
         prog.enable(ctx);
+        prog.set_uniform(ctx, "time_window_start", time_window_start);
+        prog.set_uniform(ctx, "time_window_end", time_window_end);
 
         prog.set_uniform(ctx, "light.ambient", scene_light->light.ambient);
         prog.set_uniform(ctx, "light.diffuse", scene_light->light.diffuse);
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "index_buffers.h"
+#include "parallel.h"
+
+using namespace ellipsoid_trajectory;
+
+// counts the heap allocations of index updates done like plugin::compute_window_traj_indices
+// (count, prefix sum and scatter on a thread_pool into index_buffers), once the buffers are
+// large enough an update must not allocate
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+
+static const size_t block_size = 256;
+static const size_t number_ids = 3;
+
+// trajectory p has p % 50 samples, every third one is rejected
+static size_t traj_length(size_t p)
+{
+    return p % 3 == 0 ? 0 : p % 50;
+}
+
+// per block counts of indices and ellipsoids, their prefix sums are the offsets of each block
+struct Update_State
+{
+    std::vector<size_t> block_counts;
+};
+
+static void update(thread_pool& pool, index_buffers& buffers, Update_State& state, size_t nr_trajs)
+{
+    buffers.begin_update(number_ids);
+
+    size_t nr_blocks = (nr_trajs + block_size - 1) / block_size;
+    size_t nr_counts = 1 + number_ids;
+    state.block_counts.assign((nr_blocks + 1) * nr_counts, 0);
+
+    // 1. count
+    pool.run(0, nr_blocks, 0, [&](size_t block) {
+        size_t* counts = &state.block_counts[(block + 1) * nr_counts];
+        for (size_t p = block * block_size; p < std::min((block + 1) * block_size, nr_trajs); p++) {
+            size_t length = traj_length(p);
+            if (length > 1)
+                counts[0] += 2 * (length - 1);
+            counts[1 + p % number_ids] += length;
+        }
+    });
+
+    // 2. prefix sums and sizes
+    for (size_t block = 0; block < nr_blocks; block++)
+        for (size_t i = 0; i < nr_counts; i++)
+            state.block_counts[(block + 1) * nr_counts + i] += state.block_counts[block * nr_counts + i];
+    const size_t* totals = &state.block_counts[nr_blocks * nr_counts];
+    buffers.indices.resize(totals[0]);
+    for (size_t e = 0; e < number_ids; e++)
+        buffers.ellipsoid_positions[e].resize(totals[1 + e]);
+
+    // 3. scatter
+    pool.run(0, nr_blocks, 0, [&](size_t block) {
+        const size_t* offsets = &state.block_counts[block * nr_counts];
+        size_t index = offsets[0];
+        size_t ellipsoids[number_ids];
+        for (size_t e = 0; e < number_ids; e++)
+            ellipsoids[e] = offsets[1 + e];
+
+        for (size_t p = block * block_size; p < std::min((block + 1) * block_size, nr_trajs); p++) {
+            size_t length = traj_length(p);
+            for (size_t i = 0; i + 1 < length; i++) {
+                buffers.indices[index++] = (unsigned int)(p * 50 + i);
+                buffers.indices[index++] = (unsigned int)(p * 50 + i + 1);
+            }
+            for (size_t i = 0; i < length; i++)
+                buffers.ellipsoid_positions[p % number_ids][ellipsoids[p % number_ids]++] = vec3((float)p, (float)i, 0.0f);
+        }
+    });
+
+    buffers.end_update();
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::cerr << "FAILED " << what << std::endl;
+        failures++;
+    }
+}
+
+int main()
+{
+    thread_pool pool(4);
+    index_buffers buffers;
+    Update_State state;
+
+    size_t before = allocations;
+    update(pool, buffers, state, 10000);
+    size_t first = allocations - before;
+    check(first > 0 && buffers.last_grown > 0, "first update allocates its buffers");
+
+    // same and fewer trajectories fit into the buffers of the first update
+    before = allocations;
+    update(pool, buffers, state, 10000);
+    update(pool, buffers, state, 5000);
+    update(pool, buffers, state, 0);
+    update(pool, buffers, state, 10000);
+    size_t repeated = allocations - before;
+    check(repeated == 0, "updates that fit into the buffers allocate");
+    check(buffers.last_grown == 0, "buffers grow on updates that fit");
+
+    before = allocations;
+    update(pool, buffers, state, 20000);
+    check(allocations - before > 0 && buffers.last_grown > 0, "larger update grows the buffers");
+
+    std::cout << first << " allocations on first update, " << repeated << " on 4 repeated updates" << std::endl;
+    if (failures > 0)
+        return 1;
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
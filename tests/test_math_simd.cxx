@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "math_utils.h"
+
+using namespace ellipsoid_trajectory;
+
+// checks the batched quaternion functions of every supported instruction set against the scalar
+// ones with benchmark_quat_batch and the remainders of batches that do not fill a register
+
+static float difference(const vec4& a, const vec4& b)
+{
+    float error = 0.0f;
+    for (int j = 0; j < 4; j++)
+        error = std::max(error, std::fabs(a[j] - b[j]));
+    return error;
+}
+
+static float difference(const vec3& a, const vec3& b)
+{
+    float error = 0.0f;
+    for (int j = 0; j < 3; j++)
+        error = std::max(error, std::fabs(a[j] - b[j]));
+    return error;
+}
+
+int main()
+{
+    bool success = benchmark_quat_batch(1 << 16);
+    if (!success)
+        std::cerr << "FAILED batched quaternion functions exceed their error bounds" << std::endl;
+
+    // every count up to two registers of AVX2, elements behind the batch must stay untouched
+    for (size_t count = 0; count <= 17; count++) {
+        std::vector<vec4> qa(count + 1), qb(count + 1);
+        for (size_t i = 0; i <= count; i++) {
+            qa[i] = quat_normed(vec4(1.0f + (float)i, 0.5f, -0.25f * (float)i, 2.0f));
+            qb[i] = quat_normed(vec4(0.5f, 1.0f - (float)i, 0.75f, 0.1f * (float)i));
+        }
+        const vec4 marker(7.0f);
+        std::vector<vec4> out_mul(count + 1, marker);
+        std::vector<vec3> out_rotate(count + 1, vec3(7.0f));
+        quat_mul_batch(qa.data(), qb.data(), out_mul.data(), count);
+        quat_rotate_batch(vec3(1.0f, 2.0f, 3.0f), qa.data(), out_rotate.data(), count);
+
+        float error = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            error = std::max(error, difference(out_mul[i], quat_mul(qa[i], qb[i])));
+            error = std::max(error, difference(out_rotate[i], quat_rotate(vec3(1.0f, 2.0f, 3.0f), qa[i])));
+        }
+        if (error > 1e-5f || difference(out_mul[count], marker) != 0.0f || difference(out_rotate[count], vec3(7.0f)) != 0.0f) {
+            std::cerr << "FAILED batch of " << count << " quaternions" << std::endl;
+            success = false;
+        }
+    }
+
+    if (!success)
+        return 1;
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include <iostream>
+#include <vector>
+
+#include "traj_culling.h"
+
+using namespace ellipsoid_trajectory;
+
+// checks cull_trajectories (the reference of traj_culling_shader.glcs) on hand built trajectories:
+//   trajectory 0: samples 0..129 at x = i, starts at time step 0 (chunks [0, 64), [64, 128), [128, 130))
+//   trajectory 1: samples 0..9 at x = 100 + i, starts at time step 20
+//   trajectory 2: one sample at x = 200, starts at time step 5
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& test, const std::string& what)
+{
+    if (!condition) {
+        std::cerr << "FAILED " << test << ": " << what << std::endl;
+        failures++;
+    }
+}
+
+static void add_trajectory(std::vector<Cull_Trajectory>& trajs, std::vector<vec3>& positions,
+                           unsigned int length, unsigned int start_time, float x)
+{
+    Cull_Trajectory traj;
+    traj.first = (unsigned int)positions.size();
+    traj.length = length;
+    traj.start_time = start_time;
+    traj.padding = 0;
+    traj.box_min = vec4(x, 0.0f, 0.0f, 0.0f);
+    traj.box_max = vec4(x + (float)(length - 1), 0.0f, 0.0f, 0.0f);
+    trajs.push_back(traj);
+
+    for (unsigned int i = 0; i < length; i++)
+        positions.push_back(vec3(x + (float)i, 0.0f, 0.0f));
+}
+
+static Cull_Settings default_settings()
+{
+    Cull_Settings settings;
+    settings.start_time = 1;
+    settings.end_time = 200;
+    settings.rejected_classes = 0;
+    settings.roi_active = false;
+    settings.roi.min = vec3(0.0f);
+    settings.roi.max = vec3(0.0f);
+    settings.roi.center = vec3(0.0f);
+    settings.single_traj = -1;
+    settings.frustum_culling = false;
+    for (int i = 0; i < 6; i++)
+        settings.planes[i] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    return settings;
+}
+
+// expected command of each chunk, count 0 means the chunk is not drawn
+struct Expected
+{
+    unsigned int count;
+    unsigned int first;
+};
+
+static void expect(const std::string& test, const std::vector<Cull_Trajectory>& trajs, const std::vector<Cull_Chunk>& chunks,
+                   const std::vector<unsigned int>& classes, const Cull_Settings& settings,
+                   unsigned int visible, const std::vector<Expected>& expected)
+{
+    std::vector<Draw_Command> commands;
+    unsigned int result = cull_trajectories(trajs, chunks, classes, settings, commands);
+
+    check(result == visible, test, "visible trajectories " + std::to_string(result) + " instead of " + std::to_string(visible));
+    check(commands.size() == expected.size(), test, "number of commands");
+    for (size_t c = 0; c < commands.size() && c < expected.size(); c++) {
+        const Draw_Command& command = commands[c];
+        std::string chunk = "chunk " + std::to_string(c);
+        if (expected[c].count == 0) {
+            check(command.count == 0 && command.instance_count == 0, test, chunk + " is drawn");
+        } else {
+            check(command.instance_count == 1, test, chunk + " is not drawn");
+            check(command.count == expected[c].count, test, chunk + " count " + std::to_string(command.count) + " instead of " + std::to_string(expected[c].count));
+            check(command.first == expected[c].first, test, chunk + " first " + std::to_string(command.first) + " instead of " + std::to_string(expected[c].first));
+        }
+        check(command.base_instance == 0, test, chunk + " base instance");
+    }
+}
+
+int main()
+{
+    std::vector<Cull_Trajectory> trajs;
+    std::vector<vec3> positions;
+    add_trajectory(trajs, positions, 130, 0, 0.0f);
+    add_trajectory(trajs, positions, 10, 20, 100.0f);
+    add_trajectory(trajs, positions, 1, 5, 200.0f);
+    std::vector<unsigned int> classes(trajs.size(), 0);
+
+    // chunks include the first sample of the next chunk in their bounding box
+    std::vector<Cull_Chunk> chunks;
+    build_cull_chunks(trajs, positions, chunks);
+    check(chunks.size() == 5, "chunks", "number of chunks");
+    if (chunks.size() != 5)
+        return 1;
+    check(chunks[0].traj == 0 && chunks[0].begin == 0 && chunks[0].end == 64, "chunks", "range of chunk 0");
+    check(chunks[1].traj == 0 && chunks[1].begin == 64 && chunks[1].end == 128, "chunks", "range of chunk 1");
+    check(chunks[2].traj == 0 && chunks[2].begin == 128 && chunks[2].end == 130, "chunks", "range of chunk 2");
+    check(chunks[3].traj == 1 && chunks[3].begin == 0 && chunks[3].end == 10, "chunks", "range of chunk 3");
+    check(chunks[4].traj == 2 && chunks[4].begin == 0 && chunks[4].end == 1, "chunks", "range of chunk 4");
+    check(chunks[0].box_min[0] == 0.0f && chunks[0].box_max[0] == 64.0f, "chunks", "bounding box of chunk 0");
+    check(chunks[2].box_min[0] == 128.0f && chunks[2].box_max[0] == 129.0f, "chunks", "bounding box of chunk 2");
+
+    Cull_Settings settings = default_settings();
+
+    // whole time range, a trajectory with one sample is visible but has no segment
+    expect("whole time range", trajs, chunks, classes, settings, 3,
+           { { 65, 0 }, { 65, 64 }, { 2, 128 }, { 10, 130 }, { 0, 0 } });
+
+    // window of two time steps on the border of two chunks is drawn by the first chunk only
+    settings.start_time = 64;
+    settings.end_time = 65;
+    expect("window on chunk border", trajs, chunks, classes, settings, 1,
+           { { 2, 63 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+    // window of one time step has no segment but the trajectory is visible
+    settings.start_time = 65;
+    settings.end_time = 65;
+    expect("window of one time step", trajs, chunks, classes, settings, 1,
+           { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+    // window ends right before, at and after the first time step of trajectory 1
+    settings.start_time = 1;
+    settings.end_time = 20;
+    expect("window ends before start", trajs, chunks, classes, settings, 2,
+           { { 20, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+    settings.end_time = 21;
+    expect("window ends at start", trajs, chunks, classes, settings, 3,
+           { { 21, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+    settings.end_time = 22;
+    expect("window ends after start", trajs, chunks, classes, settings, 3,
+           { { 22, 0 }, { 0, 0 }, { 0, 0 }, { 2, 130 }, { 0, 0 } });
+
+    // window starts at and after the last time step of trajectory 1
+    settings.start_time = 30;
+    settings.end_time = 200;
+    expect("window starts at end", trajs, chunks, classes, settings, 2,
+           { { 36, 29 }, { 65, 64 }, { 2, 128 }, { 0, 0 }, { 0, 0 } });
+    settings.start_time = 31;
+    expect("window starts after end", trajs, chunks, classes, settings, 1,
+           { { 35, 30 }, { 65, 64 }, { 2, 128 }, { 0, 0 }, { 0, 0 } });
+
+    // window outside of all trajectories
+    settings.start_time = 150;
+    settings.end_time = 160;
+    expect("window outside", trajs, chunks, classes, settings, 0,
+           { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+    // roi tests the bounding box of the whole trajectory, touching boxes intersect
+    settings = default_settings();
+    settings.roi_active = true;
+    settings.roi.min = vec3(105.0f, -1.0f, -1.0f);
+    settings.roi.max = vec3(120.0f, 1.0f, 1.0f);
+    expect("roi", trajs, chunks, classes, settings, 2,
+           { { 65, 0 }, { 65, 64 }, { 2, 128 }, { 10, 130 }, { 0, 0 } });
+    settings.roi.min = vec3(129.0f, -1.0f, -1.0f);
+    settings.roi.max = vec3(140.0f, 1.0f, 1.0f);
+    expect("roi touching", trajs, chunks, classes, settings, 1,
+           { { 65, 0 }, { 65, 64 }, { 2, 128 }, { 0, 0 }, { 0, 0 } });
+    settings.roi.min = vec3(130.0f, 1.0f, -1.0f);
+    settings.roi.max = vec3(250.0f, 2.0f, 1.0f);
+    expect("roi outside", trajs, chunks, classes, settings, 0,
+           { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+    // length classes and single trajectory
+    settings = default_settings();
+    classes[1] = 2;
+    settings.rejected_classes = 2 | 4;
+    expect("length classes", trajs, chunks, classes, settings, 2,
+           { { 65, 0 }, { 65, 64 }, { 2, 128 }, { 0, 0 }, { 0, 0 } });
+    classes[1] = 0;
+    settings.rejected_classes = 0;
+    settings.single_traj = 1;
+    expect("single trajectory", trajs, chunks, classes, settings, 1,
+           { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 10, 130 }, { 0, 0 } });
+
+    // orthographic view of x in [0, 64], chunk 1 touches the right plane, chunks behind it are culled
+    settings = default_settings();
+    cgv::math::fmat<double, 4, 4> mvp;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            mvp(i, j) = i == j ? 1.0 : 0.0;
+    mvp(0, 0) = 1.0 / 32.0;
+    mvp(0, 3) = -1.0;
+    settings.frustum_culling = true;
+    frustum_planes(mvp, settings.planes);
+    expect("frustum", trajs, chunks, classes, settings, 3,
+           { { 65, 0 }, { 65, 64 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+    // culled chunks are not counted as visible trajectories and the time window is clipped before culling
+    settings.start_time = 100;
+    expect("frustum and window", trajs, chunks, classes, settings, 1,
+           { { 0, 0 }, { 30, 99 }, { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+    // no chunks at all
+    std::vector<Cull_Chunk> no_chunks;
+    expect("no chunks", trajs, no_chunks, classes, default_settings(), 0, {});
+
+    // empty trajectory has no chunk
+    std::vector<Cull_Trajectory> empty_trajs;
+    std::vector<vec3> empty_positions;
+    add_trajectory(empty_trajs, empty_positions, 0, 0, 0.0f);
+    build_cull_chunks(empty_trajs, empty_positions, no_chunks);
+    check(no_chunks.empty(), "empty trajectory", "has chunks");
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
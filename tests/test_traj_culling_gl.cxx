@@ -0,0 +1,373 @@
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/glcorearb.h>
+
+#include "traj_culling.h"
+
+using namespace ellipsoid_trajectory;
+
+// runs traj_culling_shader.glcs in a headless OpenGL 4.3 context (e.g. llvmpipe) and compares the
+// commands and counters it writes with cull_trajectories, the shader file is the only argument,
+// the test is skipped if no context can be created
+
+static const int skip_code = 77;
+
+// number of chunks handled by one work group (see traj_culling_shader.glcs)
+static const size_t cull_group_size = 256;
+
+// functions of OpenGL 4.3 loaded after the context is created
+static PFNGLGETSTRINGPROC glGetString_;
+static PFNGLGETERRORPROC glGetError_;
+static PFNGLCREATESHADERPROC glCreateShader_;
+static PFNGLSHADERSOURCEPROC glShaderSource_;
+static PFNGLCOMPILESHADERPROC glCompileShader_;
+static PFNGLGETSHADERIVPROC glGetShaderiv_;
+static PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog_;
+static PFNGLCREATEPROGRAMPROC glCreateProgram_;
+static PFNGLATTACHSHADERPROC glAttachShader_;
+static PFNGLLINKPROGRAMPROC glLinkProgram_;
+static PFNGLGETPROGRAMIVPROC glGetProgramiv_;
+static PFNGLGETPROGRAMINFOLOGPROC glGetProgramInfoLog_;
+static PFNGLUSEPROGRAMPROC glUseProgram_;
+static PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation_;
+static PFNGLUNIFORM1IPROC glUniform1i_;
+static PFNGLUNIFORM3FPROC glUniform3f_;
+static PFNGLUNIFORM4FPROC glUniform4f_;
+static PFNGLGENBUFFERSPROC glGenBuffers_;
+static PFNGLBINDBUFFERPROC glBindBuffer_;
+static PFNGLBUFFERDATAPROC glBufferData_;
+static PFNGLBUFFERSUBDATAPROC glBufferSubData_;
+static PFNGLBINDBUFFERBASEPROC glBindBufferBase_;
+static PFNGLGETBUFFERSUBDATAPROC glGetBufferSubData_;
+static PFNGLDISPATCHCOMPUTEPROC glDispatchCompute_;
+static PFNGLMEMORYBARRIERPROC glMemoryBarrier_;
+
+template<typename T>
+static bool load(T& function, const char* name)
+{
+    function = reinterpret_cast<T>(eglGetProcAddress(name));
+    if (function == nullptr)
+        std::cerr << "could not load " << name << std::endl;
+    return function != nullptr;
+}
+
+static bool load_functions()
+{
+    return load(glGetString_, "glGetString") && load(glGetError_, "glGetError")
+        && load(glCreateShader_, "glCreateShader") && load(glShaderSource_, "glShaderSource")
+        && load(glCompileShader_, "glCompileShader") && load(glGetShaderiv_, "glGetShaderiv")
+        && load(glGetShaderInfoLog_, "glGetShaderInfoLog") && load(glCreateProgram_, "glCreateProgram")
+        && load(glAttachShader_, "glAttachShader") && load(glLinkProgram_, "glLinkProgram")
+        && load(glGetProgramiv_, "glGetProgramiv") && load(glGetProgramInfoLog_, "glGetProgramInfoLog")
+        && load(glUseProgram_, "glUseProgram") && load(glGetUniformLocation_, "glGetUniformLocation")
+        && load(glUniform1i_, "glUniform1i") && load(glUniform3f_, "glUniform3f") && load(glUniform4f_, "glUniform4f")
+        && load(glGenBuffers_, "glGenBuffers") && load(glBindBuffer_, "glBindBuffer")
+        && load(glBufferData_, "glBufferData") && load(glBufferSubData_, "glBufferSubData")
+        && load(glBindBufferBase_, "glBindBufferBase") && load(glGetBufferSubData_, "glGetBufferSubData")
+        && load(glDispatchCompute_, "glDispatchCompute") && load(glMemoryBarrier_, "glMemoryBarrier");
+}
+
+// creates an OpenGL 4.3 core context without surface, returns false if not available
+static bool create_context()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display != nullptr)
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "no EGL display" << std::endl;
+        return false;
+    }
+
+    // surfaceless displays have no window configs
+    const EGLint config_attributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config;
+    EGLint nr_configs = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, config_attributes, &config, 1, &nr_configs) || nr_configs == 0) {
+        std::cerr << "no EGL config for OpenGL" << std::endl;
+        return false;
+    }
+
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "no OpenGL 4.3 context" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static GLuint build_program(const std::string& file_name)
+{
+    std::ifstream file(file_name);
+    if (!file) {
+        std::cerr << "could not read " << file_name << std::endl;
+        return 0;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string source = stream.str();
+    const char* code = source.c_str();
+
+    char log[4096];
+    GLint status = 0;
+    GLuint shader = glCreateShader_(GL_COMPUTE_SHADER);
+    glShaderSource_(shader, 1, &code, nullptr);
+    glCompileShader_(shader);
+    glGetShaderiv_(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        glGetShaderInfoLog_(shader, sizeof(log), nullptr, log);
+        std::cerr << "could not compile " << file_name << ":\n" << log << std::endl;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram_();
+    glAttachShader_(program, shader);
+    glLinkProgram_(program);
+    glGetProgramiv_(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        glGetProgramInfoLog_(program, sizeof(log), nullptr, log);
+        std::cerr << "could not link " << file_name << ":\n" << log << std::endl;
+        return 0;
+    }
+    return program;
+}
+
+static GLuint create_buffer(GLenum target, size_t size, const void* data)
+{
+    GLuint buffer = 0;
+    glGenBuffers_(1, &buffer);
+    glBindBuffer_(target, buffer);
+    glBufferData_(target, size, data, GL_DYNAMIC_COPY);
+    glBindBuffer_(target, 0);
+    return buffer;
+}
+
+// same steps as traj_culling::cull, counters are visible trajectories, drawn and culled chunks
+static void cull_on_gpu(GLuint program, const std::vector<Cull_Trajectory>& trajs, const std::vector<Cull_Chunk>& chunks,
+                        const std::vector<unsigned int>& classes, const Cull_Settings& settings,
+                        std::vector<Draw_Command>& commands, unsigned int counts[3])
+{
+    GLuint buffers[5] = {
+        create_buffer(GL_SHADER_STORAGE_BUFFER, trajs.size() * sizeof(Cull_Trajectory), trajs.data()),
+        create_buffer(GL_SHADER_STORAGE_BUFFER, chunks.size() * sizeof(Cull_Chunk), chunks.data()),
+        create_buffer(GL_SHADER_STORAGE_BUFFER, classes.size() * sizeof(unsigned int), classes.data()),
+        create_buffer(GL_SHADER_STORAGE_BUFFER, chunks.size() * sizeof(Draw_Command), nullptr),
+        create_buffer(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(unsigned int), nullptr)
+    };
+    const unsigned int zero[3] = { 0, 0, 0 };
+    glBindBuffer_(GL_SHADER_STORAGE_BUFFER, buffers[4]);
+    glBufferSubData_(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+    for (GLuint binding = 0; binding < 5; binding++)
+        glBindBufferBase_(GL_SHADER_STORAGE_BUFFER, binding, buffers[binding]);
+
+    glUseProgram_(program);
+    glUniform1i_(glGetUniformLocation_(program, "nr_chunks"), (GLint)chunks.size());
+    glUniform1i_(glGetUniformLocation_(program, "start_time"), settings.start_time);
+    glUniform1i_(glGetUniformLocation_(program, "end_time"), settings.end_time);
+    glUniform1i_(glGetUniformLocation_(program, "rejected_classes"), (GLint)settings.rejected_classes);
+    glUniform1i_(glGetUniformLocation_(program, "roi_active"), settings.roi_active);
+    glUniform3f_(glGetUniformLocation_(program, "roi_min"), settings.roi.min[0], settings.roi.min[1], settings.roi.min[2]);
+    glUniform3f_(glGetUniformLocation_(program, "roi_max"), settings.roi.max[0], settings.roi.max[1], settings.roi.max[2]);
+    glUniform1i_(glGetUniformLocation_(program, "single_traj"), settings.single_traj);
+    glUniform1i_(glGetUniformLocation_(program, "frustum_culling"), settings.frustum_culling);
+    for (int i = 0; i < 6; i++) {
+        const vec4& plane = settings.planes[i];
+        glUniform4f_(glGetUniformLocation_(program, ("planes[" + std::to_string(i) + "]").c_str()), plane[0], plane[1], plane[2], plane[3]);
+    }
+
+    glDispatchCompute_((GLuint)((chunks.size() + cull_group_size - 1) / cull_group_size), 1, 1);
+    glMemoryBarrier_(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glUseProgram_(0);
+
+    commands.resize(chunks.size());
+    glBindBuffer_(GL_SHADER_STORAGE_BUFFER, buffers[3]);
+    glGetBufferSubData_(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(Draw_Command), commands.data());
+    glBindBuffer_(GL_SHADER_STORAGE_BUFFER, buffers[4]);
+    glGetBufferSubData_(GL_SHADER_STORAGE_BUFFER, 0, 3 * sizeof(unsigned int), counts);
+    glBindBuffer_(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+static size_t drawn_commands(const std::vector<Draw_Command>& commands)
+{
+    size_t drawn = 0;
+    for (size_t c = 0; c < commands.size(); c++)
+        if (commands[c].instance_count > 0)
+            drawn++;
+    return drawn;
+}
+
+// compares shader with cull_trajectories, returns number of differences
+static size_t compare(const std::string& test, GLuint program, const std::vector<Cull_Trajectory>& trajs,
+                      const std::vector<Cull_Chunk>& chunks, const std::vector<unsigned int>& classes, const Cull_Settings& settings)
+{
+    std::vector<Draw_Command> cpu_commands;
+    unsigned int visible = cull_trajectories(trajs, chunks, classes, settings, cpu_commands);
+
+    // chunks culled by the view frustum are those drawn without frustum culling only
+    Cull_Settings unculled = settings;
+    unculled.frustum_culling = false;
+    std::vector<Draw_Command> unculled_commands;
+    cull_trajectories(trajs, chunks, classes, unculled, unculled_commands);
+    size_t drawn = drawn_commands(cpu_commands);
+    size_t culled = drawn_commands(unculled_commands) - drawn;
+
+    std::vector<Draw_Command> gpu_commands;
+    unsigned int counts[3] = { 0, 0, 0 };
+    cull_on_gpu(program, trajs, chunks, classes, settings, gpu_commands, counts);
+
+    size_t differences = 0;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        const Draw_Command& cpu = cpu_commands[c];
+        const Draw_Command& gpu = gpu_commands[c];
+        if (cpu.count != gpu.count || cpu.instance_count != gpu.instance_count || cpu.first != gpu.first || cpu.base_instance != gpu.base_instance) {
+            if (differences < 10)
+                std::cerr << test << ": chunk " << c << " is (" << gpu.count << ", " << gpu.instance_count << ", " << gpu.first
+                          << ") instead of (" << cpu.count << ", " << cpu.instance_count << ", " << cpu.first << ")" << std::endl;
+            differences++;
+        }
+    }
+    if (counts[0] != visible || counts[1] != drawn || counts[2] != culled) {
+        std::cerr << test << ": counts are " << counts[0] << ", " << counts[1] << ", " << counts[2]
+                  << " instead of " << visible << ", " << drawn << ", " << culled << std::endl;
+        differences++;
+    }
+    if (glGetError_() != GL_NO_ERROR) {
+        std::cerr << test << ": OpenGL error" << std::endl;
+        differences++;
+    }
+    return differences;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "usage: test_traj_culling_gl traj_culling_shader.glcs" << std::endl;
+        return 1;
+    }
+    if (!create_context() || !load_functions())
+        return skip_code;
+    std::cout << "renderer: " << glGetString_(GL_RENDERER) << std::endl;
+
+    GLuint program = build_program(argv[1]);
+    if (program == 0)
+        return 1;
+
+    // random trajectories in [0, 100]^3, several chunks and work groups
+    const int timesteps = 400;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> coordinate(0.0f, 100.0f);
+    std::vector<Cull_Trajectory> trajs(300);
+    std::vector<vec3> positions;
+    std::vector<unsigned int> classes(trajs.size());
+    for (size_t p = 0; p < trajs.size(); p++) {
+        Cull_Trajectory& traj = trajs[p];
+        traj.start_time = random() % timesteps;
+        traj.length = 1 + random() % (timesteps - traj.start_time);
+        traj.first = (unsigned int)positions.size();
+        traj.padding = 0;
+        traj.box_min = vec4(100.0f);
+        traj.box_max = vec4(0.0f);
+
+        // random walk so that chunks have small boxes
+        vec3 position(coordinate(random), coordinate(random), coordinate(random));
+        for (unsigned int i = 0; i < traj.length; i++) {
+            for (int j = 0; j < 3; j++) {
+                position[j] = std::min(std::max(position[j] + coordinate(random) / 50.0f - 1.0f, 0.0f), 100.0f);
+                traj.box_min[j] = std::min(traj.box_min[j], position[j]);
+                traj.box_max[j] = std::max(traj.box_max[j], position[j]);
+            }
+            positions.push_back(position);
+        }
+        classes[p] = 1u << (random() % 3);
+    }
+    std::vector<Cull_Chunk> chunks;
+    build_cull_chunks(trajs, positions, chunks);
+    std::cout << trajs.size() << " trajectories, " << chunks.size() << " chunks" << std::endl;
+
+    Cull_Settings settings;
+    settings.start_time = 1;
+    settings.end_time = timesteps;
+    settings.rejected_classes = 0;
+    settings.roi_active = false;
+    settings.roi.min = vec3(0.0f);
+    settings.roi.max = vec3(100.0f);
+    settings.roi.center = vec3(50.0f);
+    settings.single_traj = -1;
+    settings.frustum_culling = false;
+    for (int i = 0; i < 6; i++)
+        settings.planes[i] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+    size_t differences = compare("whole time range", program, trajs, chunks, classes, settings);
+
+    // time windows on chunk borders and of one time step
+    settings.start_time = 64;
+    settings.end_time = 65;
+    differences += compare("window on chunk border", program, trajs, chunks, classes, settings);
+    settings.start_time = 129;
+    settings.end_time = 129;
+    differences += compare("window of one time step", program, trajs, chunks, classes, settings);
+    settings.start_time = 100;
+    settings.end_time = 300;
+    differences += compare("window", program, trajs, chunks, classes, settings);
+
+    settings.rejected_classes = 2;
+    differences += compare("length classes", program, trajs, chunks, classes, settings);
+    settings.rejected_classes = 0;
+
+    settings.roi_active = true;
+    settings.roi.min = vec3(20.0f, 30.0f, 40.0f);
+    settings.roi.max = vec3(40.0f, 50.0f, 60.0f);
+    differences += compare("roi", program, trajs, chunks, classes, settings);
+    settings.roi_active = false;
+
+    settings.single_traj = 42;
+    differences += compare("single trajectory", program, trajs, chunks, classes, settings);
+    settings.single_traj = -1;
+
+    // perspective view from (50, 50, 150) towards the center of the data
+    cgv::math::fmat<double, 4, 4> mvp;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            mvp(i, j) = 0.0;
+    double near_plane = 1.0, far_plane = 120.0;
+    mvp(0, 0) = 2.0;
+    mvp(0, 3) = -100.0;
+    mvp(1, 1) = 2.0;
+    mvp(1, 3) = -100.0;
+    mvp(2, 2) = -(far_plane + near_plane) / (far_plane - near_plane);
+    mvp(2, 3) = -2.0 * far_plane * near_plane / (far_plane - near_plane) + 150.0 * (far_plane + near_plane) / (far_plane - near_plane);
+    mvp(3, 2) = -1.0;
+    mvp(3, 3) = 150.0;
+    settings.frustum_culling = true;
+    frustum_planes(mvp, settings.planes);
+    differences += compare("frustum", program, trajs, chunks, classes, settings);
+
+    settings.start_time = 64;
+    settings.end_time = 200;
+    settings.rejected_classes = 4;
+    differences += compare("frustum and filters", program, trajs, chunks, classes, settings);
+
+    if (differences > 0) {
+        std::cerr << differences << " differences between shader and cull_trajectories" << std::endl;
+        return 1;
+    }
+    std::cout << "shader matches cull_trajectories" << std::endl;
+    return 0;
+}